@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include "cands.h"
+
+// The number of cones around a site, the average number of sites per grid
+// cell and the relative margin by which the disks are enlarged.
+const int N_CONES = 6;
+const double CELL_SITES = 2.;
+const double MARGIN = 1e-6;
+
+CandGrid::CandGrid(const std::vector<SiteData> &sites) {
+    for (const auto &s : sites) {
+        m_xs.push_back(std::get<0>(s));
+        m_ys.push_back(std::get<1>(s));
+        m_ws.push_back(std::get<2>(s));
+    }
+
+    size_t n = m_xs.size();
+    m_radii.assign(n, std::numeric_limits<double>::infinity());
+    m_coneSites.assign(n, std::vector<int>(N_CONES, -1));
+    if (n < 2) {
+        return;
+    }
+
+    // The grid covers the bounding box of the sites (enlarged by 10%).
+    const auto xs = std::minmax_element(m_xs.begin(), m_xs.end());
+    const auto ys = std::minmax_element(m_ys.begin(), m_ys.end());
+    double width = std::max(*xs.second - *xs.first, 1.),
+            height = std::max(*ys.second - *ys.first, 1.);
+    m_xMin = *xs.first - width / 20.;
+    m_yMin = *ys.first - height / 20.;
+    width *= 1.1;
+    height *= 1.1;
+
+    m_cellSize = std::sqrt(width * height * CELL_SITES / n);
+    m_nx = std::max<size_t>(1, static_cast<size_t>(std::ceil(width / m_cellSize)));
+    m_ny = std::max<size_t>(1, static_cast<size_t>(std::ceil(height / m_cellSize)));
+    m_cells.resize(m_nx * m_ny);
+
+    // The sites are sorted by decreasing weight, hence the grid holds the
+    // sites of at least the weight of a class when its radii are computed.
+    size_t cx, cy;
+    for (size_t begin = 0, end = 0; begin < n; begin = end) {
+        while (end < n && m_ws[end] == m_ws[begin]) {
+            end++;
+        }
+
+        for (size_t i = begin; i < end; i++) {
+            m_cells[cellOf(m_xs[i], m_ys[i], cx, cy)].push_back(static_cast<int>(i));
+        }
+
+        for (size_t i = begin; i < end; i++) {
+            compRadius(static_cast<int>(i));
+        }
+    }
+
+    compPairs();
+    std::cout << "There are " << m_candPairs.size() << " candidate pairs.\n";
+}
+
+// Searches the rings of grid cells around the site until no site beyond the
+// current ring can make the disk smaller.
+void CandGrid::compRadius(int site) {
+    double x = m_xs[site], y = m_ys[site], w = m_ws[site];
+    double cones[N_CONES], apollo = std::numeric_limits<double>::infinity();
+    std::fill(cones, cones + N_CONES, std::numeric_limits<double>::infinity());
+    auto &coneSites = m_coneSites[site];
+
+    const auto fVisit = [&](long cx, long cy) {
+        if (cx < 0 || cy < 0 || cx >= static_cast<long>(m_nx)
+                || cy >= static_cast<long>(m_ny)) {
+            return;
+        }
+
+        for (int other : m_cells[cy * m_nx + cx]) {
+            if (other == site) {
+                continue;
+            }
+
+            double dx = m_xs[other] - x, dy = m_ys[other] - y,
+                    dist = std::sqrt(dx * dx + dy * dy);
+            if (dist == 0.) {
+                if (m_ws[other] > w) {
+                    apollo = 0.;
+                }
+
+                continue;
+            }
+
+            int cone = static_cast<int>((std::atan2(dy, dx) + M_PI) / (M_PI / 3.)) % N_CONES;
+            if (dist < cones[cone]) {
+                cones[cone] = dist;
+                coneSites[cone] = other;
+            }
+
+            if (m_ws[other] > w) {
+                apollo = std::min(apollo, dist * w / (m_ws[other] - w));
+            }
+        }
+    };
+
+    size_t cx, cy;
+    cellOf(x, y, cx, cy);
+    long lcx = static_cast<long>(cx), lcy = static_cast<long>(cy);
+    for (long r = 0; r <= static_cast<long>(std::max(m_nx, m_ny)); r++) {
+        double lower = r > 0 ? (r - 1) * m_cellSize : 0.;
+        if (lower >= std::min(apollo, *std::max_element(cones, cones + N_CONES))) {
+            break;
+        }
+
+        if (r == 0) {
+            fVisit(lcx, lcy);
+            continue;
+        }
+
+        for (long i = lcx - r; i <= lcx + r; i++) {
+            fVisit(i, lcy - r);
+            fVisit(i, lcy + r);
+        }
+
+        for (long i = lcy - r + 1; i < lcy + r; i++) {
+            fVisit(lcx - r, i);
+            fVisit(lcx + r, i);
+        }
+    }
+
+    m_radii[site] = std::min(apollo, *std::max_element(cones, cones + N_CONES))
+            * (1. + MARGIN);
+}
+
+// A pair of bounded disks is found from the larger one (or the one of the
+// smaller index), whose twice enlarged disk contains the other site. The
+// sites with unbounded disks are tested against all other sites.
+void CandGrid::compPairs() {
+    int n = static_cast<int>(m_xs.size());
+    for (int site = 0; site < n; site++) {
+        double radius = m_radii[site];
+        if (std::isinf(radius)) {
+            for (int other = 0; other < n; other++) {
+                if (other != site && (!std::isinf(m_radii[other]) || other > site)
+                        && mayTouch(site, other)) {
+                    m_candPairs.push_back(std::minmax(site, other));
+                }
+            }
+
+            continue;
+        }
+
+        const auto fCell = [this](double val, double min, size_t size) {
+            double cell = std::floor((val - min) / m_cellSize);
+            return static_cast<size_t>(std::max(0., std::min(cell, size - 1.)));
+        };
+
+        double reach = 2. * radius;
+        size_t xBegin = fCell(m_xs[site] - reach, m_xMin, m_nx),
+                xEnd = fCell(m_xs[site] + reach, m_xMin, m_nx),
+                yBegin = fCell(m_ys[site] - reach, m_yMin, m_ny),
+                yEnd = fCell(m_ys[site] + reach, m_yMin, m_ny);
+        for (size_t cy = yBegin; cy <= yEnd; cy++) {
+            for (size_t cx = xBegin; cx <= xEnd; cx++) {
+                for (int other : m_cells[cy * m_nx + cx]) {
+                    double otherRadius = m_radii[other];
+                    if (other == site || std::isinf(otherRadius) || otherRadius > radius
+                            || (otherRadius == radius && other > site)) {
+                        continue;
+                    }
+
+                    if (mayTouch(site, other)) {
+                        m_candPairs.push_back(std::minmax(site, other));
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort(m_candPairs.begin(), m_candPairs.end());
+}
+
+bool CandGrid::mayTouch(int site1, int site2) const {
+    double dx = m_xs[site2] - m_xs[site1], dy = m_ys[site2] - m_ys[site1];
+    return std::sqrt(dx * dx + dy * dy) <= m_radii[site1] + m_radii[site2]
+            && meetsHalfPlanes(site1, site2) && meetsHalfPlanes(site2, site1);
+}
+
+// Checks whether the disk of site2 meets the half-planes that bound the
+// Voronoi cell of site1 among its nearest sites in the cones.
+bool CandGrid::meetsHalfPlanes(int site1, int site2) const {
+    if (std::isinf(m_radii[site2])) {
+        return true;
+    }
+
+    double x = m_xs[site1], y = m_ys[site1];
+    for (int other : m_coneSites[site1]) {
+        if (other < 0) {
+            continue;
+        }
+
+        double ux = m_xs[other] - x, uy = m_ys[other] - y,
+                dist = std::sqrt(ux * ux + uy * uy),
+                proj = ((m_xs[site2] - x) * ux + (m_ys[site2] - y) * uy) / dist;
+        if (proj - m_radii[site2] > dist / 2. * (1. + MARGIN)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+size_t CandGrid::cellOf(double x, double y, size_t &cx, size_t &cy) const {
+    cx = std::min(m_nx - 1, static_cast<size_t>(std::max(0., (x - m_xMin) / m_cellSize)));
+    cy = std::min(m_ny - 1, static_cast<size_t>(std::max(0., (y - m_yMin) / m_cellSize)));
+    return cy * m_nx + cx;
+}
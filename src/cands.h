@@ -0,0 +1,58 @@
+#ifndef CANDS_H
+#define CANDS_H
+
+#include <utility>
+#include <vector>
+#include "file_io.h"
+
+// Finds the pairs of sites whose regions may share an edge of the diagram by
+// a uniform grid over the sites, i.e., without an overlay. The region of a
+// site lies within its (unweighted) Voronoi cell among the sites of at least
+// its weight and within the Apollonius circle of every heavier site. Hence,
+// it lies within a disk around the site whose radius is the smaller of
+//  - the largest distance to the nearest of these sites within one of six
+//    cones of 60 degrees around the site (infinite if a cone is empty), and
+//  - the smallest radius of the Apollonius circles of the heavier sites
+//    found on the way.
+// The grid is filled in the order of decreasing weight, and the radii are
+// found by searching rings of grid cells around each site. Two sites are a
+// candidate pair if their disks intersect and if either disk meets the
+// half-planes of the bisectors of the other site with its nearest sites in
+// the cones. Everything is computed in double precision with a small margin.
+class CandGrid {
+public:
+    // The sites have to be sorted as in VorDiag (see sortSites()), the pairs
+    // refer to their indices.
+    CandGrid(const std::vector<SiteData> &sites);
+
+    // The pairs (i, j) with i < j in lexicographical order.
+    const std::vector<std::pair<int, int>> & candPairs() const {
+        return m_candPairs;
+    }
+
+private:
+    void compRadius(int site);
+    void compPairs();
+    bool mayTouch(int site1, int site2) const;
+    bool meetsHalfPlanes(int site1, int site2) const;
+    size_t cellOf(double x, double y, size_t &cx, size_t &cy) const;
+
+    std::vector<double> m_xs;
+    std::vector<double> m_ys;
+    std::vector<double> m_ws;
+    // The radii of the disks (infinite if unbounded) and the nearest sites
+    // of at least the same weight within the six cones (-1 if none).
+    std::vector<double> m_radii;
+    std::vector<std::vector<int>> m_coneSites;
+    // The grid over the bounding box of the sites and the sites (by index)
+    // in its cells.
+    double m_xMin{0.};
+    double m_yMin{0.};
+    double m_cellSize{1.};
+    size_t m_nx{1};
+    size_t m_ny{1};
+    std::vector<std::vector<int>> m_cells;
+    std::vector<std::pair<int, int>> m_candPairs;
+};
+
+#endif /* CANDS_H */
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include "dcel.h"
+
+int VorDcel::addVert(double x, double y) {
+    m_verts.push_back(DcelVert{x, y, -1});
+    return static_cast<int>(m_verts.size()) - 1;
+}
+
+void VorDcel::addArc(int src, int tgt, int leftSite, int rightSite,
+                     double cx, double cy, double r) {
+    addEdge(src, tgt, leftSite, rightSite, true, cx, cy, r);
+}
+
+void VorDcel::addSeg(int src, int tgt, int leftSite, int rightSite) {
+    addEdge(src, tgt, leftSite, rightSite, false, 0., 0., 0.);
+}
+
+void VorDcel::build() {
+    linkHalfEdges();
+    compFaces();
+}
+
+std::vector<int> VorDcel::facesOf(int site) const {
+    std::vector<int> res;
+    for (size_t i = 0; i < m_faces.size(); i++) {
+        if (m_faces.at(i).site == site) {
+            res.push_back(static_cast<int>(i));
+        }
+    }
+
+    return res;
+}
+
+bool VorDcel::write(const std::string &filePath) const {
+    std::ofstream file;
+    file.open(filePath, std::ofstream::out | std::ofstream::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file.precision(17);
+    file << "VERTICES " << m_verts.size() << "\n";
+    for (const auto &vert : m_verts) {
+        file << vert.x << " " << vert.y << " " << vert.halfEdge << "\n";
+    }
+
+    file << "HALFEDGES " << m_halfEdges.size() << "\n";
+    for (const auto &he : m_halfEdges) {
+        file << he.origin << " " << he.twin << " " << he.next << " "
+                << he.face << " " << he.site << " ";
+        if (he.bIsArc) {
+            file << (he.bIsCcw ? "ccw " : "cw ") << he.cx << " " << he.cy
+                    << " " << he.r << "\n";
+        } else {
+            file << "seg\n";
+        }
+    }
+
+    file << "FACES " << m_faces.size() << "\n";
+    for (const auto &face : m_faces) {
+        file << face.site << " " << face.halfEdge << " "
+                << (face.bIsClosed ? 1 : 0) << " " << face.area << "\n";
+    }
+
+    return true;
+}
+
+void VorDcel::addEdge(int src, int tgt, int leftSite, int rightSite,
+                      bool bIsArc, double cx, double cy, double r) {
+    int h = static_cast<int>(m_halfEdges.size());
+    m_halfEdges.push_back(DcelHalfEdge{src, h + 1, -1, -1, leftSite, bIsArc,
+                                       true, cx, cy, r});
+    m_halfEdges.push_back(DcelHalfEdge{tgt, h, -1, -1, rightSite, bIsArc,
+                                       false, cx, cy, r});
+}
+
+// The successor of a half-edge is the outgoing half-edge at its target that
+// bounds the cell of the same site. Usually there is exactly one such
+// half-edge; otherwise, the successor is the outgoing half-edge that
+// follows the twin in clockwise order.
+void VorDcel::linkHalfEdges() {
+    std::vector<std::vector<int>> outs(m_verts.size());
+    for (size_t h = 0; h < m_halfEdges.size(); h++) {
+        outs.at(m_halfEdges.at(h).origin).push_back(static_cast<int>(h));
+    }
+
+    for (size_t v = 0; v < m_verts.size(); v++) {
+        auto &out = outs.at(v);
+        if (!out.empty()) {
+            m_verts.at(v).halfEdge = out.front();
+        }
+
+        if (out.size() > 2) {
+            std::sort(out.begin(), out.end(),
+                      [this](int lhs, int rhs) {
+                          return angleAt(lhs) < angleAt(rhs);
+                      });
+        }
+    }
+
+    for (auto &he : m_halfEdges) {
+        const auto &out = outs.at(m_halfEdges.at(he.twin).origin);
+        int next = -1, nCands = 0;
+        for (int cand : out) {
+            if (m_halfEdges.at(cand).site == he.site) {
+                next = cand;
+                nCands++;
+            }
+        }
+
+        if (nCands > 1) {
+            const auto it = std::find(out.begin(), out.end(), he.twin);
+            next = it == out.begin() ? out.back() : *(it - 1);
+        }
+
+        he.next = next;
+    }
+}
+
+void VorDcel::compFaces() {
+    m_faces.clear();
+    for (auto &he : m_halfEdges) {
+        he.face = -1;
+    }
+
+    for (size_t h = 0; h < m_halfEdges.size(); h++) {
+        if (m_halfEdges.at(h).face >= 0) {
+            continue;
+        }
+
+        int f = static_cast<int>(m_faces.size());
+        auto face = DcelFace{m_halfEdges.at(h).site, static_cast<int>(h), false, 0.};
+        int cur = static_cast<int>(h);
+        while (cur >= 0 && m_halfEdges.at(cur).face < 0) {
+            m_halfEdges.at(cur).face = f;
+            face.area += area(cur);
+            cur = m_halfEdges.at(cur).next;
+        }
+
+        face.bIsClosed = cur == static_cast<int>(h);
+        m_faces.push_back(face);
+    }
+}
+
+// Returns the direction in which the half-edge leaves its origin.
+double VorDcel::angleAt(int halfEdge) const {
+    const auto &he = m_halfEdges.at(halfEdge);
+    const auto &src = m_verts.at(he.origin), &tgt = m_verts.at(target(halfEdge));
+
+    if (!he.bIsArc) {
+        return std::atan2(tgt.y - src.y, tgt.x - src.x);
+    }
+
+    double dx = src.x - he.cx, dy = src.y - he.cy;
+    return he.bIsCcw ? std::atan2(dx, -dy) : std::atan2(-dx, dy);
+}
+
+// Returns the contribution of the half-edge to the signed area of its face,
+// i.e., the area of the triangle spanned with the origin plus (or minus)
+// the area of the circular segment between the chord and the arc.
+double VorDcel::area(int halfEdge) const {
+    const auto &he = m_halfEdges.at(halfEdge);
+    const auto &src = m_verts.at(he.origin), &tgt = m_verts.at(target(halfEdge));
+    double res = (src.x * tgt.y - tgt.x * src.y) / 2.;
+
+    if (he.bIsArc) {
+        const auto &from = he.bIsCcw ? src : tgt, &to = he.bIsCcw ? tgt : src;
+        double theta = std::atan2(to.y - he.cy, to.x - he.cx)
+                - std::atan2(from.y - he.cy, from.x - he.cx);
+        if (theta <= 0.) {
+            theta += 2 * M_PI;
+        }
+
+        double segArea = he.r * he.r * (theta - std::sin(theta)) / 2.;
+        res += he.bIsCcw ? segArea : -segArea;
+    }
+
+    return res;
+}
@@ -0,0 +1,88 @@
+#ifndef DCEL_H
+#define DCEL_H
+
+#include <string>
+#include <vector>
+
+struct DcelVert {
+    double x;
+    double y;
+    // An outgoing half-edge (or -1 if the vertex is isolated).
+    int halfEdge;
+};
+
+// A half-edge runs from its origin to the origin of its twin and has the
+// cell of site on its left. Arcs lie on the circle with center (cx, cy)
+// and radius r; bIsCcw tells whether the half-edge traverses its arc
+// counterclockwise.
+struct DcelHalfEdge {
+    int origin;
+    int twin;
+    int next;
+    int face;
+    int site;
+    bool bIsArc;
+    bool bIsCcw;
+    double cx;
+    double cy;
+    double r;
+};
+
+// A face is a single boundary cycle of the cell of site. A cell may consist
+// of several faces. Cycles with negative (signed) area bound holes of the
+// cell of site or, for the unbounded cells, enclose the other cells. If an
+// edge of the cycle is missing (e.g., an unbounded edge), then the face is
+// not closed and its area is meaningless.
+struct DcelFace {
+    int site;
+    int halfEdge;
+    bool bIsClosed;
+    double area;
+};
+
+// Stores the topology of a Voronoi diagram as a doubly-connected edge list.
+// The vertices and edges are added first, build() then links the
+// half-edges and determines the faces.
+class VorDcel {
+public:
+    int addVert(double x, double y);
+    void addArc(int src, int tgt, int leftSite, int rightSite,
+            double cx, double cy, double r);
+    void addSeg(int src, int tgt, int leftSite, int rightSite);
+    void build();
+
+    const std::vector<DcelVert> & verts() const {
+        return m_verts;
+    }
+
+    const std::vector<DcelHalfEdge> & halfEdges() const {
+        return m_halfEdges;
+    }
+
+    const std::vector<DcelFace> & faces() const {
+        return m_faces;
+    }
+
+    int target(int halfEdge) const {
+        return m_halfEdges.at(m_halfEdges.at(halfEdge).twin).origin;
+    }
+
+    // Returns the faces of the cell of the given site.
+    std::vector<int> facesOf(int site) const;
+
+    bool write(const std::string &filePath) const;
+
+private:
+    void addEdge(int src, int tgt, int leftSite, int rightSite, bool bIsArc,
+            double cx, double cy, double r);
+    void linkHalfEdges();
+    void compFaces();
+    double angleAt(int halfEdge) const;
+    double area(int halfEdge) const;
+
+    std::vector<DcelVert> m_verts;
+    std::vector<DcelHalfEdge> m_halfEdges;
+    std::vector<DcelFace> m_faces;
+};
+
+#endif /* DCEL_H */
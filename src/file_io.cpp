@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <sstream>
 #include <iostream>
 #include <assert.h>
@@ -267,120 +270,549 @@ const char *IPE_FOOTER = "</page> \
 </ipe> \
         ";
 
-IpeObj::IpeObj(const Point_2 &pnt, const std::string &layer,
-               double scale, const std::string &color,
-               const std::string &size, const std::string &label)
-: m_layer{layer}
+IpeWriter::IpeWriter(const std::string &filePath,
+                     const std::vector<std::string> &layers)
+: m_buf(1 << 20)
 {
-    const auto arcPnt = Circular_arc_point_2{pnt};
-    m_str = IpeObj(arcPnt, layer, scale, color, size, label).str();
+    m_file.rdbuf()->pubsetbuf(m_buf.data(), m_buf.size());
+    m_file.open(filePath, std::ofstream::out | std::ofstream::trunc);
+    addLayer("Labels");
+    for (const auto &layer : layers) {
+        addLayer(layer);
+    }
 }
 
-IpeObj::IpeObj(const Circular_arc_point_2 &arcPnt, const std::string &layer,
-       double scale, const std::string &color,
-       const std::string &size, const std::string &label)
-: m_layer{layer}
-{
-    std::stringstream strs;
-    strs << "<use layer=\"" << m_layer << "\" name=\"mark/disk(sx)\" pos=\""
-            << CGAL::to_double(arcPnt.x()) * scale << " " 
-            << CGAL::to_double(arcPnt.y()) * scale
-            << "\" size=\"" << size << "\" stroke=\"" << color << "\"/>\n";
+IpeWriter::~IpeWriter() {
+    close();
+}
 
-    if (!label.empty()) {
-        strs << "<text layer=\"Labels\" transformations=\"translations\" pos=\""
-                << CGAL::to_double(arcPnt.x()) * scale << " " 
-                << CGAL::to_double(arcPnt.y()) * scale
-                << "\" stroke=\"" << color 
-                << "\" type=\"Label\" valign=\"baseline\">"
-                << label << "</text>\n";
+void IpeWriter::addLayer(const std::string &layer) {
+    if (m_bHeaderWritten) {
+        m_bIsValid = m_bIsValid && m_layerSet.find(layer) != m_layerSet.end();
+        return;
+    }
+
+    if (m_layerSet.insert(layer).second) {
+        m_layers.push_back(layer);
     }
-    
-    m_str = strs.str();
 }
 
-IpeObj::IpeObj(const Segment_2 &seg, const std::string &layer, double scale, 
-               const std::string &color, const std::string &size)
-: m_layer{layer}
-{
-    std::stringstream strs;
-    strs << "<path layer=\"" << m_layer << "\" stroke=\"" << color 
-            << "\" pen=\"" << size << "\">\n"
-            << CGAL::to_double(seg.source().x()) * scale << " " 
-            << CGAL::to_double(seg.source().y()) * scale << " m\n"
-            << CGAL::to_double(seg.target().x()) * scale << " " 
-            << CGAL::to_double(seg.target().y()) * scale << " l\n"
-            << "</path>\n";
-    
-    m_str = strs.str();
-}
-
-IpeObj::IpeObj(const Circular_arc_2 &arc, const std::string &layer, double scale, 
-               const std::string &color, const std::string &size)
-: m_layer{layer}
-{
-    std::stringstream strs;
-    strs << "<path layer=\"" << m_layer << "\" stroke=\"" << color 
-            << "\" pen=\"" << size << "\">\n"
-            << CGAL::to_double(arc.source().x()) * scale << " " 
-            << CGAL::to_double(arc.source().y()) * scale << " m\n"
-            << std::sqrt(CGAL::to_double(arc.squared_radius())) * scale << " 0 0 " 
-            << std::sqrt(CGAL::to_double(arc.squared_radius())) * scale << " "
-            << CGAL::to_double(arc.center().x()) * scale << " " 
-            << CGAL::to_double(arc.center().y()) * scale << " "
-            << CGAL::to_double(arc.target().x()) * scale << " " 
-            << CGAL::to_double(arc.target().y()) * scale << " a\n" 
-            << "</path>\n";
-    
-    m_str = strs.str();
-}
-
-IpeObj::IpeObj(const Circle_2 &circle, const std::string &layer, double scale,
-               const std::string &color, const std::string &size)
-: m_layer{layer}
-{
-    std::stringstream strs;
-    strs << "<path layer=\"" << m_layer << "\" stroke=\"" << color 
-            << "\" pen=\"" << size << "\">\n"
-            << std::sqrt(CGAL::to_double(circle.squared_radius())) * scale << " 0 0 " 
-            << std::sqrt(CGAL::to_double(circle.squared_radius())) * scale << " "
-            << CGAL::to_double(circle.center().x()) * scale << " " 
-            << CGAL::to_double(circle.center().y()) * scale << " e\n"
-            << "</path>\n";
-    
-    m_str = strs.str();
-}
-
-IpeWriter::IpeWriter(const std::string &filePath) {
-    m_file.open(filePath, std::ofstream::out | std::ofstream::trunc);
-    m_layers.insert("Labels");
+void IpeWriter::add(const Point_2 &pnt, const std::string &layer,
+                    double scale, const std::string &color,
+                    const std::string &size, const std::string &label) {
+    writePnt(CGAL::to_double(pnt.x()) * scale, CGAL::to_double(pnt.y()) * scale,
+             layer, color, size, label);
+}
+
+void IpeWriter::add(const Circular_arc_point_2 &arcPnt, const std::string &layer,
+                    double scale, const std::string &color,
+                    const std::string &size, const std::string &label) {
+    writePnt(CGAL::to_double(arcPnt.x()) * scale, CGAL::to_double(arcPnt.y()) * scale,
+             layer, color, size, label);
+}
+
+void IpeWriter::add(const Segment_2 &seg, const std::string &layer,
+                    double scale, const std::string &color,
+                    const std::string &size) {
+    if (!beginPath(layer, color, size)) {
+        return;
+    }
+
+    putPnt(CGAL::to_double(seg.source().x()) * scale,
+           CGAL::to_double(seg.source().y()) * scale, " m\n");
+    putPnt(CGAL::to_double(seg.target().x()) * scale,
+           CGAL::to_double(seg.target().y()) * scale, " l\n");
+    m_file << "</path>\n";
+}
+
+void IpeWriter::add(const Circular_arc_2 &arc, const std::string &layer,
+                    double scale, const std::string &color,
+                    const std::string &size) {
+    if (!beginPath(layer, color, size)) {
+        return;
+    }
+
+    putPnt(CGAL::to_double(arc.source().x()) * scale,
+           CGAL::to_double(arc.source().y()) * scale, " m\n");
+    putRadius(std::sqrt(CGAL::to_double(arc.squared_radius())) * scale);
+    putPnt(CGAL::to_double(arc.center().x()) * scale,
+           CGAL::to_double(arc.center().y()) * scale, " ");
+    putPnt(CGAL::to_double(arc.target().x()) * scale,
+           CGAL::to_double(arc.target().y()) * scale, " a\n");
+    m_file << "</path>\n";
+}
+
+void IpeWriter::add(const Circle_2 &circle, const std::string &layer,
+                    double scale, const std::string &color,
+                    const std::string &size) {
+    if (!beginPath(layer, color, size)) {
+        return;
+    }
+
+    putRadius(std::sqrt(CGAL::to_double(circle.squared_radius())) * scale);
+    putPnt(CGAL::to_double(circle.center().x()) * scale,
+           CGAL::to_double(circle.center().y()) * scale, " e\n");
+    m_file << "</path>\n";
+}
+
+void IpeWriter::add(const WvdVert &vert, const std::string &layer,
+                    double scale, const std::string &color,
+                    const std::string &size, const std::string &label) {
+    writePnt(vert.x * scale, vert.y * scale, layer, color, size, label);
+}
+
+void IpeWriter::add(const WvdEdge &edge, const std::vector<WvdVert> &verts,
+                    const std::string &layer, double scale,
+                    const std::string &color, const std::string &size) {
+    const auto &src = verts.at(edge.src), &tgt = verts.at(edge.tgt);
+
+    if (!beginPath(layer, color, size)) {
+        return;
+    }
+
+    putPnt(src.x * scale, src.y * scale, " m\n");
+    if (edge.bIsArc) {
+        putRadius(edge.r * scale);
+        putPnt(edge.cx * scale, edge.cy * scale, " ");
+        putPnt(tgt.x * scale, tgt.y * scale, " a\n");
+    } else {
+        putPnt(tgt.x * scale, tgt.y * scale, " l\n");
+    }
+    m_file << "</path>\n";
 }
 
-void IpeWriter::write() {
+bool IpeWriter::close() {
+    if (m_file.is_open()) {
+        if (!m_bHeaderWritten) {
+            writeHeader();
+        }
+
+        m_file << IPE_FOOTER;
+        m_file.close();
+    }
+
+    return m_bIsValid;
+}
+
+void IpeWriter::writeHeader() {
     m_file << IPE_HEADER;
-    for (const auto &layer : m_layers)
+    for (const auto &layer : m_layers) {
         m_file << "<layer name=\"" << layer << "\"/>\n";
+    }
+
+    m_file << "<view layers=\"";
+    for (const auto &layer : m_layers) {
+        m_file << layer << " ";
+    }
+
+    m_file << "\" active=\"";
+    for (const auto &layer : m_layers) {
+        m_file << layer << " ";
+    }
+
+    m_file << "\"/>";
+    m_bHeaderWritten = true;
+}
+
+// Layers that show up after the header has been written have not been
+// declared in time, hence their objects are dropped.
+bool IpeWriter::checkLayer(const std::string &layer) {
+    if (!m_bHeaderWritten) {
+        addLayer(layer);
+        writeHeader();
+    }
+
+    if (m_layerSet.find(layer) != m_layerSet.end()) {
+        return true;
+    }
+
+    if (m_bIsValid) {
+        std::cout << "Layer " << layer << " has not been declared, its objects are dropped.\n";
+    }
+
+    m_bIsValid = false;
+    return false;
+}
+
+void IpeWriter::writePnt(double x, double y, const std::string &layer,
+                         const std::string &color, const std::string &size,
+                         const std::string &label) {
+    if (!checkLayer(layer)) {
+        return;
+    }
+
+    m_file << "<use layer=\"" << layer << "\" name=\"mark/disk(sx)\" pos=\"";
+    putPnt(x, y, "\" size=\"");
+    m_file << size << "\" stroke=\"" << color << "\"/>\n";
+
+    if (!label.empty()) {
+        m_file << "<text layer=\"Labels\" transformations=\"translations\" pos=\"";
+        putPnt(x, y, "\" stroke=\"");
+        m_file << color << "\" type=\"Label\" valign=\"baseline\">"
+                << label << "</text>\n";
+    }
+}
+
+bool IpeWriter::beginPath(const std::string &layer, const std::string &color,
+                          const std::string &size) {
+    if (!checkLayer(layer)) {
+        return false;
+    }
+
+    m_file << "<path layer=\"" << layer << "\" stroke=\"" << color
+            << "\" pen=\"" << size << "\">\n";
+    return true;
+}
+
+void IpeWriter::putPnt(double x, double y, const char *suffix) {
+    char str[64];
+    int len = std::snprintf(str, sizeof(str), "%g %g%s", x, y, suffix);
+    m_file.write(str, std::min<int>(len, sizeof(str) - 1));
+}
+
+void IpeWriter::putRadius(double r) {
+    char str[64];
+    int len = std::snprintf(str, sizeof(str), "%g 0 0 %g ", r, r);
+    m_file.write(str, std::min<int>(len, sizeof(str) - 1));
+}
+
+const char WVD_MAGIC[4] = {'W', 'E', 'V', 'O'};
+const uint32_t WVD_VERSION = 1;
+
+// Tags of the records of the binary diagram format.
+const char WVD_SITE = 'S';
+const char WVD_VERT = 'V';
+const char WVD_ARC = 'A';
+const char WVD_SEG = 'L';
+
+BinWriter::BinWriter(const std::string &filePath) {
+    m_file.open(filePath, std::ofstream::out | std::ofstream::trunc
+                | std::ofstream::binary);
+    if (m_file.is_open()) {
+        writeHeader();
+    }
+}
+
+BinWriter::~BinWriter() {
+    close();
+}
+
+void BinWriter::addSite(int id, double x, double y, double w) {
+    put(WVD_SITE);
+    put(static_cast<int32_t>(id));
+    put(x);
+    put(y);
+    put(w);
+    m_nSites++;
+}
+
+void BinWriter::addArc(double x1, double y1, double x2, double y2,
+                       int site1, int site2, double cx, double cy, double r,
+                       size_t degree1, size_t degree2) {
+    const auto src = addVert(x1, y1, degree1), tgt = addVert(x2, y2, degree2);
+    put(WVD_ARC);
+    put(src);
+    put(tgt);
+    put(static_cast<int32_t>(site1));
+    put(static_cast<int32_t>(site2));
+    put(cx);
+    put(cy);
+    put(r);
+    m_nEdges++;
+}
+
+void BinWriter::addSeg(double x1, double y1, double x2, double y2,
+                       int site1, int site2, size_t degree1, size_t degree2) {
+    const auto src = addVert(x1, y1, degree1), tgt = addVert(x2, y2, degree2);
+    put(WVD_SEG);
+    put(src);
+    put(tgt);
+    put(static_cast<int32_t>(site1));
+    put(static_cast<int32_t>(site2));
+    m_nEdges++;
+}
+
+void BinWriter::close() {
+    if (m_file.is_open()) {
+        m_file.seekp(0);
+        writeHeader();
+        m_file.close();
+    }
+}
+
+void BinWriter::clearVerts(const std::vector<std::pair<double, double>> &keep) {
+    std::map<std::pair<double, double>, std::pair<uint64_t, size_t>> vertIds;
+    for (const auto &vert : keep) {
+        const auto it = m_vertIds.find(vert);
+        if (it != m_vertIds.end()) {
+            vertIds.insert(*it);
+        }
+    }
+
+    m_vertIds.swap(vertIds);
+}
 
-    const auto fToStr = [this]() {
-        std::string str;
-        for (const auto &layer : m_layers) {
-            str.append(layer);
-            str.append(" ");
+uint64_t BinWriter::addVert(double x, double y, size_t degree) {
+    const auto vert = std::make_pair(x, y);
+    const auto it = m_vertIds.find(vert);
+    if (it != m_vertIds.end()) {
+        const auto id = it->second.first;
+        if (it->second.second > 0 && --it->second.second == 0) {
+            m_vertIds.erase(it);
         }
 
-        return str;
-    };
-    m_file << "<view layers=\"" << fToStr()
-            << "\" active=\"" << fToStr() << "\"/>";
-    for (const auto &ipeObj : m_ipeObjs)
-        m_file << ipeObj.str();
-    m_file << IPE_FOOTER;
+        return id;
+    }
+
+    put(WVD_VERT);
+    put(x);
+    put(y);
+    if (degree != 1) {
+        m_vertIds.emplace(vert, std::make_pair(m_nVerts, degree > 0 ? degree - 1 : 0));
+    }
+
+    return m_nVerts++;
+}
+
+void BinWriter::writeHeader() {
+    m_file.write(WVD_MAGIC, sizeof(WVD_MAGIC));
+    put(WVD_VERSION);
+    put(m_nSites);
+    put(m_nVerts);
+    put(m_nEdges);
+}
+
+BinReader::BinReader(const std::string &filePath) {
+    m_file.open(filePath, std::ifstream::in | std::ifstream::binary);
+    if (!m_file.is_open()) {
+        return;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t nSites = 0, nVerts = 0, nEdges = 0;
+    if (!m_file.read(magic, sizeof(magic))
+            || !std::equal(magic, magic + sizeof(magic), WVD_MAGIC)
+            || !get(version) || version != WVD_VERSION
+            || !get(nSites) || !get(nVerts) || !get(nEdges)) {
+        return;
+    }
+
+    m_sites.reserve(nSites);
+    m_verts.reserve(nVerts);
+    m_edges.reserve(nEdges);
+
+    char tag;
+    while (get(tag)) {
+        bool bIsValid = true;
+        if (tag == WVD_SITE) {
+            int32_t id;
+            auto site = WvdSite{};
+            bIsValid = get(id) && get(site.x) && get(site.y) && get(site.w);
+            site.id = id;
+            m_sites.push_back(site);
+        } else if (tag == WVD_VERT) {
+            auto vert = WvdVert{};
+            bIsValid = get(vert.x) && get(vert.y);
+            m_verts.push_back(vert);
+        } else if (tag == WVD_ARC || tag == WVD_SEG) {
+            int32_t site1, site2;
+            auto edge = WvdEdge{};
+            edge.bIsArc = tag == WVD_ARC;
+            bIsValid = get(edge.src) && get(edge.tgt) && get(site1) && get(site2)
+                    && (!edge.bIsArc || (get(edge.cx) && get(edge.cy) && get(edge.r)));
+            edge.site1 = site1;
+            edge.site2 = site2;
+            m_edges.push_back(edge);
+        } else {
+            bIsValid = false;
+        }
+
+        if (!bIsValid) {
+            return;
+        }
+    }
+
+    m_bIsValid = m_sites.size() == nSites && m_verts.size() == nVerts
+            && m_edges.size() == nEdges;
+}
+
+const char CKPT_MAGIC[4] = {'W', 'C', 'K', 'P'};
+const uint32_t CKPT_VERSION = 1;
+
+CkptWriter::CkptWriter(const std::string &filePath)
+: m_filePath{filePath}
+{
+    m_file.open(filePath + ".tmp", std::ofstream::out | std::ofstream::trunc
+                | std::ofstream::binary);
+    if (m_file.is_open()) {
+        m_file.write(CKPT_MAGIC, sizeof(CKPT_MAGIC));
+        put(CKPT_VERSION);
+    }
+}
+
+void CkptWriter::put(const FT &val) {
+    std::ostringstream oss;
+    oss << val;
+    const auto str = oss.str();
+    put(static_cast<uint32_t>(str.size()));
+    m_file.write(str.data(), str.size());
+}
+
+// A root of degree 2 is stored as a0 + a1 sqrt(root).
+void CkptWriter::put(const Root_of_2 &val) {
+    put(val.is_extended());
+    put(FT{val.a0()});
+    if (val.is_extended()) {
+        put(FT{val.a1()});
+        put(FT{val.root()});
+    }
 }
 
-void IpeWriter::copyFile(const std::string &filePath) {
-    std::ifstream src;
-    src.open(filePath, std::ofstream::in);
-    m_file << src.rdbuf();
+void CkptWriter::put(const Circular_arc_point_2 &pnt) {
+    put(pnt.x());
+    put(pnt.y());
+}
+
+bool CkptWriter::close() {
+    if (!m_file.is_open()) {
+        return false;
+    }
+
+    m_file.close();
+    return !m_file.fail()
+            && std::rename((m_filePath + ".tmp").c_str(), m_filePath.c_str()) == 0;
+}
+
+CkptReader::CkptReader(const std::string &filePath) {
+    m_file.open(filePath, std::ifstream::in | std::ifstream::binary);
+    if (!m_file.is_open()) {
+        return;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    m_bIsValid = m_file.read(magic, sizeof(magic))
+            && std::equal(magic, magic + sizeof(magic), CKPT_MAGIC)
+            && get(version) && version == CKPT_VERSION;
+}
+
+bool CkptReader::get(FT &val) {
+    uint32_t len = 0;
+    if (!get(len)) {
+        return false;
+    }
+
+    std::string str(len, ' ');
+    if (!m_file.read(&str[0], len)) {
+        return false;
+    }
+
+    std::istringstream iss{str};
+    return static_cast<bool>(iss >> val);
+}
+
+bool CkptReader::get(Root_of_2 &val) {
+    bool bIsExtended = false;
+    FT a0, a1, root;
+    if (!get(bIsExtended) || !get(a0)
+        || (bIsExtended && !(get(a1) && get(root)))) {
+        return false;
+    }
+
+    val = bIsExtended ? Root_of_2{a0, a1, root} : Root_of_2{a0};
+    return true;
+}
+
+bool CkptReader::get(Circular_arc_point_2 &pnt) {
+    Root_of_2 x, y;
+    if (!get(x) || !get(y)) {
+        return false;
+    }
+
+    pnt = Circular_arc_point_2{CK::Root_for_circles_2_2{x, y}};
+    return true;
+}
+
+void sortSites(std::vector<SiteData> &sites) {
+    std::stable_sort(sites.begin(), sites.end(),
+                     [](const SiteData &lhs, const SiteData &rhs) {
+                         if (std::get<2>(lhs) != std::get<2>(rhs)) {
+                             return std::get<2>(lhs) > std::get<2>(rhs);
+                         }
+
+                         return std::pow(std::get<0>(lhs), 2.) + std::pow(std::get<1>(lhs), 2.)
+                                 > std::pow(std::get<0>(rhs), 2.) + std::pow(std::get<1>(rhs), 2.);
+                     });
+}
+
+bool convertBinToIpe(const std::string &binFilePath, const std::string &ipeFilePath) {
+    const auto br = BinReader{binFilePath};
+    if (!br.isValid()) {
+        std::cout << "Unable to read " << binFilePath << "\n";
+        return false;
+    }
+
+    IpeWriter iw{ipeFilePath, {"Sites", "VorDiag"}};
+
+    for (const auto &site : br.sites()) {
+        std::ostringstream strs;
+        strs << "$s_" << site.id << "\\,(" << site.w / 1e3 << ")$";
+        iw.add(WvdVert{site.x, site.y}, "Sites", IPE_SCALE,
+               "seagreen", "large", strs.str());
+    }
+
+    for (const auto &edge : br.edges()) {
+        iw.add(edge, br.verts(), "VorDiag", IPE_SCALE, "black", "fat");
+    }
+
+    return iw.close();
+}
+
+bool writeSites(const std::string &filePath, const std::vector<SiteData> &sites,
+                bool bAppend) {
+    std::ofstream file;
+    file.open(filePath, std::ofstream::out
+              | (bAppend ? std::ofstream::app : std::ofstream::trunc));
+    if (!file.is_open()) {
+        return false;
+    }
+
+    for (const auto &s : sites) {
+        file << std::get<0>(s) << " " << std::get<1>(s) << " " << std::get<2>(s)
+                << " " << std::get<3>(s) << "\n";
+    }
+
+    return file.good();
+}
+
+SiteStream::SiteStream(const std::string &filePath) {
+    m_file.open(filePath, std::ifstream::in);
+    m_bHasIds = filePath.substr(filePath.find_last_of(".") + 1) == "sites";
+}
+
+bool SiteStream::next(SiteData &site) {
+    std::string line;
+    while (std::getline(m_file, line)) {
+        std::istringstream iss{line};
+        int x, y, w, id;
+        if (!(iss >> x >> y >> w)) {
+            continue;
+        }
+
+        if (m_bHasIds) {
+            if (!(iss >> id)) {
+                continue;
+            }
+        } else {
+            id = m_siteId++;
+        }
+
+        site = std::make_tuple(x, y, w, id);
+        return true;
+    }
+
+    return false;
 }
 
 FileReader::FileReader(const std::string &filePath) {
@@ -390,6 +822,8 @@ FileReader::FileReader(const std::string &filePath) {
 
     if (suffix == "pnts") {
         readPnts();
+    } else if (suffix == "sites") {
+        readSites();
     } else if (suffix == "graphml") {
         readGraphml();
     }
@@ -417,6 +851,19 @@ void FileReader::readPnts() {
     }
 }
 
+void FileReader::readSites() {
+    if (m_file.is_open()) {
+        std::string line;
+        while (std::getline(m_file, line)) {
+            std::istringstream iss{line};
+            int x, y, w, id;
+            if (iss >> x >> y >> w >> id) {
+                m_sites.push_back(std::make_tuple(x, y, w, id));
+            }
+        }
+    }
+}
+
 void FileReader::readGraphml() {
     if (m_file.is_open()) {
         GraphmlData data{m_file};
@@ -1,7 +1,9 @@
 #ifndef FILE_IO_H
 #define FILE_IO_H
 
+#include <cstdint>
 #include <fstream>
+#include <map>
 #include <regex>
 #include <set>
 #ifdef ENABLE_VIEW
@@ -12,57 +14,271 @@
 // x, y, w, index
 using SiteData = std::tuple<int, int, int, int>;
 
-class IpeObj {
+// Sorts the sites by decreasing weight and, among sites of equal weight, by
+// decreasing distance from the origin (keeping the input order of equal
+// sites). The candidate sets of the overlay refer to sites by their index in
+// this order.
+void sortSites(std::vector<SiteData> &sites);
+
+// Scale of the coordinates in Ipe files.
+const double IPE_SCALE = 1e-4 / 6.;
+
+// Records of the binary diagram format (see BinWriter).
+struct WvdSite {
+    int id;
+    double x;
+    double y;
+    double w;
+};
+
+struct WvdVert {
+    double x;
+    double y;
+};
+
+// An arc runs counterclockwise from src to tgt along the circle with
+// center (cx, cy) and radius r, a segment runs from src to tgt. The edge
+// separates the cells of site1 and site2.
+struct WvdEdge {
+    uint64_t src;
+    uint64_t tgt;
+    int site1;
+    int site2;
+    bool bIsArc;
+    double cx;
+    double cy;
+    double r;
+};
+
+// Writes an Ipe file in a streaming fashion, i.e., every object is
+// formatted directly into the (buffered) output file. Since the header
+// lists all layers, it is written along with the first object, and all
+// layers have to be declared (via the constructor or addLayer()) before.
+class IpeWriter {
 public:
-    IpeObj(const Point_2 &pnt, const std::string &layer,
+    IpeWriter(const std::string &filePath,
+            const std::vector<std::string> &layers = std::vector<std::string>{});
+    ~IpeWriter();
+
+    IpeWriter(const IpeWriter &ipeWriter) = delete;
+    IpeWriter & operator=(const IpeWriter &ipeWriter) = delete;
+
+    void addLayer(const std::string &layer);
+
+    void add(const Point_2 &pnt, const std::string &layer,
             double scale = 1., const std::string &color = "black",
             const std::string &size = "normal", const std::string &label = "");
-    IpeObj(const Circular_arc_point_2 &arcPnt, const std::string &layer,
+    void add(const Circular_arc_point_2 &arcPnt, const std::string &layer,
             double scale = 1., const std::string &color = "black",
             const std::string &size = "normal", const std::string &label = "");
-    IpeObj(const Segment_2 &seg, const std::string &layer,
+    void add(const Segment_2 &seg, const std::string &layer,
             double scale = 1., const std::string &color = "black",
             const std::string &size = "normal");
-    IpeObj(const Circular_arc_2 &arc, const std::string &layer,
+    void add(const Circular_arc_2 &arc, const std::string &layer,
             double scale = 1., const std::string &color = "black",
             const std::string &size = "normal");
-    IpeObj(const Circle_2 &circle, const std::string &layer,
+    void add(const Circle_2 &circle, const std::string &layer,
             double scale = 1., const std::string &color = "black",
             const std::string &size = "normal");
+    void add(const WvdVert &vert, const std::string &layer,
+            double scale = 1., const std::string &color = "black",
+            const std::string &size = "normal", const std::string &label = "");
+    void add(const WvdEdge &edge, const std::vector<WvdVert> &verts,
+            const std::string &layer, double scale = 1.,
+            const std::string &color = "black", const std::string &size = "normal");
 
-    const std::string & str() const {
-        return m_str;
+    // Returns false if objects have been dropped since their layer had not
+    // been declared before the header was written.
+    bool close();
+
+    bool isValid() const {
+        return m_bIsValid;
     }
 
-    const std::string & layer() const {
-        return m_layer;
+private:
+    void writeHeader();
+    bool checkLayer(const std::string &layer);
+    void writePnt(double x, double y, const std::string &layer,
+            const std::string &color, const std::string &size,
+            const std::string &label);
+    bool beginPath(const std::string &layer, const std::string &color,
+            const std::string &size);
+    void putPnt(double x, double y, const char *suffix);
+    void putRadius(double r);
+
+    std::vector<char> m_buf;
+    std::ofstream m_file;
+    std::vector<std::string> m_layers;
+    std::set<std::string> m_layerSet;
+    bool m_bHeaderWritten{false};
+    bool m_bIsValid{true};
+};
+
+// Writes a diagram in the compact binary format (.wvd). The file starts
+// with a header (magic, version, number of sites, vertices and edges),
+// followed by a stream of tagged site, vertex, arc and segment records.
+// Records are written as they are added, vertices are deduplicated and the
+// counts of the header are patched on close().
+class BinWriter {
+public:
+    BinWriter(const std::string &filePath);
+    ~BinWriter();
+
+    BinWriter(const BinWriter &binWriter) = delete;
+    BinWriter & operator=(const BinWriter &binWriter) = delete;
+
+    bool isOpen() const {
+        return m_file.is_open();
     }
 
+    void addSite(int id, double x, double y, double w);
+    // The degrees are the numbers of edges at the end points. An end point
+    // is forgotten once all of its edges have been written, or it is kept
+    // until clearVerts() if its degree is 0 (unknown).
+    void addArc(double x1, double y1, double x2, double y2,
+            int site1, int site2, double cx, double cy, double r,
+            size_t degree1 = 0, size_t degree2 = 0);
+    void addSeg(double x1, double y1, double x2, double y2,
+            int site1, int site2, size_t degree1 = 0, size_t degree2 = 0);
+    // Forgets the written vertices except for those in keep, such that the
+    // memory does not grow with the output; vertices that are added again
+    // are written again.
+    void clearVerts(const std::vector<std::pair<double, double>> &keep);
+    void close();
+
 private:
-    std::string m_str;
-    double m_thickness;
-    std::string m_layer;
+    uint64_t addVert(double x, double y, size_t degree);
+    void writeHeader();
+
+    template<typename T>
+    void put(const T &val) {
+        m_file.write(reinterpret_cast<const char *>(&val), sizeof(T));
+    }
+
+    std::ofstream m_file;
+    // The ids of the written vertices that may be added again and the
+    // numbers of their edges that are still to be written (0 if unknown).
+    std::map<std::pair<double, double>, std::pair<uint64_t, size_t>> m_vertIds;
+    uint64_t m_nSites{0};
+    uint64_t m_nVerts{0};
+    uint64_t m_nEdges{0};
 };
 
-class IpeWriter {
+// Reads a diagram that has been written by a BinWriter.
+class BinReader {
 public:
-    IpeWriter(const std::string &filePath);
+    BinReader(const std::string &filePath);
+
+    bool isValid() const {
+        return m_bIsValid;
+    }
 
-    void addIpeObj(const IpeObj &ipeObj) {
-        m_ipeObjs.push_back(ipeObj);
-        m_layers.insert(ipeObj.layer());
+    const std::vector<WvdSite> & sites() const {
+        return m_sites;
+    }
+
+    const std::vector<WvdVert> & verts() const {
+        return m_verts;
     }
 
-    void write();
+    const std::vector<WvdEdge> & edges() const {
+        return m_edges;
+    }
 
 private:
-    void copyFile(const std::string &filePath);
+    template<typename T>
+    bool get(T &val) {
+        return static_cast<bool>(m_file.read(reinterpret_cast<char *>(&val), sizeof(T)));
+    }
+
+    std::vector<WvdSite> m_sites;
+    std::vector<WvdVert> m_verts;
+    std::vector<WvdEdge> m_edges;
+    std::ifstream m_file;
+    bool m_bIsValid{false};
+};
+
+// Writes a checkpoint of the sweep (see VorDiagOpts::ckptFilePath) in a
+// binary format. Exact numbers are written as the decimal strings of their
+// rational parts, such that a resumed sweep computes identical results. The
+// checkpoint is written to a temporary file that replaces the previous one
+// on close(), hence a crash never leaves a partial checkpoint behind.
+class CkptWriter {
+public:
+    CkptWriter(const std::string &filePath);
+
+    CkptWriter(const CkptWriter &ckptWriter) = delete;
+    CkptWriter & operator=(const CkptWriter &ckptWriter) = delete;
+
+    bool isOpen() const {
+        return m_file.is_open();
+    }
 
-    std::vector<IpeObj> m_ipeObjs;
-    std::set<std::string> m_layers;
+    template<typename T>
+    void put(const T &val) {
+        m_file.write(reinterpret_cast<const char *>(&val), sizeof(T));
+    }
+
+    void put(const FT &val);
+    void put(const Root_of_2 &val);
+    void put(const Circular_arc_point_2 &pnt);
+    bool close();
+
+private:
+    std::string m_filePath;
     std::ofstream m_file;
 };
 
+// Reads a checkpoint that has been written by a CkptWriter.
+class CkptReader {
+public:
+    CkptReader(const std::string &filePath);
+
+    bool isValid() const {
+        return m_bIsValid;
+    }
+
+    template<typename T>
+    bool get(T &val) {
+        return static_cast<bool>(m_file.read(reinterpret_cast<char *>(&val), sizeof(T)));
+    }
+
+    bool get(FT &val);
+    bool get(Root_of_2 &val);
+    bool get(Circular_arc_point_2 &pnt);
+
+private:
+    std::ifstream m_file;
+    bool m_bIsValid{false};
+};
+
+// Converts a binary diagram file into an Ipe file.
+bool convertBinToIpe(const std::string &binFilePath, const std::string &ipeFilePath);
+
+// Writes sites to a .sites file, i.e., one line x y w id per site, which
+// keeps the ids (unlike .pnts files). If bAppend is true, the sites are
+// appended to the file.
+bool writeSites(const std::string &filePath, const std::vector<SiteData> &sites,
+        bool bAppend = false);
+
+// Reads the sites of a .pnts or a .sites file one at a time, such that the
+// sites need not fit into memory.
+class SiteStream {
+public:
+    SiteStream(const std::string &filePath);
+
+    bool isOpen() const {
+        return m_file.is_open();
+    }
+
+    bool next(SiteData &site);
+
+private:
+    std::ifstream m_file;
+    bool m_bHasIds{false};
+    int m_siteId{0};
+};
+
 class FileReader {
 public:
     FileReader(const std::string &filePath);
@@ -73,6 +289,7 @@ public:
 
 private:
     void readPnts();
+    void readSites();
     void readGraphml();
 
     std::vector<std::string> split(const std::string &str,
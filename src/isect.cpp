@@ -29,9 +29,31 @@ const MovIsectId MovIsect::id() const {
 
 void MovIsect::setIsWfVert(const Root_of_2 &sqrdTime, bool bIsWfVert) {
     m_switches.push_back(std::make_pair(sqrdTime, bIsWfVert));
+    m_switchVerts.push_back(-1);
     m_bIsWfVert = bIsWfVert;
 }
 
+bool MovIsect::hasUnstampedSwitch() const {
+    return !m_switchVerts.empty() && m_switchVerts.back() < 0;
+}
+
+void MovIsect::stampSwitches(int vertId) {
+    for (auto it = m_switchVerts.rbegin(); it != m_switchVerts.rend() && *it < 0; ++it) {
+        *it = vertId;
+    }
+}
+
+void MovIsect::restampSwitches(int oldVertId, int newVertId) {
+    std::replace(m_switchVerts.begin(), m_switchVerts.end(), oldVertId, newVertId);
+}
+
+void MovIsect::restore(bool bIsWfVert, std::vector<std::pair<Root_of_2, bool>> switches,
+                       std::vector<int> switchVerts) {
+    m_bIsWfVert = bIsWfVert;
+    m_switches = std::move(switches);
+    m_switchVerts = std::move(switchVerts);
+}
+
 std::string MovIsect::toString() const {
     std::stringstream strs;
     strs << std::boolalpha << "(" << std::get<0>(id()) << ", " 
@@ -30,11 +30,24 @@ public:
         return m_switches;
     }
 
+    // Returns the ids of the Voronoi vertices at which the switches took
+    // place (-1 if a switch has not been stamped yet).
+    const std::vector<int> & switchVerts() const {
+        return m_switchVerts;
+    }
+
     bool isWfVert() const {
         return m_bIsWfVert;
     }
 
     void setIsWfVert(const Root_of_2 &sqrdTime, bool bIsWfVert);
+    bool hasUnstampedSwitch() const;
+    void stampSwitches(int vertId);
+    // Replaces the vertex id oldVertId of the stamped switches by newVertId.
+    void restampSwitches(int oldVertId, int newVertId);
+    // Restores the state from a checkpoint of the sweep.
+    void restore(bool bIsWfVert, std::vector<std::pair<Root_of_2, bool>> switches,
+            std::vector<int> switchVerts);
     
     std::string toString() const;
 
@@ -43,6 +56,7 @@ private:
     TrajPtr m_traj;
     bool m_bIsWfVert{true};
     std::vector<std::pair<Root_of_2, bool>> m_switches;
+    std::vector<int> m_switchVerts;
 };
 
 #endif /* ISECT_H */
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
+#include <boost/thread.hpp>
+#include "locate.h"
+
+// The maximum angle spanned by a piece of an arc and the maximum number of
+// pieces per edge.
+const double MAX_PIECE_ANGLE = M_PI / 18.;
+const size_t MAX_PIECES = 1 << 16;
+
+SiteLocator::SiteLocator(const std::vector<SitePtr> &sites, const VorDcel &dcel,
+                         size_t nCells) {
+    std::unordered_map<int, int> siteIndices;
+    for (const auto &site : sites) {
+        const auto pnt = site->center();
+        double w = CGAL::to_double(site->weight());
+        siteIndices[site->id()] = static_cast<int>(m_ids.size());
+        m_ids.push_back(site->id());
+        m_xs.push_back(CGAL::to_double(pnt.x()));
+        m_ys.push_back(CGAL::to_double(pnt.y()));
+        m_invSqrdWgts.push_back(1. / (w * w));
+    }
+
+    if (m_ids.empty()) {
+        m_offsets.assign(2, 0);
+        return;
+    }
+
+    // The grid covers the bounding box of the sites (enlarged by 10%) by
+    // roughly nCells square cells.
+    const auto xs = std::minmax_element(m_xs.begin(), m_xs.end());
+    const auto ys = std::minmax_element(m_ys.begin(), m_ys.end());
+    double width = std::max(*xs.second - *xs.first, 1.),
+            height = std::max(*ys.second - *ys.first, 1.);
+    m_xMin = *xs.first - width / 20.;
+    m_yMin = *ys.first - height / 20.;
+    width *= 1.1;
+    height *= 1.1;
+
+    if (nCells == 0) {
+        nCells = std::max<size_t>(16, 4 * m_ids.size());
+    }
+
+    m_cellSize = std::sqrt(width * height / nCells);
+    m_nx = std::max<size_t>(1, static_cast<size_t>(std::ceil(width / m_cellSize)));
+    m_ny = std::max<size_t>(1, static_cast<size_t>(std::ceil(height / m_cellSize)));
+
+    // The edges of the DCEL refer to sites by id, the grid stores indices.
+    std::vector<std::vector<int>> cands(m_nx * m_ny);
+    addEdgeCands(cands, dcel);
+    for (auto &cell : cands) {
+        for (auto &cand : cell) {
+            cand = siteIndices.at(cand);
+        }
+    }
+
+    addCenterCands(cands);
+
+    m_offsets.reserve(cands.size() + 1);
+    m_offsets.push_back(0);
+    for (auto &cell : cands) {
+        std::sort(cell.begin(), cell.end());
+        cell.erase(std::unique(cell.begin(), cell.end()), cell.end());
+        m_cands.insert(m_cands.end(), cell.begin(), cell.end());
+        m_offsets.push_back(m_cands.size());
+        m_maxCands = std::max(m_maxCands, cell.size());
+    }
+}
+
+int SiteLocator::locate(double x, double y) const {
+    if (m_ids.empty()) {
+        return -1;
+    }
+
+    size_t cell;
+    if (!cellOf(x, y, cell)) {
+        return m_ids.at(nearest(x, y));
+    }
+
+    const int *cands = m_cands.data();
+    return m_ids.at(nearest(x, y, cands + m_offsets.at(cell),
+                            cands + m_offsets.at(cell + 1)));
+}
+
+std::vector<int> SiteLocator::locate(const std::vector<QueryPnt> &pnts,
+                                     size_t nThreads) const {
+    std::vector<int> res(pnts.size());
+    nThreads = std::max<size_t>(1, std::min(nThreads, pnts.size() / 1024));
+
+    const auto fLocate = [&](size_t i) {
+        size_t begin = pnts.size() * i / nThreads,
+                end = pnts.size() * (i + 1) / nThreads;
+        for (size_t j = begin; j < end; j++) {
+            res[j] = locate(pnts[j].first, pnts[j].second);
+        }
+    };
+
+    if (nThreads == 1) {
+        fLocate(0);
+    } else {
+        boost::thread_group threads;
+        for (size_t i = 0; i < nThreads; i++) {
+            threads.create_thread([&fLocate, i]() {
+                fLocate(i);
+            });
+        }
+
+        threads.join_all();
+    }
+
+    return res;
+}
+
+double SiteLocator::avgCands() const {
+    return m_offsets.size() > 1
+            ? static_cast<double>(m_cands.size()) / (m_offsets.size() - 1) : 0.;
+}
+
+// Both sites of every edge become candidates of all cells that the edge
+// passes through. The edges are split into short pieces, and a piece marks
+// all cells that intersect its bounding box (enlarged by the distance
+// between the piece of an arc and its chord).
+void SiteLocator::addEdgeCands(std::vector<std::vector<int>> &cands,
+                               const VorDcel &dcel) const {
+    const auto &halfEdges = dcel.halfEdges();
+    const auto &verts = dcel.verts();
+    double xMax = m_xMin + m_nx * m_cellSize, yMax = m_yMin + m_ny * m_cellSize;
+
+    for (size_t h = 0; h < halfEdges.size(); h++) {
+        const auto &he = halfEdges.at(h);
+        if (he.twin < static_cast<int>(h)) {
+            continue;
+        }
+
+        int site1 = he.site, site2 = halfEdges.at(he.twin).site;
+        const auto &src = verts.at(he.origin), &tgt = verts.at(dcel.target(h));
+
+        if (he.bIsArc) {
+            const auto &from = he.bIsCcw ? src : tgt, &to = he.bIsCcw ? tgt : src;
+            double start = std::atan2(from.y - he.cy, from.x - he.cx),
+                    theta = std::atan2(to.y - he.cy, to.x - he.cx) - start;
+            if (theta <= 0.) {
+                theta += 2 * M_PI;
+            }
+
+            size_t nPieces = static_cast<size_t>(std::ceil(std::max(
+                    theta / MAX_PIECE_ANGLE, he.r * theta / m_cellSize)));
+            nPieces = std::max<size_t>(1, std::min(nPieces, MAX_PIECES));
+            double step = theta / nPieces,
+                    margin = he.r * (1. - std::cos(step / 2.));
+
+            double x1 = from.x, y1 = from.y;
+            for (size_t i = 1; i <= nPieces; i++) {
+                double angle = start + i * step;
+                double x2 = i == nPieces ? to.x : he.cx + he.r * std::cos(angle),
+                        y2 = i == nPieces ? to.y : he.cy + he.r * std::sin(angle);
+                addPieceCands(cands, x1, y1, x2, y2, margin, site1, site2);
+                x1 = x2;
+                y1 = y2;
+            }
+        } else {
+            // Clips the segment to the grid first, as the bisectors of sites
+            // of equal weight reach far beyond it.
+            double dx = tgt.x - src.x, dy = tgt.y - src.y, tMin = 0., tMax = 1.;
+            const double ps[] = {-dx, dx, -dy, dy},
+                    qs[] = {src.x - m_xMin, xMax - src.x, src.y - m_yMin, yMax - src.y};
+            bool bIsInside = true;
+            for (int i = 0; i < 4 && bIsInside; i++) {
+                if (ps[i] == 0.) {
+                    bIsInside = qs[i] >= 0.;
+                } else if (ps[i] < 0.) {
+                    tMin = std::max(tMin, qs[i] / ps[i]);
+                } else {
+                    tMax = std::min(tMax, qs[i] / ps[i]);
+                }
+            }
+
+            if (!bIsInside || tMin > tMax) {
+                continue;
+            }
+
+            double len = (tMax - tMin) * std::sqrt(dx * dx + dy * dy);
+            size_t nPieces = static_cast<size_t>(std::ceil(len / m_cellSize));
+            nPieces = std::max<size_t>(1, std::min(nPieces, MAX_PIECES));
+            double step = (tMax - tMin) / nPieces;
+            for (size_t i = 0; i < nPieces; i++) {
+                double t1 = tMin + i * step, t2 = t1 + step;
+                addPieceCands(cands, src.x + t1 * dx, src.y + t1 * dy,
+                              src.x + t2 * dx, src.y + t2 * dy, 0., site1, site2);
+            }
+        }
+    }
+}
+
+void SiteLocator::addPieceCands(std::vector<std::vector<int>> &cands,
+                                double x1, double y1, double x2, double y2,
+                                double margin, int site1, int site2) const {
+    double xLo = (std::min(x1, x2) - margin - m_xMin) / m_cellSize,
+            xHi = (std::max(x1, x2) + margin - m_xMin) / m_cellSize,
+            yLo = (std::min(y1, y2) - margin - m_yMin) / m_cellSize,
+            yHi = (std::max(y1, y2) + margin - m_yMin) / m_cellSize;
+    if (xHi < 0. || yHi < 0. || xLo >= m_nx || yLo >= m_ny) {
+        return;
+    }
+
+    size_t ixLo = static_cast<size_t>(std::max(xLo, 0.)),
+            ixHi = static_cast<size_t>(std::min(xHi, m_nx - 1.)),
+            iyLo = static_cast<size_t>(std::max(yLo, 0.)),
+            iyHi = static_cast<size_t>(std::min(yHi, m_ny - 1.));
+    for (size_t iy = iyLo; iy <= iyHi; iy++) {
+        for (size_t ix = ixLo; ix <= ixHi; ix++) {
+            auto &cell = cands.at(iy * m_nx + ix);
+            cell.push_back(site1);
+            cell.push_back(site2);
+        }
+    }
+}
+
+// Adds the owner of the center of every cell. The owner of a center differs
+// from the owner of the center of a neighboring cell only if a Voronoi edge
+// separates both, i.e., only if it is a candidate of one of both cells. Thus,
+// the owners are propagated from cell to cell, and only the first cell needs
+// to be located by brute force.
+void SiteLocator::addCenterCands(std::vector<std::vector<int>> &cands) const {
+    std::vector<int> owners(cands.size(), -1);
+    std::vector<int> tmp;
+
+    for (size_t iy = 0; iy < m_ny; iy++) {
+        for (size_t ix = 0; ix < m_nx; ix++) {
+            size_t cell = iy * m_nx + ix;
+            double x = m_xMin + (ix + .5) * m_cellSize,
+                    y = m_yMin + (iy + .5) * m_cellSize;
+            if (cell == 0) {
+                owners.at(cell) = nearest(x, y);
+                continue;
+            }
+
+            size_t prev = ix > 0 ? cell - 1 : cell - m_nx;
+            tmp.assign(cands.at(cell).begin(), cands.at(cell).end());
+            tmp.insert(tmp.end(), cands.at(prev).begin(), cands.at(prev).end());
+            tmp.push_back(owners.at(prev));
+            owners.at(cell) = nearest(x, y, tmp.data(), tmp.data() + tmp.size());
+        }
+    }
+
+    for (size_t cell = 0; cell < cands.size(); cell++) {
+        cands.at(cell).push_back(owners.at(cell));
+    }
+}
+
+int SiteLocator::nearest(double x, double y, const int *begin, const int *end) const {
+    int res = -1;
+    double minDist = std::numeric_limits<double>::infinity();
+    for (const int *it = begin; it != end; ++it) {
+        double dx = x - m_xs[*it], dy = y - m_ys[*it],
+                dist = (dx * dx + dy * dy) * m_invSqrdWgts[*it];
+        if (dist < minDist || (dist == minDist && *it < res)) {
+            minDist = dist;
+            res = *it;
+        }
+    }
+
+    return res;
+}
+
+int SiteLocator::nearest(double x, double y) const {
+    int res = -1;
+    double minDist = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < m_ids.size(); i++) {
+        double dx = x - m_xs[i], dy = y - m_ys[i],
+                dist = (dx * dx + dy * dy) * m_invSqrdWgts[i];
+        if (dist < minDist) {
+            minDist = dist;
+            res = static_cast<int>(i);
+        }
+    }
+
+    return res;
+}
+
+bool SiteLocator::cellOf(double x, double y, size_t &cell) const {
+    double fx = (x - m_xMin) / m_cellSize, fy = (y - m_yMin) / m_cellSize;
+    if (!(fx >= 0. && fy >= 0. && fx < m_nx && fy < m_ny)) {
+        return false;
+    }
+
+    cell = static_cast<size_t>(fy) * m_nx + static_cast<size_t>(fx);
+    return true;
+}
+
+std::vector<QueryPnt> readQueryPnts(const std::string &filePath) {
+    std::vector<QueryPnt> res;
+    std::ifstream file;
+    file.open(filePath, std::ifstream::in);
+    if (!file.is_open()) {
+        return res;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss{line};
+        double x, y;
+        if (iss >> x >> y) {
+            res.emplace_back(x, y);
+        }
+    }
+
+    return res;
+}
+
+bool writeLocations(const std::string &filePath, const std::vector<int> &siteIds) {
+    std::ofstream file;
+    file.open(filePath, std::ofstream::out | std::ofstream::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    for (int id : siteIds) {
+        file << id << "\n";
+    }
+
+    return true;
+}
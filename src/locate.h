@@ -0,0 +1,66 @@
+#ifndef LOCATE_H
+#define LOCATE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "sites.h"
+#include "dcel.h"
+
+using QueryPnt = std::pair<double, double>;
+
+// Answers weighted point-location queries on a computed diagram, i.e.,
+// returns the site whose (multiplicatively weighted) distance to a query
+// point is minimal. The index is a uniform grid over the bounding box of the
+// sites, where every grid cell stores the sites whose Voronoi cells may
+// intersect it: the owner of its center plus the sites along the Voronoi
+// edges that pass through it. A query evaluates the candidates of its grid
+// cell only; points outside of the grid are answered by brute force.
+class SiteLocator {
+public:
+    SiteLocator(const std::vector<SitePtr> &sites, const VorDcel &dcel,
+            size_t nCells = 0);
+
+    // Returns the id of the site that dominates (x, y).
+    int locate(double x, double y) const;
+    std::vector<int> locate(const std::vector<QueryPnt> &pnts,
+            size_t nThreads) const;
+
+    size_t maxCands() const {
+        return m_maxCands;
+    }
+
+    double avgCands() const;
+
+private:
+    void addEdgeCands(std::vector<std::vector<int>> &cands,
+            const VorDcel &dcel) const;
+    void addPieceCands(std::vector<std::vector<int>> &cands,
+            double x1, double y1, double x2, double y2, double margin,
+            int site1, int site2) const;
+    void addCenterCands(std::vector<std::vector<int>> &cands) const;
+    int nearest(double x, double y, const int *begin, const int *end) const;
+    int nearest(double x, double y) const;
+    bool cellOf(double x, double y, size_t &cell) const;
+
+    // The sites (by index) as arrays of coordinates and inverse squared
+    // weights.
+    std::vector<int> m_ids;
+    std::vector<double> m_xs;
+    std::vector<double> m_ys;
+    std::vector<double> m_invSqrdWgts;
+    // The grid and the candidates of its cells in compressed form.
+    double m_xMin{0.};
+    double m_yMin{0.};
+    double m_cellSize{1.};
+    size_t m_nx{1};
+    size_t m_ny{1};
+    std::vector<size_t> m_offsets;
+    std::vector<int> m_cands;
+    size_t m_maxCands{0};
+};
+
+std::vector<QueryPnt> readQueryPnts(const std::string &filePath);
+bool writeLocations(const std::string &filePath, const std::vector<int> &siteIds);
+
+#endif /* LOCATE_H */
@@ -1,14 +1,157 @@
+#include <chrono>
+#include <cstdio>
 #include <iostream>
+#include <sstream>
 #include <boost/program_options.hpp>
+#include <boost/thread.hpp>
 #ifdef ENABLE_VIEW
 #include <QApplication>
 #endif
 #include "view.h"
 #include "mwvd.h"
+#include "file_io.h"
+#include "locate.h"
+#include "raster.h"
+#include "tiles.h"
 #include "log.h"
 
 namespace po = boost::program_options;
 
+// Parses a comma-separated list of non-negative times.
+static bool parseTimes(const std::string &str, std::vector<double> &times) {
+    std::istringstream strs{str};
+    std::string token;
+    while (std::getline(strs, token, ',')) {
+        std::istringstream tokenStrs{token};
+        double time = -1.;
+        if (!(tokenStrs >> time) || time < 0.) {
+            return false;
+        }
+
+        times.push_back(time);
+    }
+
+    return !times.empty();
+}
+
+// Deletes, reweights and inserts sites (in this order) and reports the time
+// taken by the updates.
+static bool updateDiagram(VorDiag &vorDiag, const po::variables_map &vm) {
+    std::vector<int> deleteIds;
+    std::vector<std::pair<int, int>> weights;
+    std::vector<SiteData> insertSites;
+    std::string token;
+
+    if (vm.count("delete-sites")) {
+        std::istringstream strs{vm["delete-sites"].as<std::string>()};
+        while (std::getline(strs, token, ',')) {
+            int id;
+            if (std::sscanf(token.c_str(), "%d", &id) != 1) {
+                std::cout << "Invalid site id " << token << ".\n";
+                return false;
+            }
+
+            deleteIds.push_back(id);
+        }
+    }
+
+    if (vm.count("reweight-sites")) {
+        std::istringstream strs{vm["reweight-sites"].as<std::string>()};
+        while (std::getline(strs, token, ',')) {
+            int id, weight;
+            if (std::sscanf(token.c_str(), "%d:%d", &id, &weight) != 2 || weight <= 0) {
+                std::cout << "Invalid weight " << token << ".\n";
+                return false;
+            }
+
+            weights.emplace_back(id, weight);
+        }
+    }
+
+    if (vm.count("insert-file")) {
+        insertSites = FileReader{vm["insert-file"].as<std::string>()}.sites();
+
+        // The ids of the inserted sites follow the ids of the diagram.
+        int nextId = 0;
+        for (const auto &site : vorDiag.sites()) {
+            nextId = std::max(nextId, site->id() + 1);
+        }
+
+        for (auto &site : insertSites) {
+            std::get<3>(site) = nextId++;
+        }
+    }
+
+    std::cout << "Updating the diagram ...\n";
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (int id : deleteIds) {
+        if (!vorDiag.deleteSite(id)) {
+            std::cout << "There is no site " << id << ".\n";
+        }
+    }
+
+    for (const auto &weight : weights) {
+        if (!vorDiag.reweightSite(weight.first, weight.second)) {
+            std::cout << "There is no site " << weight.first << ".\n";
+        }
+    }
+
+    for (const auto &site : insertSites) {
+        vorDiag.insertSite(site);
+    }
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    std::cout << deleteIds.size() << " deletions, " << weights.size() << " weight changes and "
+            << insertSites.size() << " insertions took "
+            << std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count()
+            << " us\n";
+
+    return true;
+}
+
+// Rasterizes the sites over box (or their bounding box, if box is empty) and
+// writes the raster file (if given). If vorDiag is given, the raster is
+// cross-checked against the diagram.
+static bool writeRasterOf(const NearestSiteKernel &kernel, const po::variables_map &vm,
+                          RasterBox box, size_t nThreads, const VorDiag *vorDiag) {
+    if (!(box.xMin < box.xMax)) {
+        box = kernel.bbox();
+    }
+
+    size_t size = std::max<size_t>(1, vm["raster-size"].as<size_t>());
+    double aspect = (box.yMax - box.yMin) / (box.xMax - box.xMin);
+    size_t width = aspect <= 1. ? size : std::max<size_t>(1, size / aspect),
+            height = aspect <= 1. ? std::max<size_t>(1, size * aspect) : size;
+
+    std::cout << "Rasterizing " << kernel.size() << " sites on " << width << " x "
+            << height << " pixels ...\n";
+    auto t0 = std::chrono::high_resolution_clock::now();
+    const auto labels = rasterize(kernel, box, width, height, nThreads);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    std::cout << "Raster computed in "
+            << std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count()
+            << " us\n";
+
+    if (vm.count("raster-file")) {
+        const auto filePath = vm["raster-file"].as<std::string>();
+        std::cout << "Writing raster to " << filePath << " ...\n";
+        if (!writeRaster(filePath, kernel, labels, width, height)) {
+            return false;
+        }
+    }
+
+    if (vorDiag) {
+        std::cout << "Cross-checking the diagram ...\n";
+        const auto locator = SiteLocator{vorDiag->sites(), vorDiag->dcel()};
+        size_t nMismatches = crossCheck(kernel, locator, labels, box, width, height,
+                                        nThreads);
+        std::cout << nMismatches << " of " << labels.size() << " pixels disagree\n";
+        return nMismatches == 0;
+    }
+
+    return true;
+}
+
 int main(int argc, char *argv[]) {
 #ifdef ENABLE_LOGGING
     Log::init();
@@ -19,6 +162,38 @@ int main(int argc, char *argv[]) {
             ("input-file", po::value<std::string>(), "input file")
             ("ipe-file", po::value<std::string>(), "write output to Ipe file")
             ("csv-file", po::value<std::string>(), "append runtime data to CSV file")
+            ("bin-file", po::value<std::string>(), "write output to binary file")
+            ("dcel-file", po::value<std::string>(), "write DCEL of the diagram to file")
+            ("threads", po::value<size_t>(), "number of threads (default: one per core)")
+            ("parallel-sweep", "handle independent events of the sweep concurrently")
+            ("no-delaunay", "run the sweep even if all sites have the same weight")
+            ("cand-mode", po::value<std::string>(), "candidates of the collisions: auto, all, overlay, classes or grid")
+            ("queue", po::value<std::string>(), "event queue: heap (default) or buckets")
+            ("overlay-cache", po::value<std::string>(), "cache the overlay in the given directory")
+            ("checkpoint-file", po::value<std::string>(), "write checkpoints of the sweep to file")
+            ("checkpoint-events", po::value<size_t>(), "write a checkpoint after every n events")
+            ("checkpoint-secs", po::value<double>(), "write a checkpoint after every s seconds")
+            ("resume", "resume the sweep from the checkpoint file (if it exists)")
+            ("max-time", po::value<double>(), "process events only up to the given (weighted) time")
+            ("clip-box", po::value<std::string>(), "compute the diagram only within xmin,ymin,xmax,ymax")
+            ("snapshot-times", po::value<std::string>(), "record the sweep and restore the wavefront at t1,t2,...")
+            ("snapshot-file", po::value<std::string>(), "write the wavefronts at the snapshot times to Ipe file")
+            ("insert-file", po::value<std::string>(), "insert the sites of file one at a time into the diagram")
+            ("delete-sites", po::value<std::string>(), "delete the sites id1,id2,... from the diagram")
+            ("reweight-sites", po::value<std::string>(), "change the weights of the sites id1:w1,id2:w2,...")
+            ("check-updates", "compare the updated diagram with the diagram computed from scratch")
+            ("locate-file", po::value<std::string>(), "locate the query points of file")
+            ("locate-out", po::value<std::string>(), "write the located sites to file")
+            ("raster-file", po::value<std::string>(), "write label image (.pgm) or color image (.ppm) to file")
+            ("raster-size", po::value<size_t>()->default_value(1024), "longer side of the raster in pixels")
+            ("raster-box", po::value<std::string>(), "raster area as xmin,ymin,xmax,ymax (default: bounding box)")
+            ("preview", "write the raster by brute force only, without computing the diagram")
+            ("validate", "cross-check the diagram against the brute force raster")
+            ("tiles", po::value<size_t>(), "compute the diagram in n x n tiles by worker processes")
+            ("tile-dir", po::value<std::string>()->default_value("."), "directory of the files of the workers")
+            ("tile-workers", po::value<size_t>(), "number of concurrent workers (default: one per core)")
+            ("tile-launcher", po::value<std::string>(), "command that precedes every worker command")
+            ("out-of-core", po::value<size_t>(), "stream the input and compute tiles of about n sites each")
             ("view", "open OpenGL interface")
             ;
 
@@ -38,17 +213,259 @@ int main(int argc, char *argv[]) {
         bool bEnableView = vm.count("view");
 
         const auto inFile = vm["input-file"].as<std::string>();
-        std::string ipeFile, csvFile;
+        auto opts = VorDiagOpts{};
+        opts.bEnableView = bEnableView;
         if (vm.count("ipe-file")) {
-            ipeFile = vm["ipe-file"].as<std::string>();
+            opts.ipeFilePath = vm["ipe-file"].as<std::string>();
         }
 
         if (vm.count("csv-file")) {
-            csvFile = vm["csv-file"].as<std::string>();
+            opts.csvFilePath = vm["csv-file"].as<std::string>();
+        }
+
+        if (vm.count("bin-file")) {
+            opts.binFilePath = vm["bin-file"].as<std::string>();
         }
 
-        const auto vorDiag = VorDiag{inFile, true, ipeFile, csvFile,
-                                     bEnableView};
+        if (vm.count("dcel-file")) {
+            opts.dcelFilePath = vm["dcel-file"].as<std::string>();
+        }
+
+        if (vm.count("threads")) {
+            opts.nThreads = vm["threads"].as<size_t>();
+        }
+
+        opts.bParallelSweep = vm.count("parallel-sweep");
+        opts.bUseDelaunay = !vm.count("no-delaunay");
+
+        if (vm.count("overlay-cache")) {
+            opts.overlayCacheDir = vm["overlay-cache"].as<std::string>();
+        }
+
+        if (vm.count("checkpoint-file")) {
+            opts.ckptFilePath = vm["checkpoint-file"].as<std::string>();
+            opts.ckptEvCnt = vm.count("checkpoint-events")
+                    ? vm["checkpoint-events"].as<size_t>() : 0;
+            opts.ckptSecs = vm.count("checkpoint-secs")
+                    ? vm["checkpoint-secs"].as<double>() : 0.;
+            opts.bResume = vm.count("resume");
+            if (opts.ckptEvCnt == 0 && opts.ckptSecs <= 0.) {
+                opts.ckptSecs = 600.;
+            }
+        }
+
+        size_t nThreads = opts.nThreads > 0 ? opts.nThreads
+                : std::max(1u, boost::thread::hardware_concurrency());
+
+        if (vm.count("locate-file") || vm.count("validate")) {
+            opts.bCompDcel = true;
+        }
+
+        bool bRaster = vm.count("raster-file") || vm.count("validate");
+        auto rasterBox = RasterBox{0., 0., 0., 0.};
+        if (vm.count("raster-box")
+                && !parseRasterBox(vm["raster-box"].as<std::string>(), rasterBox)) {
+            std::cout << "Invalid raster box.\n";
+            return 1;
+        }
+
+        if (vm.count("cand-mode")) {
+            const auto mode = vm["cand-mode"].as<std::string>();
+            if (mode == "auto") {
+                opts.candMode = CandMode::Auto;
+            } else if (mode == "all") {
+                opts.candMode = CandMode::All;
+            } else if (mode == "overlay") {
+                opts.candMode = CandMode::Overlay;
+            } else if (mode == "classes") {
+                opts.candMode = CandMode::Classes;
+            } else if (mode == "grid") {
+                opts.candMode = CandMode::Grid;
+            } else {
+                std::cout << "Invalid candidate mode.\n";
+                return 1;
+            }
+        }
+
+        if (vm.count("queue")) {
+            const auto type = vm["queue"].as<std::string>();
+            if (type == "heap") {
+                opts.queueType = QueueType::Heap;
+            } else if (type == "buckets") {
+                opts.queueType = QueueType::Buckets;
+            } else {
+                std::cout << "Invalid event queue.\n";
+                return 1;
+            }
+        }
+
+        if (vm.count("max-time")) {
+            opts.maxTime = vm["max-time"].as<double>();
+            if (opts.maxTime < 0.) {
+                std::cout << "The maximum time must not be negative.\n";
+                return 1;
+            }
+        }
+
+        if (vm.count("snapshot-times")) {
+            if (!parseTimes(vm["snapshot-times"].as<std::string>(), opts.snapshotTimes)) {
+                std::cout << "Invalid snapshot times.\n";
+                return 1;
+            }
+
+            if (vm.count("snapshot-file")) {
+                opts.snapshotFilePath = vm["snapshot-file"].as<std::string>();
+            }
+        }
+
+        if (vm.count("clip-box")) {
+            auto clipBox = RasterBox{0., 0., 0., 0.};
+            if (!parseRasterBox(vm["clip-box"].as<std::string>(), clipBox)) {
+                std::cout << "Invalid clip box.\n";
+                return 1;
+            }
+
+            opts.bClip = true;
+            opts.clipBox = CGAL::Bbox_2{clipBox.xMin, clipBox.yMin, clipBox.xMax, clipBox.yMax};
+            if (!vm.count("raster-box")) {
+                rasterBox = clipBox;
+            }
+        }
+
+        if (vm.count("preview")) {
+            if (!vm.count("raster-file")) {
+                std::cout << "A preview requires a raster file.\n";
+                return 1;
+            }
+
+            const auto fr = FileReader{inFile};
+            const auto kernel = NearestSiteKernel{fr.sites()};
+            return writeRasterOf(kernel, vm, rasterBox, nThreads, nullptr) ? 0 : 1;
+        }
+
+        if (vm.count("tiles") || vm.count("out-of-core")) {
+            auto tileOpts = TileOpts{};
+            if (opts.bClip) {
+                tileOpts.box = RasterBox{opts.clipBox.xmin(), opts.clipBox.ymin(),
+                                         opts.clipBox.xmax(), opts.clipBox.ymax()};
+            }
+
+            tileOpts.nTiles = vm.count("tiles")
+                    ? std::max<size_t>(1, vm["tiles"].as<size_t>()) : 0;
+            tileOpts.nWorkers = std::max<size_t>(1, vm.count("tile-workers")
+                    ? vm["tile-workers"].as<size_t>() : boost::thread::hardware_concurrency());
+            tileOpts.nThreads = std::max<size_t>(1, nThreads / tileOpts.nWorkers);
+            tileOpts.workDir = vm["tile-dir"].as<std::string>();
+            tileOpts.workerPath = argv[0];
+            if (vm.count("tile-launcher")) {
+                tileOpts.launcher = vm["tile-launcher"].as<std::string>();
+            }
+
+            auto &tileDiagOpts = tileOpts.vorDiagOpts;
+            tileDiagOpts.candMode = opts.candMode;
+            tileDiagOpts.queueType = opts.queueType;
+            tileDiagOpts.bUseDelaunay = opts.bUseDelaunay;
+            tileDiagOpts.overlayCacheDir = opts.overlayCacheDir;
+            tileDiagOpts.bParallelSweep = opts.bParallelSweep;
+            tileDiagOpts.maxTime = opts.maxTime;
+
+            tileOpts.binFilePath = opts.binFilePath;
+            tileOpts.ipeFilePath = opts.ipeFilePath;
+
+            // Out of core, the tiles are computed by this process unless
+            // workers are requested explicitly.
+            if (vm.count("out-of-core")) {
+                if (!vm.count("tile-workers") && !vm.count("tile-launcher")) {
+                    tileOpts.nThreads = nThreads;
+                    tileOpts.workerPath.clear();
+                }
+
+                return computeOutOfCore(inFile, tileOpts,
+                                        vm["out-of-core"].as<size_t>()) ? 0 : 1;
+            }
+
+            // The sites of .pnts and .sites files are streamed instead of
+            // loaded.
+            const auto ext = inFile.substr(inFile.find_last_of(".") + 1);
+            if (ext == "pnts" || ext == "sites") {
+                return computeOutOfCore(inFile, tileOpts, 0) ? 0 : 1;
+            }
+
+            const auto fr = FileReader{inFile};
+            if (!opts.bClip) {
+                tileOpts.box = NearestSiteKernel{fr.sites()}.bbox();
+            }
+
+            return computeTiled(fr.sites(), tileOpts) ? 0 : 1;
+        }
+
+        // A binary diagram file is converted into an Ipe file.
+        if (inFile.substr(inFile.find_last_of(".") + 1) == "wvd") {
+            if (opts.ipeFilePath.empty()) {
+                std::cout << "Converting a binary diagram file requires an Ipe file.\n";
+                return 1;
+            }
+
+            std::cout << "Writing output to " << opts.ipeFilePath << " ...\n";
+            return convertBinToIpe(inFile, opts.ipeFilePath) ? 0 : 1;
+        }
+
+        if (vm.count("insert-file") || vm.count("delete-sites") || vm.count("reweight-sites")) {
+            opts.bCompEdges = true;
+        }
+
+        auto vorDiag = VorDiag{inFile, opts};
+
+        if (vm.count("locate-file")) {
+            const auto pnts = readQueryPnts(vm["locate-file"].as<std::string>());
+
+            std::cout << "Building point location index ...\n";
+            auto t0 = std::chrono::high_resolution_clock::now();
+            const auto locator = SiteLocator{vorDiag.sites(), vorDiag.dcel()};
+            auto t1 = std::chrono::high_resolution_clock::now();
+
+            std::cout << "Locating " << pnts.size() << " query points ...\n";
+            const auto siteIds = locator.locate(pnts, nThreads);
+            auto t2 = std::chrono::high_resolution_clock::now();
+
+            std::cout << "Index built in "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count()
+                    << " us (" << locator.avgCands() << " candidates per cell on average, "
+                    << locator.maxCands() << " at most), queries answered in "
+                    << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()
+                    << " us\n";
+
+            if (vm.count("locate-out")) {
+                const auto outFile = vm["locate-out"].as<std::string>();
+                std::cout << "Writing located sites to " << outFile << " ...\n";
+                if (!writeLocations(outFile, siteIds)) {
+                    return 1;
+                }
+            }
+        }
+
+        if (bRaster) {
+            const auto kernel = NearestSiteKernel{vorDiag.sites()};
+            if (!writeRasterOf(kernel, vm, rasterBox, nThreads,
+                               vm.count("validate") ? &vorDiag : nullptr)) {
+                return 1;
+            }
+        }
+
+        if (vm.count("insert-file") || vm.count("delete-sites") || vm.count("reweight-sites")) {
+            if (!updateDiagram(vorDiag, vm)) {
+                return 1;
+            }
+
+            if (vm.count("check-updates") && !vorDiag.checkUpdates()) {
+                return 1;
+            }
+
+            if (!opts.ipeFilePath.empty()) {
+                std::cout << "Writing output to " << opts.ipeFilePath << " ...\n";
+                vorDiag.writeToIpe(opts.ipeFilePath);
+            }
+        }
 
 #ifdef ENABLE_VIEW
         if (bEnableView) {
@@ -57,10 +474,6 @@ int main(int argc, char *argv[]) {
             QCoreApplication::setApplicationVersion(QT_VERSION_STR);
             MainWindow mainWindow;
             
-            for (const auto &site : vorDiag.sites()) {
-                mainWindow.addItem(new SiteGraphicsItem{site});
-            }
-
             for (const auto &val : vorDiag.offCircs()) {
                 const auto offCirc = val.second;
                 mainWindow.addItem(new OffCircGraphicsItem{offCirc});
@@ -1,27 +1,55 @@
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <sstream>
 #include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <limits>
 #include <CGAL/MP_Float.h>
+#include <CGAL/Cartesian.h>
+#include <CGAL/Delaunay_triangulation_2.h>
+#include <CGAL/Triangulation_vertex_base_with_info_2.h>
+#include <boost/thread.hpp>
 #include "file_io.h"
 #include "offcirc.h"
 #include "overlay.h"
+#include "cands.h"
 #include "mwvd.h"
 #include "util.h"
 #include "log.h"
+#ifdef ENABLE_VIEW
+#include <QGraphicsSceneHoverEvent>
+#include <QStyleOptionGraphicsItem>
+#endif
 
 Ev::Ev(const Circular_arc_point_2 &arcPnt, const Root_of_2 &sqrdTime, 
        const SitePtr &site)
+: Ev{arcPnt, sqrdTime, site, CGAL::to_interval(sqrdTime)}
+{
+}
+
+Ev::Ev(const Circular_arc_point_2 &arcPnt, const Root_of_2 &sqrdTime,
+       const SitePtr &site, const TimeIval &timeIval)
 : m_arcPnt{arcPnt}
 , m_sqrdTime{sqrdTime}
 , m_site{site}
+, m_timeIval{timeIval}
 {
 }
 
 CollEv::CollEv(const Circular_arc_point_2 &arcPnt, const Root_of_2 &sqrdTime, 
                const SitePtr &site, const TrajPtr &traj1, const TrajPtr &traj2, 
                bool bPierces)
-: Ev{arcPnt, sqrdTime, site}
+: CollEv{arcPnt, sqrdTime, site, traj1, traj2, bPierces, CGAL::to_interval(sqrdTime)}
+{
+}
+
+CollEv::CollEv(const Circular_arc_point_2 &arcPnt, const Root_of_2 &sqrdTime,
+               const SitePtr &site, const TrajPtr &traj1, const TrajPtr &traj2,
+               bool bPierces, const TimeIval &timeIval)
+: Ev{arcPnt, sqrdTime, site, timeIval}
 , m_traj1{traj1}
 , m_traj2{traj2}
 , m_bPierces{bPierces}
@@ -46,57 +74,498 @@ DomEv::DomEv(const Circular_arc_point_2 &arcPnt, const Root_of_2 &sqrdTime,
 {
 }
 
-VorDiag::VorDiag(const std::string &inFilePath, bool bUseOverlay,
-                 const std::string &ipeFilePath, const std::string &csvFilePath,
-                 bool bEnableView) {
-    const auto fr = FileReader{inFilePath};
+// The number of buckets of the bucket queue and the number of events per
+// bucket for which their width is chosen.
+const size_t N_BUCKETS = 4096;
+const size_t BUCKET_EVS = 4;
+
+EvQueue::EvQueue(QueueType type)
+: m_type{type}
+{
+}
+
+size_t EvQueue::VertKeyHash::operator()(const VertKey &key) const {
+    size_t hash = 0;
+    for (int id : key) {
+        hash = hash * 1000003 ^ std::hash<int>{}(id);
+    }
+
+    return hash;
+}
+
+const EvPtr & EvQueue::top() {
+    return m_twins.empty() ? heapTop() : m_twins.back();
+}
+
+void EvQueue::push(const EvPtr &ev) {
+    bool bIsDup = false;
+    if (!addToVert(ev, bIsDup)) {
+        heapPush(ev);
+    }
+
+    if (!bIsDup) {
+        m_size++;
+    }
+}
+
+void EvQueue::pop() {
+    CGAL_assertion(m_size > 0);
+    m_size--;
+    if (!m_twins.empty()) {
+        m_twins.pop_back();
+        return;
+    }
+
+    const auto ev = heapTop();
+    heapPop();
+    VertKey key;
+    if (!vertKey(ev, key)) {
+        return;
+    }
+
+    // Hands out the other edge events of the vertex next.
+    const auto it = m_verts.find(key);
+    CGAL_assertion(it != m_verts.end());
+    auto &verts = it->second;
+    const auto vert = std::find_if(verts.begin(), verts.end(),
+            [&ev](const std::vector<EvPtr> &evs) { return evs.front() == ev; });
+    CGAL_assertion(vert != verts.end());
+    m_twins.assign(vert->rbegin(), vert->rend() - 1);
+    verts.erase(vert);
+    if (verts.empty()) {
+        m_verts.erase(it);
+    }
+}
+
+void EvQueue::assign(std::vector<EvPtr> evs) {
+    m_verts.clear();
+    m_twins.clear();
+    m_size = evs.size();
+    m_heap.clear();
+    for (const auto &ev : evs) {
+        bool bIsDup = false;
+        if (!addToVert(ev, bIsDup)) {
+            m_heap.push_back(ev);
+        }
+
+        if (bIsDup) {
+            m_size--;
+        }
+    }
+
+    std::make_heap(m_heap.begin(), m_heap.end(), EvPtrComp{});
+    m_buckets.clear();
+    m_cur = 0;
+    m_bIsTopValid = false;
+}
+
+// Registers an edge event at its vertex. Returns true if the vertex already
+// has an event in the heap, i.e., if ev must not be pushed to the heap, and
+// sets bIsDup if ev duplicates an event of the vertex (and is dropped).
+bool EvQueue::addToVert(const EvPtr &ev, bool &bIsDup) {
+    bIsDup = false;
+    VertKey key;
+    if (!vertKey(ev, key)) {
+        return false;
+    }
+
+    const auto edgeEv = std::static_pointer_cast<EdgeEv>(ev);
+    auto &verts = m_verts[key];
+    for (auto &evs : verts) {
+        const auto &first = evs.front();
+        if (first->sqrdTime() != ev->sqrdTime() || first->arcPnt() != ev->arcPnt()) {
+            continue;
+        }
+
+        for (const auto &other : evs) {
+            const auto otherEdgeEv = std::static_pointer_cast<EdgeEv>(other);
+            if (other->site() == ev->site()
+                    && otherEdgeEv->isect1()->id() == edgeEv->isect1()->id()
+                    && otherEdgeEv->isect2()->id() == edgeEv->isect2()->id()) {
+                bIsDup = true;
+                return true;
+            }
+        }
+
+        evs.push_back(ev);
+        return true;
+    }
+
+    verts.push_back(std::vector<EvPtr>{ev});
+    return false;
+}
+
+// Returns false if ev is not an edge event of three distinct sites.
+bool EvQueue::vertKey(const EvPtr &ev, VertKey &key) {
+    if (ev->type() != EvType::Edge) {
+        return false;
+    }
+
+    const auto edgeEv = std::static_pointer_cast<EdgeEv>(ev);
+    std::vector<int> ids{ev->site()->id(),
+        edgeEv->isect1()->traj()->site1()->id(), edgeEv->isect1()->traj()->site2()->id(),
+        edgeEv->isect2()->traj()->site1()->id(), edgeEv->isect2()->traj()->site2()->id()};
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    if (ids.size() != 3) {
+        return false;
+    }
+
+    key = VertKey{{ids[0], ids[1], ids[2]}};
+    return true;
+}
+
+const EvPtr & EvQueue::heapTop() {
+    if (m_type == QueueType::Heap) {
+        return m_heap.front();
+    }
+
+    locateTop();
+    return m_top < m_buckets.size() ? m_buckets[m_top].front() : m_heap.front();
+}
+
+void EvQueue::heapPush(const EvPtr &ev) {
+    m_bIsTopValid = false;
+    if (m_cur < m_buckets.size()) {
+        double bucket = bucketOf(ev->timeIval().first);
+        if (bucket < m_buckets.size()) {
+            auto &heap = m_buckets[std::max(m_cur, static_cast<size_t>(std::max(bucket, 0.)))];
+            heap.push_back(ev);
+            std::push_heap(heap.begin(), heap.end(), EvPtrComp{});
+            return;
+        }
+    }
+
+    m_heap.push_back(ev);
+    std::push_heap(m_heap.begin(), m_heap.end(), EvPtrComp{});
+}
+
+void EvQueue::heapPop() {
+    if (m_type == QueueType::Buckets) {
+        locateTop();
+    }
+
+    auto &heap = m_type == QueueType::Buckets && m_top < m_buckets.size()
+            ? m_buckets[m_top] : m_heap;
+    std::pop_heap(heap.begin(), heap.end(), EvPtrComp{});
+    heap.pop_back();
+    m_bIsTopValid = false;
+}
+
+// Returns the (unbounded) index of the bucket of sqrdTime relative to the
+// first bucket. The index is monotone in sqrdTime.
+double EvQueue::bucketOf(double sqrdTime) const {
+    return std::floor(sqrdTime / m_width) - m_base;
+}
+
+void EvQueue::locateTop() {
+    if (m_bIsTopValid) {
+        return;
+    }
+
+    while (m_cur < m_buckets.size() && m_buckets[m_cur].empty()) {
+        m_cur++;
+    }
+
+    if (m_cur == m_buckets.size()) {
+        fillBuckets();
+    }
+
+    // The events of a later bucket precede the top of the current one only
+    // if its interval reaches that bucket.
+    const EvPtrComp comp;
+    m_top = m_cur;
+    for (size_t i = m_cur + 1; i < m_buckets.size()
+         && i <= bucketOf(m_buckets[m_top].front()->timeIval().second); i++) {
+        if (!m_buckets[i].empty() && comp(m_buckets[m_top].front(), m_buckets[i].front())) {
+            m_top = i;
+        }
+    }
+
+    if (!m_heap.empty() && bucketOf(m_buckets[m_top].front()->timeIval().second)
+            >= m_buckets.size() && comp(m_buckets[m_top].front(), m_heap.front())) {
+        m_top = m_buckets.size();
+    }
+
+    m_bIsTopValid = true;
+}
+
+// Moves the next events of the overflow heap into new buckets, whose width
+// is chosen such that the first N_BUCKETS * BUCKET_EVS of them are spread
+// over all buckets. Afterwards, all events in the overflow heap are later
+// than the first bucket that is beyond the last one.
+void EvQueue::fillBuckets() {
+    CGAL_assertion(!m_heap.empty());
+    std::vector<EvPtr> evs;
+    while (!m_heap.empty() && evs.size() < N_BUCKETS * BUCKET_EVS) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), EvPtrComp{});
+        evs.push_back(m_heap.back());
+        m_heap.pop_back();
+    }
+
+    double minTime = evs.front()->timeIval().first, maxTime = minTime;
+    for (const auto &ev : evs) {
+        minTime = std::min(minTime, ev->timeIval().first);
+        maxTime = std::max(maxTime, ev->timeIval().first);
+    }
+
+    m_width = (maxTime - minTime) / N_BUCKETS;
+    if (!(m_width > 0.)) {
+        m_width = std::max(std::abs(minTime) / N_BUCKETS, std::numeric_limits<double>::min());
+    }
+
+    m_base = std::floor(minTime / m_width);
+    m_buckets.assign(N_BUCKETS, std::vector<EvPtr>{});
+    m_cur = 0;
+    for (const auto &ev : evs) {
+        heapPush(ev);
+    }
+
+    while (!m_heap.empty() && bucketOf(m_heap.front()->timeIval().first) < N_BUCKETS) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), EvPtrComp{});
+        const auto ev = m_heap.back();
+        m_heap.pop_back();
+        heapPush(ev);
+    }
+}
+
+// The number of groups of events per thread in a window of the speculative
+// sweep and the vertex id from which the provisional ids count downwards.
+const size_t SWEEP_WINDOW = 8;
+const int PROVISIONAL_VERT = std::numeric_limits<int>::max();
+
+// The average number of sites per class of equal weight from which the
+// candidate sets are computed class by class (see CandMode::Auto).
+const size_t MIN_CLASS_SIZE = 4;
+
+thread_local VorDiag::EvLog *VorDiag::s_evLog = nullptr;
+
+// Returns the number of sites at the same point as a preceding site.
+static size_t countDupSites(const std::vector<SiteData> &siteData) {
+    std::vector<std::pair<int, int>> pnts;
+    pnts.reserve(siteData.size());
+    for (const auto &s : siteData) {
+        pnts.emplace_back(std::get<0>(s), std::get<1>(s));
+    }
+
+    std::sort(pnts.begin(), pnts.end());
+    return static_cast<size_t>(pnts.end() - std::unique(pnts.begin(), pnts.end()));
+}
+
+VorDiag::VorDiag(const std::string &inFilePath, const VorDiagOpts &opts)
+: VorDiag{FileReader{inFilePath}.sites(), opts}
+{
+}
+
+VorDiag::VorDiag(std::vector<SiteData> siteData, const VorDiagOpts &opts)
+: m_opts{opts}
+, m_queue{opts.queueType}
+{
+    const auto &ipeFilePath = opts.ipeFilePath, &csvFilePath = opts.csvFilePath;
+    bool bEnableView = opts.bEnableView;
+    size_t nThreads = opts.nThreads > 0 ? opts.nThreads
+            : std::max(1u, boost::thread::hardware_concurrency());
+
+    if (opts.maxTime >= 0.) {
+        const FT maxTime{opts.maxTime};
+        m_bIsBounded = true;
+        m_maxSqrdTime = maxTime * maxTime;
+    }
+
+    if (opts.bClip) {
+        std::cout << "Restricting to the sites that may reach the clip box ...\n";
+        size_t nSites = siteData.size();
+        siteData = clipSites(siteData, opts.clipBox);
+        std::cout << "Kept " << siteData.size() << " of " << nSites << " sites.\n";
+    }
+
+    sortSites(siteData);
+
+    auto candMode = opts.candMode;
+    if (candMode == CandMode::Auto) {
+        size_t nClasses = 0;
+        for (size_t i = 0; i < siteData.size(); i++) {
+            if (i == 0 || std::get<2>(siteData[i]) != std::get<2>(siteData[i - 1])) {
+                nClasses++;
+            }
+        }
+
+        candMode = nClasses * MIN_CLASS_SIZE <= siteData.size() ? CandMode::Classes
+                : CandMode::Overlay;
+        std::cout << "Taking the candidates "
+                << (candMode == CandMode::Classes ? "class by class" : "from the overlay")
+                << " (" << nClasses << " classes of equal weight).\n";
+    }
     
-    for (const auto &s : fr.sites()) {
+    for (const auto &s : siteData) {
         int x = std::get<0>(s), y = std::get<1>(s), w = std::get<2>(s),
                 siteIndex = std::get<3>(s);
         m_sites.push_back(std::make_shared<PntSite>(Point_2{x, y}, w, siteIndex));
     }
-
-    std::sort(m_sites.begin(), m_sites.end(),
-              [](const SitePtr &lhs, const SitePtr & rhs) {
-                  return lhs->weight() > rhs->weight();
-              });
     
     size_t n = m_sites.size(), maxCandSetSize = 0, nCandSets = 0, avgSize = 0;
 
+    // The viewer replays the sweep, hence it is always recorded.
+#ifdef ENABLE_VIEW
+    bool bRecord = true;
+#else
+    bool bRecord = !opts.snapshotTimes.empty();
+#endif
+
     for (const auto &site : m_sites) {
-        m_offCircs[site->id()] = std::make_shared<OffCirc>(site);
+        m_offCircs[site->id()] = std::make_shared<OffCirc>(site, bRecord);
+    }
+
+    m_bIsLinear = opts.bUseDelaunay && !bRecord && opts.maxTime < 0. && !opts.bCompDcel
+            && opts.dcelFilePath.empty() && hasEqualWeights();
+
+    // The triangulation would merge the sites at the same point silently,
+    // hence they are left to the sweep.
+    if (m_bIsLinear) {
+        size_t nDups = countDupSites(siteData);
+        if (nDups > 0) {
+            std::cout << "Found " << nDups << " duplicate sites, "
+                    "not using the Delaunay triangulation.\n";
+            m_bIsLinear = false;
+        }
+    }
+
+    // The recorded history of the offset circles is not checkpointed, and
+    // the linear diagram is computed without a sweep.
+    if (bRecord || m_bIsLinear) {
+        m_opts.ckptFilePath.clear();
     }
 
-    std::cout << "Computing collisions ...\n";
     std::chrono::high_resolution_clock::time_point t0;
     long long overlayDuration = 0;
+    bool bResumed = false;
 
-    std::cout << "Inserting initial collision events into event queue ...\n";
-    if (!bUseOverlay) {
+    if (opts.bResume && !m_opts.ckptFilePath.empty()) {
+        std::cout << "Resuming from checkpoint " << m_opts.ckptFilePath << " ...\n";
         t0 = std::chrono::high_resolution_clock::now();
-        compColls();
-    } else {
-        const auto overlay = Overlay(inFilePath);
-        overlayDuration = overlay.duration();
-        nCandSets = overlay.candSets().size();
-        maxCandSetSize = overlay.maxSize();
-        avgSize = overlay.avgSize();
+        bResumed = readCkpt(m_opts.ckptFilePath, siteData);
+        if (!bResumed) {
+            std::cout << "No valid checkpoint found, starting from scratch.\n";
+        }
+    }
 
+    if (m_bIsLinear) {
+        std::cout << "All sites have the same weight, skipping the collisions ...\n";
         t0 = std::chrono::high_resolution_clock::now();
-        compColls(overlay.candSets());
+    } else if (bResumed) {
+        std::cout << "Resumed after " << m_collEvCnt + m_invalidCollEvCnt + m_domEvCnt
+                + m_invalidDomEvCnt + m_edgeEvCnt + m_invalidEdgeEvCnt << " events.\n";
+    } else {
+        std::cout << "Computing collisions ...\n";
+        std::cout << "Inserting initial collision events into event queue ...\n";
+        if (candMode == CandMode::All) {
+            t0 = std::chrono::high_resolution_clock::now();
+            compColls();
+        } else if (candMode == CandMode::Grid) {
+            t0 = std::chrono::high_resolution_clock::now();
+            compColls(CandGrid{siteData}.candPairs());
+        } else if (candMode == CandMode::Classes) {
+            // The pairs within a class are its neighbors among the sites of
+            // at least its weight (see Overlay), and the pairs of different
+            // classes are those of CandGrid.
+            const auto overlay = Overlay(siteData, opts.overlayCacheDir, true);
+            overlayDuration = overlay.duration();
+            nCandSets = overlay.candSets().size();
+            maxCandSetSize = overlay.maxSize();
+            avgSize = overlay.avgSize();
+
+            t0 = std::chrono::high_resolution_clock::now();
+            std::vector<std::pair<int, int>> candPairs;
+            for (const auto &candSet : overlay.candSets()) {
+                candPairs.emplace_back(*candSet.begin(), *candSet.rbegin());
+            }
+
+            for (const auto &candPair : CandGrid{siteData}.candPairs()) {
+                if (std::get<2>(siteData[candPair.first])
+                        != std::get<2>(siteData[candPair.second])) {
+                    candPairs.push_back(candPair);
+                }
+            }
+
+            compColls(candPairs);
+        } else {
+            const auto overlay = Overlay(siteData, opts.overlayCacheDir);
+            overlayDuration = overlay.duration();
+            nCandSets = overlay.candSets().size();
+            maxCandSetSize = overlay.maxSize();
+            avgSize = overlay.avgSize();
+
+            t0 = std::chrono::high_resolution_clock::now();
+            compColls(overlay.candSets());
+        }
     }
 
-    std::cout << "Processing events ...\n";
+    std::cout << (m_bIsLinear ? "Computing Delaunay triangulation ...\n"
+                                : "Processing events ...\n");
     std::chrono::high_resolution_clock::time_point t1 =
             std::chrono::high_resolution_clock::now();
-    run();
+    m_ckptTime = std::chrono::steady_clock::now();
+    if (m_bIsLinear) {
+        compLinear();
+#ifdef CGAL_HAS_THREADS
+    } else if (opts.bParallelSweep && !bRecord && nThreads > 1) {
+        // Shared handles require thread-safe reference counts (see
+        // runSpeculative()).
+        runSpeculative(nThreads);
+#endif
+    } else {
+#ifndef CGAL_HAS_THREADS
+        if (opts.bParallelSweep && !bRecord && nThreads > 1) {
+            std::cout << "CGAL has no thread support, running the sweep serially ...\n";
+        }
+#endif
+        run();
+    }
     std::chrono::high_resolution_clock::time_point t2 =
             std::chrono::high_resolution_clock::now();
 
-    if (bEnableView || !ipeFilePath.empty()) {
+    if (bRecord) {
+        for (const auto &val : m_offCircs) {
+            val.second->buildKeyframes();
+        }
+    }
+
+    if (opts.maxTime >= 0.) {
+        std::cout << "Computing wavefront at maximum time ...\n";
+        for (const auto &val : m_offCircs) {
+            const auto arcs = val.second->wfArcsAt(m_maxSqrdTime);
+            m_wavefront.insert(m_wavefront.end(), arcs.begin(), arcs.end());
+        }
+    }
+
+    bool bStoreEdges = bEnableView || !ipeFilePath.empty() || opts.bCompEdges;
+    if (bStoreEdges || !opts.binFilePath.empty()) {
         std::cout << "Computing Voronoi edges ...\n";
-        compVorEdges();
+        if (!opts.binFilePath.empty()) {
+            std::cout << "Writing output to " << opts.binFilePath << " ...\n";
+            BinWriter bw{opts.binFilePath};
+            for (const auto &site : m_sites) {
+                if (typeid(*site) == typeid(PntSite)) {
+                    const auto &pnt = std::static_pointer_cast<PntSite>(site)->pnt();
+                    bw.addSite(site->id(), CGAL::to_double(pnt.x()),
+                               CGAL::to_double(pnt.y()), CGAL::to_double(site->weight()));
+                }
+            }
+
+            compVorEdges(&bw, bStoreEdges, nThreads);
+        } else {
+            compVorEdges(nullptr, true, nThreads);
+        }
+    }
+
+    if (opts.bCompDcel || !opts.dcelFilePath.empty()) {
+        std::cout << "Computing DCEL ...\n";
+        compVorDcel();
+
+        if (!opts.dcelFilePath.empty()) {
+            std::cout << "Writing output to " << opts.dcelFilePath << " ...\n";
+            m_dcel.write(opts.dcelFilePath);
+        }
     }
 
     if (!ipeFilePath.empty()) {
@@ -104,16 +573,19 @@ VorDiag::VorDiag(const std::string &inFilePath, bool bUseOverlay,
         writeToIpe(ipeFilePath);
     }
 
+    if (!opts.snapshotFilePath.empty() && !opts.snapshotTimes.empty()) {
+        std::cout << "Writing snapshots to " << opts.snapshotFilePath << " ...\n";
+        writeSnapshotsToIpe(opts.snapshotFilePath, opts.snapshotTimes);
+    }
+
     long long duration1 =
             std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
     long long duration2 =
             std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
     long long runtime = duration1 + duration2;
 
-    if (bUseOverlay) {
-        duration1 += overlayDuration;
-        runtime += overlayDuration;
-    }
+    duration1 += overlayDuration;
+    runtime += overlayDuration;
 
     if (!csvFilePath.empty()) {
         std::cout << "Writing output to" << csvFilePath << " ...\n";
@@ -137,737 +609,3346 @@ VorDiag::VorDiag(const std::string &inFilePath, bool bUseOverlay,
             << "\t" << m_nVorVerts << " Voronoi nodes have been found.\n";
 }
 
-void VorDiag::compColls(const std::vector<std::set<int>> &candSets) {
-    std::set<std::pair<int, int>> candColls;
-    for (const auto &candSet : candSets) {
-        for (int cand1 : candSet) {
-            for (int cand2 : candSet) {
-                if (cand1 != cand2 && cand1 != -1 && cand2 != -1) {
-                    const auto site1 = m_sites.at(cand1), site2 = m_sites.at(cand2);
-                    const auto candPair = std::minmax({cand1, cand2});
-                    
-                    if (candColls.find(candPair) == candColls.end()) {
-                        candColls.insert(candPair);
-
-                        const auto id = std::minmax({site1->id(), site2->id()});
-
-                        if (m_bisecs.find(id) == m_bisecs.end()) {
-                            const auto bisec
-                                    = BisecFactory{site1, site2}.makeBisec();
-                            m_bisecs[id] = bisec;
-                        }
-
-                        if (m_bisecs.at(id)->trajs().size() == 2) {
-                            const auto traj1 = m_bisecs.at(id)->trajs().at(0),
-                                    traj2 = m_bisecs.at(id)->trajs().at(1);
-
-                            m_queue.push(std::make_shared<CollEv>(traj1->start()->arcPnt(),
-                                                                  traj1->start()->sqrdTime(),
-                                                                  site1, traj1,
-                                                                  traj2, false));
-                            m_queue.push(std::make_shared<CollEv>(traj1->start()->arcPnt(),
-                                                                  traj1->start()->sqrdTime(),
-                                                                  site2, traj1,
-                                                                  traj2, false));
-                        } else if (m_bisecs.at(id)->trajs().size() == 4) {
-                            CGAL_assertion(false);
-                        }
-                    }
-                }
-            }
-        }
-    }
+// Returns the lines through the sides of box.
+static std::vector<Line_2> boxLines(const CGAL::Bbox_2 &box) {
+    const FT xMin{box.xmin()}, yMin{box.ymin()}, xMax{box.xmax()}, yMax{box.ymax()};
+    return {Line_2{Point_2{xMin, yMin}, Point_2{xMax, yMin}},
+            Line_2{Point_2{xMax, yMin}, Point_2{xMax, yMax}},
+            Line_2{Point_2{xMax, yMax}, Point_2{xMin, yMax}},
+            Line_2{Point_2{xMin, yMax}, Point_2{xMin, yMin}}};
 }
 
-void VorDiag::compColls() {
-    for (const auto &val1 : m_offCircs) {
-        for (const auto &val2 : m_offCircs) {
-            const auto site1 = val1.second->site(), site2 = val2.second->site();
-            compColl(site1, site2);
-        }
-    }
-}
+// Keeps only the sites whose cells may intersect the clip box. Every point p
+// of the box is at (weighted) distance at most U = min_t maxDist(B, t) / w(t)
+// from its nearest site, hence a site s can own points of the box only if
+// minDist(B, s) / w(s) <= U. Moreover, the wavefront has swept over the box at
+// time U, such that the sweep can stop there (or earlier, if a smaller
+// maximum time is given). The distances are compared
+// exactly by their squares.
+std::vector<SiteData> VorDiag::clipSites(const std::vector<SiteData> &sites,
+                                         const CGAL::Bbox_2 &clipBox) {
+    m_bClip = true;
+    m_clipBox = clipBox;
+    m_clipLines = boxLines(clipBox);
 
-void VorDiag::compColl(const SitePtr &site1, const SitePtr &site2) {
-    if (site1->id() != site2->id()) {
-        const auto id = std::minmax({site1->id(), site2->id()});
+    const FT xMin{clipBox.xmin()}, yMin{clipBox.ymin()},
+            xMax{clipBox.xmax()}, yMax{clipBox.ymax()};
 
-        if (m_bisecs.find(id) == m_bisecs.end()) {
-            m_bisecs[id] = BisecFactory(site1, site2).makeBisec();
-        }
+    const auto fMinSqrdDist = [&](const FT &x, const FT &y) {
+        return boxMinSqrdDist(xMin, yMin, xMax, yMax, x, y);
+    };
 
-        CGAL_assertion(m_bisecs.at(id)->trajs().size() == 2
-               || m_bisecs.at(id)->trajs().size() == 4);
+    const auto fMaxSqrdDist = [&](const FT &x, const FT &y) {
+        return boxMaxSqrdDist(xMin, yMin, xMax, yMax, x, y);
+    };
 
-        if (m_bisecs.at(id)->trajs().size() == 2) {
-            const auto traj1 = m_bisecs[id]->trajs().at(0),
-                    traj2 = m_bisecs[id]->trajs().at(1);
+    bool bIsFirst = true;
+    FT clipSqrdTime{0};
+    for (const auto &s : sites) {
+        const FT x{std::get<0>(s)}, y{std::get<1>(s)}, w{std::get<2>(s)};
+        const FT sqrdTime = fMaxSqrdDist(x, y) / (w * w);
+        if (bIsFirst || sqrdTime < clipSqrdTime) {
+            clipSqrdTime = sqrdTime;
+            bIsFirst = false;
+        }
+    }
 
-            m_queue.push(std::make_shared<CollEv>(traj1->start()->arcPnt(),
-                                                  traj1->start()->sqrdTime(),
-                                                  site1, traj1, traj2, false));
+    if (!m_bIsBounded || clipSqrdTime < m_maxSqrdTime) {
+        m_bIsBounded = true;
+        m_maxSqrdTime = clipSqrdTime;
+    }
 
-            const auto isect1 = makeMovIsect(traj1), isect2 = makeMovIsect(traj2);
-            m_queue.push(std::make_shared<DomEv>(isect1->traj()->end()->arcPnt(),
-                                                 isect1->traj()->end()->sqrdTime(),
-                                                 site1, isect1, isect2));
+    std::vector<SiteData> res;
+    for (const auto &s : sites) {
+        const FT x{std::get<0>(s)}, y{std::get<1>(s)}, w{std::get<2>(s)};
+        if (fMinSqrdDist(x, y) <= m_maxSqrdTime * w * w) {
+            res.push_back(s);
         }
     }
+
+    return res;
 }
 
-void VorDiag::run() {
-    while (!m_queue.empty()) {
-        const auto ev = m_queue.top();
-        m_queue.pop();
+static SiteData toSiteData(const SitePtr &site) {
+    const auto &center = site->center();
+    return SiteData{static_cast<int>(CGAL::to_double(center.x())),
+                    static_cast<int>(CGAL::to_double(center.y())),
+                    static_cast<int>(CGAL::to_double(site->weight())), site->id()};
+}
 
-        switch (ev->type()) {
-            case EvType::Coll:
-            {
-                const auto collEv = std::static_pointer_cast<CollEv>(ev);
-                handleEv(collEv);
-                break;
-            }
-            case EvType::Edge:
-            {
-                const auto edgeEv = std::static_pointer_cast<EdgeEv>(ev);
-                handleEv(edgeEv);
-                break;
-            }
-            case EvType::Dom:
-            {
-                const auto domEv = std::static_pointer_cast<DomEv>(ev);
-                handleEv(domEv);
-                break;
+// Returns the cell of the grid with cells of the given size that contains
+// the coordinate, and the key of the cell (x, y).
+static long long gridCell(double coord, double size) {
+    return static_cast<long long>(std::floor(coord / size));
+}
+
+static long long gridKey(long long x, long long y) {
+    return static_cast<long long>((static_cast<unsigned long long>(x) << 32)
+                                  ^ (static_cast<unsigned long long>(y) & 0xffffffffULL));
+}
+
+// Calls f for every cell of the grid at (Chebyshev) distance ring from the
+// cells [x1, x2] x [y1, y2], i.e., for these cells themselves if ring is 0.
+template<class F>
+static void forRing(long long x1, long long y1, long long x2, long long y2,
+                    long long ring, F f) {
+    if (ring == 0) {
+        for (long long x = x1; x <= x2; x++) {
+            for (long long y = y1; y <= y2; y++) {
+                f(x, y);
             }
-            case EvType::None:
-            default:
-                break;
         }
+
+        return;
     }
-}
 
-void VorDiag::handleEv(const std::shared_ptr<CollEv> &collEv1) {
-    const auto ev = m_queue.top();
+    x1 -= ring;
+    y1 -= ring;
+    x2 += ring;
+    y2 += ring;
+    for (long long x = x1; x <= x2; x++) {
+        f(x, y1);
+        f(x, y2);
+    }
 
-    CGAL_assertion(ev->type() == EvType::Coll);
-    if (ev->type() == EvType::Coll) {
-        m_queue.pop();
-        const auto collEv2 = std::static_pointer_cast<CollEv>(ev);
-        bool bDom = (*collEv1->site() > *collEv2->site()),
-                bIsValid = isValidCollEv(collEv1, collEv2);
-        
-        CGAL_assertion(collEv1->sqrdTime() == collEv2->sqrdTime());
-        CGAL_assertion(collEv1->pierces() == collEv2->pierces());
-        processEv(collEv1, bDom, bIsValid, collEv1->pierces());
-        processEv(collEv2, !bDom, bIsValid, collEv1->pierces());
+    for (long long y = y1 + 1; y < y2; y++) {
+        f(x1, y);
+        f(x2, y);
     }
 }
 
-bool VorDiag::isValidCollEv(const std::shared_ptr<CollEv> &collEv1,
-                            const std::shared_ptr<CollEv> &collEv2) const {
-    const auto offCirc1 = m_offCircs.at(collEv1->site()->id()),
-            offCirc2 = m_offCircs.at(collEv2->site()->id());
-    const auto arcPnt = collEv1->arcPnt();
-    const auto sqrdTime = collEv1->sqrdTime();
-
-    return offCirc1->isInActiveArc(sqrdTime, arcPnt) && offCirc2->isInActiveArc(sqrdTime, arcPnt);
+// Appends an edge to the stored edges and to the edges of its sites.
+template<class Edge, class Info>
+static void appendEdge(std::vector<Edge> &edges, std::vector<Info> &infos,
+                       std::unordered_map<int, std::vector<size_t>> &siteEdges,
+                       const Edge &edge, const Info &info) {
+    siteEdges[info.site1].push_back(edges.size());
+    siteEdges[info.site2].push_back(edges.size());
+    edges.push_back(edge);
+    infos.push_back(info);
 }
 
-bool VorDiag::isValidDomEv(const std::shared_ptr<DomEv> &domEv1,
-                           const std::shared_ptr<DomEv> &domEv2) const {
-    const auto offCirc1 = m_offCircs.at(domEv1->site()->id()),
-            offCirc2 = m_offCircs.at(domEv2->site()->id());
-    const auto arcPnt = domEv1->arcPnt();
-    const auto sqrdTime = domEv1->sqrdTime();
+// Removes the stored edge i by moving the last edge into its place.
+template<class Edge, class Info>
+static void removeEdge(std::vector<Edge> &edges, std::vector<Info> &infos,
+                       std::unordered_map<int, std::vector<size_t>> &siteEdges, size_t i) {
+    const auto fUnlink = [&siteEdges](int site, size_t edge) {
+        auto &ids = siteEdges.at(site);
+        ids.erase(std::find(ids.begin(), ids.end(), edge));
+    };
+
+    const auto fRelink = [&siteEdges](int site, size_t edge, size_t newEdge) {
+        auto &ids = siteEdges.at(site);
+        *std::find(ids.begin(), ids.end(), edge) = newEdge;
+    };
+
+    fUnlink(infos.at(i).site1, i);
+    fUnlink(infos.at(i).site2, i);
+
+    size_t last = edges.size() - 1;
+    if (i != last) {
+        fRelink(infos.at(last).site1, last, i);
+        fRelink(infos.at(last).site2, last, i);
+        edges.at(i) = edges.at(last);
+        infos.at(i) = infos.at(last);
+    }
+
+    edges.pop_back();
+    infos.pop_back();
+}
+
+// Tells whether two edges lie on the same circle (or line), and returns the
+// edge on the circle (or line) of an edge between two of its points.
+static bool isOnSameCurve(const Circular_arc_2 &arc1, const Circular_arc_2 &arc2) {
+    return arc1.supporting_circle() == arc2.supporting_circle();
+}
+
+static bool isOnSameCurve(const Line_arc_2 &seg1, const Line_arc_2 &seg2) {
+    const auto &line1 = seg1.supporting_line(), &line2 = seg2.supporting_line();
+    return line1 == line2 || line1 == line2.opposite();
+}
+
+static Circular_arc_2 edgeOn(const Circular_arc_2 &arc, const Circular_arc_point_2 &source,
+                             const Circular_arc_point_2 &target) {
+    return Circular_arc_2{arc.supporting_circle(), source, target};
+}
+
+static Line_arc_2 edgeOn(const Line_arc_2 &seg, const Circular_arc_point_2 &source,
+                         const Circular_arc_point_2 &target) {
+    return Line_arc_2{seg.supporting_line(), source, target};
+}
+
+// Joins the pieces of an edge that have been split at the sides of a box,
+// i.e., a piece outside of the box (one of the first nOld pieces) and a piece
+// inside of the box that end at the same point, which is not a vertex, and
+// have the same sites and the same curve. The pieces inside of the box
+// whose joined edge still ends on a side of the box belong to an unbounded
+// edge, which the sweep does not extract (see extractEdges()), hence they
+// are dropped.
+template<class Edge, class Info>
+static std::vector<std::pair<Edge, Info>> joinPieces(
+        const std::vector<std::pair<Edge, Info>> &pieces, size_t nOld) {
+    // The end 2 i is the source of piece i and the end 2 i + 1 its target.
+    const auto fPnt = [&pieces](size_t end) -> const Circular_arc_point_2 & {
+        const auto &edge = pieces.at(end / 2).first;
+        return end % 2 == 0 ? edge.source() : edge.target();
+    };
+
+    const auto fVert = [&pieces](size_t end) {
+        const auto &info = pieces.at(end / 2).second;
+        return end % 2 == 0 ? info.vert1 : info.vert2;
+    };
+
+    const auto fIsSameEdge = [&pieces](size_t i, size_t j) {
+        const auto &info1 = pieces.at(i).second, &info2 = pieces.at(j).second;
+        return std::minmax(info1.site1, info1.site2) == std::minmax(info2.site1, info2.site2)
+                && isOnSameCurve(pieces.at(i).first, pieces.at(j).first);
+    };
+
+    std::map<Circular_arc_point_2, std::vector<size_t>> sideEnds;
+    for (size_t end = 0; end < 2 * pieces.size(); end++) {
+        if (fVert(end) < 0) {
+            sideEnds[fPnt(end)].push_back(end);
+        }
+    }
+
+    const size_t NONE = std::numeric_limits<size_t>::max();
+    std::vector<size_t> joined(2 * pieces.size(), NONE);
+    for (const auto &val : sideEnds) {
+        const auto &ends = val.second;
+        for (size_t k = 0; k < ends.size(); k++) {
+            for (size_t l = k + 1; l < ends.size() && joined.at(ends[k]) == NONE; l++) {
+                size_t i = ends[k] / 2, j = ends[l] / 2;
+                if (joined.at(ends[l]) == NONE && (i < nOld) != (j < nOld)
+                        && fIsSameEdge(i, j)) {
+                    joined.at(ends[k]) = ends[l];
+                    joined.at(ends[l]) = ends[k];
+                }
+            }
+        }
+    }
+
+    std::vector<std::pair<Edge, Info>> res;
+    std::vector<char> bIsDone(pieces.size(), 0);
+    for (size_t i = 0; i < pieces.size(); i++) {
+        if (bIsDone.at(i)) {
+            continue;
+        }
+
+        // Walks to the first end of the chain of joined pieces and from there
+        // to its last end.
+        size_t first = 2 * i;
+        for (size_t n = 0; joined.at(first) != NONE && n < pieces.size(); n++) {
+            first = joined.at(first) ^ 1;
+        }
+
+        std::vector<size_t> chain{first / 2};
+        bIsDone.at(first / 2) = 1;
+        size_t last = first ^ 1;
+        while (joined.at(last) != NONE && !bIsDone.at(joined.at(last) / 2)) {
+            chain.push_back(joined.at(last) / 2);
+            bIsDone.at(chain.back()) = 1;
+            last = joined.at(last) ^ 1;
+        }
+
+        bool bHasOld = false;
+        for (size_t j : chain) {
+            bHasOld = bHasOld || j < nOld;
+        }
+
+        if (fVert(first) < 0 || fVert(last) < 0) {
+            if (bHasOld) {
+                for (size_t j : chain) {
+                    res.push_back(pieces.at(j));
+                }
+            }
+
+            continue;
+        }
+
+        if (chain.size() == 1) {
+            res.push_back(pieces.at(chain.front()));
+            continue;
+        }
+
+        // The arcs run counterclockwise from their sources to their targets.
+        size_t source = first % 2 == 0 ? first : last, target = source == first ? last : first;
+        auto info = pieces.at(chain.front()).second;
+        info.vert1 = fVert(source);
+        info.vert2 = fVert(target);
+        res.emplace_back(edgeOn(pieces.at(chain.front()).first, fPnt(source), fPnt(target)),
+                         info);
+    }
+
+    return res;
+}
+
+bool VorDiag::insertSite(const SiteData &site) {
+    prepareUpdates();
+    if (m_sitePos.count(std::get<3>(site))) {
+        return false;
+    }
+
+    CGAL::Bbox_2 box;
+    if (isRepairable() && cellBox(site, box)) {
+        repair(box, &site, -1);
+    } else {
+        auto siteData = sitesAsData();
+        siteData.push_back(site);
+        recompute(siteData);
+    }
+
+    return true;
+}
+
+bool VorDiag::deleteSite(int id) {
+    prepareUpdates();
+    const auto it = m_sitePos.find(id);
+    if (it == m_sitePos.end()) {
+        return false;
+    }
+
+    CGAL::Bbox_2 box;
+    if (isRepairable() && cellBox(toSiteData(m_sites.at(it->second)), box)) {
+        repair(box, nullptr, id);
+    } else {
+        auto siteData = sitesAsData();
+        siteData.erase(siteData.begin() + it->second);
+        recompute(siteData);
+    }
+
+    return true;
+}
+
+// The diagram changes within the old and the new cell of the site only.
+bool VorDiag::reweightSite(int id, int weight) {
+    prepareUpdates();
+    const auto it = m_sitePos.find(id);
+    if (it == m_sitePos.end() || weight <= 0) {
+        return false;
+    }
+
+    const auto oldSite = toSiteData(m_sites.at(it->second));
+    auto newSite = oldSite;
+    std::get<2>(newSite) = weight;
+
+    CGAL::Bbox_2 oldBox, newBox;
+    if (isRepairable() && cellBox(oldSite, oldBox) && cellBox(newSite, newBox)) {
+        repair(oldBox + newBox, &newSite, id);
+    } else {
+        auto siteData = sitesAsData();
+        siteData.at(it->second) = newSite;
+        recompute(siteData);
+    }
+
+    return true;
+}
+
+// Builds the indices of the updates, where the cells of the grid hold about
+// two sites on average.
+void VorDiag::prepareUpdates() {
+    if (m_bIsPrepared) {
+        return;
+    }
+
+    m_bIsPrepared = true;
+    double xMin = 0., yMin = 0., xMax = 0., yMax = 0.;
+    for (size_t i = 0; i < m_sites.size(); i++) {
+        double x = CGAL::to_double(m_sites[i]->center().x()),
+                y = CGAL::to_double(m_sites[i]->center().y());
+        xMin = i == 0 ? x : std::min(xMin, x);
+        yMin = i == 0 ? y : std::min(yMin, y);
+        xMax = i == 0 ? x : std::max(xMax, x);
+        yMax = i == 0 ? y : std::max(yMax, y);
+    }
+
+    m_gridSize = std::max(1., std::sqrt(2. * (xMax - xMin) * (yMax - yMin)
+                                        / std::max<size_t>(1, m_sites.size())));
+
+    std::vector<SitePtr> sites;
+    sites.swap(m_sites);
+    for (const auto &site : sites) {
+        addSite(site);
+    }
+
+    for (size_t i = 0; i < m_vorEdgeInfos.size(); i++) {
+        m_siteArcs[m_vorEdgeInfos[i].site1].push_back(i);
+        m_siteArcs[m_vorEdgeInfos[i].site2].push_back(i);
+    }
+
+    for (size_t i = 0; i < m_vorSegInfos.size(); i++) {
+        m_siteSegs[m_vorSegInfos[i].site1].push_back(i);
+        m_siteSegs[m_vorSegInfos[i].site2].push_back(i);
+    }
+}
+
+// The local repair requires the final state of a complete sweep, i.e.,
+// neither a maximum time nor a clip box and no recorded history, and the
+// edges in memory. The linear diagram has no wavefront to repair, hence it
+// is recomputed as well.
+bool VorDiag::isRepairable() const {
+#ifdef ENABLE_VIEW
+    bool bRecord = true;
+#else
+    bool bRecord = !m_opts.snapshotTimes.empty();
+#endif
+
+    return !m_bIsBounded && !m_bIsLinear && !bRecord
+            && (m_opts.bEnableView || !m_opts.ipeFilePath.empty() || m_opts.bCompEdges);
+}
+
+// Returns the options of a full recomputation, i.e., the options of the
+// diagram without the output files and the checkpoints.
+VorDiagOpts VorDiag::recomputeOpts() const {
+    auto opts = m_opts;
+    opts.bCompEdges = true;
+    opts.bCompDcel = m_opts.bCompDcel || !m_opts.dcelFilePath.empty();
+    opts.ipeFilePath.clear();
+    opts.csvFilePath.clear();
+    opts.binFilePath.clear();
+    opts.dcelFilePath.clear();
+    opts.snapshotFilePath.clear();
+    opts.ckptFilePath.clear();
+    opts.bResume = false;
+    return opts;
+}
+
+void VorDiag::recompute(const std::vector<SiteData> &siteData) {
+    const auto opts = m_opts;
+    *this = VorDiag{siteData, recomputeOpts()};
+    m_opts = opts;
+    m_opts.bCompEdges = true;
+}
+
+// The diagrams are compared exactly: the edges as sorted lists of their
+// sites, their end points (in lexicographic order for segments) and their
+// circles, the distinct vertices by their points and times, the half-edges
+// of the DCELs by their end points (converted from the exact points) and
+// sites, and the offset circles by their states and their rings of arcs.
+// The diagram is always recomputed by the sweep, hence a linear diagram is
+// compared against the sweep, too, but without its offset circles, which it
+// does not move.
+bool VorDiag::checkUpdates() const {
+    auto opts = recomputeOpts();
+    opts.bUseDelaunay = false;
+    std::cout << "Recomputing the diagram from scratch ...\n";
+    const auto other = VorDiag{sitesAsData(), opts};
+
+    size_t nDiffs = 0;
+    const auto fReport = [&nDiffs](const std::string &msg) {
+        if (nDiffs++ < 10) {
+            std::cout << msg << "\n";
+        }
+    };
+
+    const auto fSites = [](const VorDiag &diag) {
+        std::map<int, SiteData> res;
+        for (const auto &site : diag.sitesAsData()) {
+            res[std::get<3>(site)] = site;
+        }
+
+        return res;
+    };
+
+    if (fSites(*this) != fSites(other)) {
+        fReport("The sites differ.");
+    }
+
+    const auto fLess = [](const Circular_arc_point_2 &p, const Circular_arc_point_2 &q) {
+        return p.x() != q.x() ? p.x() < q.x() : p.y() < q.y();
+    };
+
+    struct ExactEdge {
+        bool bIsArc;
+        int site1;
+        int site2;
+        Circular_arc_point_2 src;
+        Circular_arc_point_2 tgt;
+        Point_2 center;
+        FT sqrdRadius;
+    };
+
+    const auto fEdgeLess = [&fLess](const ExactEdge &lhs, const ExactEdge &rhs) {
+        const auto key1 = std::make_tuple(lhs.bIsArc, lhs.site1, lhs.site2),
+                key2 = std::make_tuple(rhs.bIsArc, rhs.site1, rhs.site2);
+        if (key1 != key2) {
+            return key1 < key2;
+        }
+
+        if (lhs.src != rhs.src) {
+            return fLess(lhs.src, rhs.src);
+        }
+
+        if (lhs.tgt != rhs.tgt) {
+            return fLess(lhs.tgt, rhs.tgt);
+        }
+
+        if (lhs.center != rhs.center) {
+            return lhs.center < rhs.center;
+        }
+
+        return lhs.sqrdRadius < rhs.sqrdRadius;
+    };
+
+    const auto fEdges = [&fLess, &fEdgeLess](const VorDiag &diag) {
+        std::vector<ExactEdge> res;
+        for (size_t i = 0; i < diag.m_vorEdges.size(); i++) {
+            const auto &arc = diag.m_vorEdges[i];
+            const auto &info = diag.m_vorEdgeInfos.at(i);
+            const auto &circ = arc.supporting_circle();
+            res.push_back(ExactEdge{true, std::min(info.site1, info.site2),
+                                    std::max(info.site1, info.site2), arc.source(),
+                                    arc.target(), circ.center(), circ.squared_radius()});
+        }
+
+        for (size_t i = 0; i < diag.m_vorSegs.size(); i++) {
+            const auto &seg = diag.m_vorSegs[i];
+            const auto &info = diag.m_vorSegInfos.at(i);
+            bool bIsLess = fLess(seg.source(), seg.target());
+            res.push_back(ExactEdge{false, std::min(info.site1, info.site2),
+                                    std::max(info.site1, info.site2),
+                                    bIsLess ? seg.source() : seg.target(),
+                                    bIsLess ? seg.target() : seg.source(),
+                                    Point_2{0, 0}, FT{0}});
+        }
+
+        std::sort(res.begin(), res.end(), fEdgeLess);
+        return res;
+    };
+
+    const auto edges = fEdges(*this), otherEdges = fEdges(other);
+    if (edges.size() != otherEdges.size()) {
+        fReport("There are " + std::to_string(edges.size()) + " instead of "
+                + std::to_string(otherEdges.size()) + " edges.");
+    } else {
+        for (size_t i = 0; i < edges.size(); i++) {
+            if (fEdgeLess(edges[i], otherEdges[i]) || fEdgeLess(otherEdges[i], edges[i])) {
+                fReport("The edge " + std::to_string(i) + " of the sites "
+                        + std::to_string(edges[i].site1) + " and "
+                        + std::to_string(edges[i].site2) + " differs.");
+            }
+        }
+    }
+
+    const auto fVerts = [&fLess](const VorDiag &diag) {
+        std::vector<VorVert> res = diag.verts();
+        std::sort(res.begin(), res.end(), [&fLess](const VorVert &lhs, const VorVert &rhs) {
+            return lhs.pnt != rhs.pnt ? fLess(lhs.pnt, rhs.pnt) : lhs.sqrdTime < rhs.sqrdTime;
+        });
+
+        res.erase(std::unique(res.begin(), res.end(), [](const VorVert &lhs, const VorVert &rhs) {
+            return lhs.pnt == rhs.pnt && lhs.sqrdTime == rhs.sqrdTime;
+        }), res.end());
+        return res;
+    };
+
+    const auto verts = fVerts(*this), otherVerts = fVerts(other);
+    bool bIsEqual = verts.size() == otherVerts.size();
+    for (size_t i = 0; bIsEqual && i < verts.size(); i++) {
+        bIsEqual = verts[i].pnt == otherVerts[i].pnt && verts[i].sqrdTime == otherVerts[i].sqrdTime;
+    }
+
+    if (!bIsEqual) {
+        fReport("The vertices differ.");
+    }
+
+    if (opts.bCompDcel) {
+        using HalfEdgeKey = std::tuple<double, double, double, double, int, bool>;
+        const auto fHalfEdges = [](const VorDcel &dcel) {
+            std::vector<HalfEdgeKey> res;
+            for (size_t i = 0; i < dcel.halfEdges().size(); i++) {
+                const auto &halfEdge = dcel.halfEdges()[i];
+                const auto &src = dcel.verts().at(halfEdge.origin),
+                        &tgt = dcel.verts().at(dcel.target(static_cast<int>(i)));
+                res.emplace_back(src.x, src.y, tgt.x, tgt.y, halfEdge.site, halfEdge.bIsArc);
+            }
+
+            std::sort(res.begin(), res.end());
+            return res;
+        };
+
+        if (fHalfEdges(dcel()) != fHalfEdges(other.dcel())) {
+            fReport("The DCELs differ.");
+        }
+    }
+
+    for (const auto &val : m_offCircs) {
+        const auto it = other.m_offCircs.find(val.first);
+        if (m_bIsLinear && it != other.m_offCircs.end()) {
+            continue;
+        }
+
+        if (it == other.m_offCircs.end() || val.second->isActive() != it->second->isActive()
+                || val.second->domSqrdTime() != it->second->domSqrdTime()
+                || val.second->arcs() != it->second->arcs()) {
+            fReport("The offset circle of the site " + std::to_string(val.first) + " differs.");
+        }
+    }
+
+    if (m_offCircs.size() != other.m_offCircs.size()) {
+        fReport("There are " + std::to_string(m_offCircs.size()) + " instead of "
+                + std::to_string(other.m_offCircs.size()) + " offset circles.");
+    }
+
+    std::cout << nDiffs << " differences to the recomputed diagram\n";
+    return nDiffs == 0;
+}
+
+// Outside of the box around the changed cells, the diagram does not change.
+// Within the box, it is recomputed in clip box mode, which takes only the
+// sites into account that may reach the box, and spliced into the edges.
+// The site oldId (if not negative) is removed and newSite (if any) takes
+// the offset circle of the local diagram, which is final since its cell lies
+// in the box. The other offset circles whose cells have changed are bounded
+// (the sites of the unbounded cells have the maximum weight), i.e., only
+// the times at which their last arcs vanish change.
+void VorDiag::repair(const CGAL::Bbox_2 &box, const SiteData *newSite, int oldId) {
+    // The bisectors and the moving intersections describe the sweep over
+    // the initial sites, hence they are dropped. The offset circles keep the
+    // moving intersections of their remaining arcs.
+    m_bisecs.clear();
+    m_isects.clear();
+    m_bIsRepaired = true;
+
+    auto opts = VorDiagOpts{};
+    opts.candMode = m_opts.candMode;
+    opts.queueType = m_opts.queueType;
+    opts.bUseDelaunay = false;
+    opts.nThreads = m_opts.nThreads;
+    opts.bCompEdges = true;
+    opts.bClip = true;
+    opts.clipBox = box;
+
+    const auto siteData = localSites(box, newSite, oldId);
+    const auto local = VorDiag{siteData, opts};
+    auto siteIds = spliceEdges(local, box, siteData, oldId);
+
+    if (oldId >= 0) {
+        removeSite(oldId);
+        siteIds.erase(oldId);
+    }
+
+    if (newSite) {
+        int id = std::get<3>(*newSite);
+        const auto &offCirc = local.m_offCircs.at(id);
+        addSite(offCirc->site());
+        m_offCircs[id] = offCirc;
+        siteIds.erase(id);
+    } else {
+        m_siteArcs.erase(oldId);
+        m_siteSegs.erase(oldId);
+    }
+
+    updateDomTimes(siteIds);
+    m_bIsTopoStale = true;
+}
+
+// The cell of a site s is contained in the Apollonius disk
+// {p : |p - s| / w(s) <= |p - t| / w(t)} of every heavier site t, i.e., in
+// the disk around (s - k^2 t) / (1 - k^2) with radius k |s - t| / (1 - k^2),
+// where k = w(s) / w(t). This disk contains the disk around s with radius
+// |s - t| k / (1 + k), hence the heavier sites are searched in rings of grid
+// cells around s only until their distance times k / (1 + k) (for the
+// smallest k) exceeds the distance from s to the corners of the box. Since
+// every disk contains the cell, stopping too early only enlarges the box.
+// The box of every disk is computed in double precision with a margin and
+// verified exactly, and if the margin does not suffice, false is returned
+// (i.e., the diagram is recomputed). Returns false if there is no heavier
+// site, too, since the cell may be unbounded then. A site of the diagram
+// with the same id is ignored.
+bool VorDiag::cellBox(const SiteData &site, CGAL::Bbox_2 &box) const {
+    double sx = std::get<0>(site), sy = std::get<1>(site), sw = std::get<2>(site);
+    if (m_weights.empty() || *m_weights.rbegin() <= sw) {
+        return false;
+    }
+
+    double kMin = sw / *m_weights.rbegin(), reach = kMin / (1. + kMin);
+    long long x = gridCell(sx, m_gridSize), y = gridCell(sy, m_gridSize);
+    bool bIsBounded = false, bIsExact = true;
+    size_t nVisited = 0;
+
+    // Returns true if the box contains the disk around (cx, cy) with the
+    // squared radius sqrdR.
+    const auto fContains = [](const CGAL::Bbox_2 &diskBox, const FT &cx, const FT &cy,
+                              const FT &sqrdR) {
+        for (const FT &d : {cx - FT{diskBox.xmin()}, FT{diskBox.xmax()} - cx,
+                            cy - FT{diskBox.ymin()}, FT{diskBox.ymax()} - cy}) {
+            if (d < 0 || d * d < sqrdR) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    const auto fVisit = [&](long long cellX, long long cellY) {
+        const auto it = m_siteGrid.find(gridKey(cellX, cellY));
+        if (it == m_siteGrid.end()) {
+            return;
+        }
+
+        for (int id : it->second) {
+            nVisited++;
+            const auto &t = m_sites.at(m_sitePos.at(id));
+            double tw = CGAL::to_double(t->weight());
+            if (tw <= sw || id == std::get<3>(site)) {
+                continue;
+            }
+
+            double tx = CGAL::to_double(t->center().x()),
+                    ty = CGAL::to_double(t->center().y()),
+                    k = sw / tw,
+                    cx = (sx - k * k * tx) / (1. - k * k),
+                    cy = (sy - k * k * ty) / (1. - k * k),
+                    r = k * std::hypot(sx - tx, sy - ty) / (1. - k * k);
+            // A margin for the rounding errors, which is verified exactly
+            // with the integer coordinates and weights.
+            r += 1e-9 * (r + std::abs(cx) + std::abs(cy)) + 1e-6;
+            const auto diskBox = CGAL::Bbox_2{cx - r, cy - r, cx + r, cy + r};
+            const FT fsx{sx}, fsy{sy}, fsw{sw}, ftx{tx}, fty{ty}, ftw{tw},
+                    denom = ftw * ftw - fsw * fsw;
+            bIsExact = bIsExact
+                    && fContains(diskBox, (ftw * ftw * fsx - fsw * fsw * ftx) / denom,
+                                 (ftw * ftw * fsy - fsw * fsw * fty) / denom,
+                                 fsw * fsw * ftw * ftw
+                                 * ((fsx - ftx) * (fsx - ftx) + (fsy - fty) * (fsy - fty))
+                                 / (denom * denom));
+
+            if (!bIsBounded) {
+                box = diskBox;
+                bIsBounded = true;
+            } else {
+                box = CGAL::Bbox_2{std::max(box.xmin(), cx - r), std::max(box.ymin(), cy - r),
+                                   std::min(box.xmax(), cx + r), std::min(box.ymax(), cy + r)};
+            }
+        }
+    };
+
+    // The sites in ring i are at least (i - 1) cells away from s.
+    for (long long ring = 0; nVisited < m_sites.size(); ring++) {
+        if (bIsBounded) {
+            double dx = std::max(std::abs(sx - box.xmin()), std::abs(sx - box.xmax())),
+                    dy = std::max(std::abs(sy - box.ymin()), std::abs(sy - box.ymax()));
+            if ((ring - 1) * m_gridSize * reach > std::hypot(dx, dy)) {
+                break;
+            }
+        }
+
+        forRing(x, y, x, y, ring, fVisit);
+    }
+
+    return bIsBounded && bIsExact;
+}
+
+// Returns a superset of the sites that may reach the box (see clipSites()),
+// which are collected in rings of grid cells around the box until the
+// distance to the ring exceeds the bound U of clipSites() over the sites
+// found so far times the maximum weight. U is kept exactly (by its square),
+// and the distance to ring i is taken as i - 2 cells, i.e., with a whole
+// cell of slack for sites that are rounded into a neighboring cell, such
+// that no site that may reach the box is missed. The site oldId is skipped,
+// and newSite (if any) is added.
+std::vector<SiteData> VorDiag::localSites(const CGAL::Bbox_2 &box,
+                                          const SiteData *newSite, int oldId) const {
+    std::vector<SiteData> res;
+    const FT xMin{box.xmin()}, yMin{box.ymin()}, xMax{box.xmax()}, yMax{box.ymax()};
+    FT wMax{*m_weights.rbegin()}, sqrdBound{0};
+    bool bIsBounded = false;
+
+    const auto fAdd = [&](const SiteData &s) {
+        const FT x{std::get<0>(s)}, y{std::get<1>(s)}, w{std::get<2>(s)};
+        const FT sqrdTime = boxMaxSqrdDist(xMin, yMin, xMax, yMax, x, y) / (w * w);
+        if (!bIsBounded || sqrdTime < sqrdBound) {
+            sqrdBound = sqrdTime;
+            bIsBounded = true;
+        }
+
+        wMax = std::max(wMax, w);
+        res.push_back(s);
+    };
+
+    if (newSite) {
+        fAdd(*newSite);
+    }
+
+    size_t nVisited = 0;
+    const auto fVisit = [&](long long x, long long y) {
+        const auto it = m_siteGrid.find(gridKey(x, y));
+        if (it == m_siteGrid.end()) {
+            return;
+        }
+
+        for (int id : it->second) {
+            nVisited++;
+            if (id != oldId) {
+                fAdd(toSiteData(m_sites.at(m_sitePos.at(id))));
+            }
+        }
+    };
+
+    long long x1 = gridCell(box.xmin(), m_gridSize), y1 = gridCell(box.ymin(), m_gridSize),
+            x2 = gridCell(box.xmax(), m_gridSize), y2 = gridCell(box.ymax(), m_gridSize);
+    // The sites in ring i are at least (i - 1) cells away from the box.
+    for (long long ring = 0; nVisited < m_sites.size(); ring++) {
+        if (bIsBounded && ring >= 2) {
+            const FT dist = FT{static_cast<double>(ring - 2)} * FT{m_gridSize};
+            if (dist * dist > sqrdBound * wMax * wMax) {
+                break;
+            }
+        }
+
+        forRing(x1, y1, x2, y2, ring, fVisit);
+    }
+
+    return res;
+}
+
+void VorDiag::addSite(const SitePtr &site) {
+    double x = CGAL::to_double(site->center().x()), y = CGAL::to_double(site->center().y());
+    m_sitePos[site->id()] = m_sites.size();
+    m_sites.push_back(site);
+    m_siteGrid[gridKey(gridCell(x, m_gridSize), gridCell(y, m_gridSize))].push_back(site->id());
+    m_weights.insert(static_cast<int>(CGAL::to_double(site->weight())));
+}
+
+// Removes the site and its offset circle, where the last site moves into its
+// place.
+void VorDiag::removeSite(int id) {
+    size_t pos = m_sitePos.at(id);
+    const auto site = m_sites.at(pos);
+    double x = CGAL::to_double(site->center().x()), y = CGAL::to_double(site->center().y());
+    long long key = gridKey(gridCell(x, m_gridSize), gridCell(y, m_gridSize));
+
+    auto &ids = m_siteGrid.at(key);
+    ids.erase(std::find(ids.begin(), ids.end(), id));
+    if (ids.empty()) {
+        m_siteGrid.erase(key);
+    }
+
+    m_weights.erase(m_weights.find(static_cast<int>(CGAL::to_double(site->weight()))));
+    m_sites.at(pos) = m_sites.back();
+    m_sitePos.at(m_sites.at(pos)->id()) = pos;
+    m_sites.pop_back();
+    m_sitePos.erase(id);
+    m_offCircs.erase(id);
+}
+
+// Replaces the edges of the given sites (and of oldId) within the box by the
+// edges of the local diagram, whose vertices are appended to m_vorVerts, and
+// joins the pieces of the edges that cross the sides of the box again (see
+// joinPieces()), such that the edges are those of a full recomputation.
+// Returns the sites whose edges have changed.
+std::set<int> VorDiag::spliceEdges(const VorDiag &local, const CGAL::Bbox_2 &box,
+                                   const std::vector<SiteData> &siteData, int oldId) {
+    const auto sides = boxLines(box);
+    std::set<int> res;
+
+    // Removing the edges in descending order does not move the others.
+    std::set<size_t, std::greater<size_t>> arcIds, segIds;
+    const auto fCollect = [&](int id) {
+        for (size_t i : m_siteArcs[id]) {
+            if (CGAL::do_overlap(m_vorEdges.at(i).bbox(), box)) {
+                arcIds.insert(i);
+            }
+        }
+
+        for (size_t i : m_siteSegs[id]) {
+            if (CGAL::do_overlap(m_vorSegs.at(i).bbox(), box)) {
+                segIds.insert(i);
+            }
+        }
+    };
+
+    for (const auto &site : siteData) {
+        fCollect(std::get<3>(site));
+    }
+
+    if (oldId >= 0) {
+        fCollect(oldId);
+    }
+
+    std::vector<std::pair<Circular_arc_2, EdgeInfo>> arcs;
+    for (size_t i : arcIds) {
+        const auto arc = m_vorEdges.at(i);
+        const auto info = m_vorEdgeInfos.at(i);
+        const auto &circ = arc.supporting_circle();
+        for (const auto &piece : clipArc(circ, arc.source(), arc.target(),
+                                         box, sides, false)) {
+            arcs.emplace_back(Circular_arc_2{circ, piece.first, piece.second},
+                              EdgeInfo{info.site1, info.site2,
+                                       piece.first == arc.source() ? info.vert1 : -1,
+                                       piece.second == arc.target() ? info.vert2 : -1});
+        }
+
+        removeEdge(m_vorEdges, m_vorEdgeInfos, m_siteArcs, i);
+        res.insert(info.site1);
+        res.insert(info.site2);
+    }
+
+    std::vector<std::pair<Line_arc_2, EdgeInfo>> segs;
+    for (size_t i : segIds) {
+        const auto seg = m_vorSegs.at(i);
+        const auto info = m_vorSegInfos.at(i);
+        const auto &line = seg.supporting_line();
+        for (const auto &piece : clipSeg(line, seg.source(), seg.target(),
+                                         box, sides, false)) {
+            segs.emplace_back(Line_arc_2{line, piece.first, piece.second},
+                              EdgeInfo{info.site1, info.site2,
+                                       piece.first == seg.source() ? info.vert1 : -1,
+                                       piece.second == seg.target() ? info.vert2 : -1});
+        }
+
+        removeEdge(m_vorSegs, m_vorSegInfos, m_siteSegs, i);
+        res.insert(info.site1);
+        res.insert(info.site2);
+    }
+
+    size_t nOldArcs = arcs.size(), nOldSegs = segs.size();
+    std::unordered_map<int, int> verts;
+    const auto fVert = [&](int vert) {
+        if (vert < 0) {
+            return -1;
+        }
+
+        const auto it = verts.emplace(vert, static_cast<int>(m_vorVerts.size()));
+        if (it.second) {
+            m_vorVerts.push_back(local.m_vorVerts.at(vert));
+        }
+
+        return it.first->second;
+    };
+
+    for (size_t i = 0; i < local.m_vorEdges.size(); i++) {
+        const auto &info = local.m_vorEdgeInfos.at(i);
+        arcs.emplace_back(local.m_vorEdges.at(i), EdgeInfo{info.site1, info.site2,
+                                                           fVert(info.vert1),
+                                                           fVert(info.vert2)});
+    }
+
+    for (size_t i = 0; i < local.m_vorSegs.size(); i++) {
+        const auto &info = local.m_vorSegInfos.at(i);
+        segs.emplace_back(local.m_vorSegs.at(i), EdgeInfo{info.site1, info.site2,
+                                                          fVert(info.vert1),
+                                                          fVert(info.vert2)});
+    }
+
+    arcs = joinPieces(arcs, nOldArcs);
+    segs = joinPieces(segs, nOldSegs);
+
+    for (const auto &arc : arcs) {
+        appendEdge(m_vorEdges, m_vorEdgeInfos, m_siteArcs, arc.first, arc.second);
+        res.insert(arc.second.site1);
+        res.insert(arc.second.site2);
+    }
+
+    for (const auto &seg : segs) {
+        appendEdge(m_vorSegs, m_vorSegInfos, m_siteSegs, seg.first, seg.second);
+        res.insert(seg.second.site1);
+        res.insert(seg.second.site2);
+    }
+
+    return res;
+}
+
+// The cell of an offset circle that has vanished is bounded, and its last
+// arc vanishes at the vertex of the cell that is farthest (in weighted
+// distance) from its site, since the time increases along the edges from
+// their collision points.
+void VorDiag::updateDomTimes(const std::set<int> &siteIds) {
+    for (int id : siteIds) {
+        const auto &offCirc = m_offCircs.at(id);
+        if (offCirc->isActive() || offCirc->domSqrdTime() < Root_of_2{0}) {
+            continue;
+        }
+
+        bool bFound = false;
+        Root_of_2 domSqrdTime{0};
+        const auto fUpdate = [&](int vert) {
+            if (vert >= 0 && (!bFound || domSqrdTime < m_vorVerts.at(vert).sqrdTime)) {
+                domSqrdTime = m_vorVerts.at(vert).sqrdTime;
+                bFound = true;
+            }
+        };
+
+        for (size_t i : m_siteArcs[id]) {
+            fUpdate(m_vorEdgeInfos.at(i).vert1);
+            fUpdate(m_vorEdgeInfos.at(i).vert2);
+        }
+
+        for (size_t i : m_siteSegs[id]) {
+            fUpdate(m_vorSegInfos.at(i).vert1);
+            fUpdate(m_vorSegInfos.at(i).vert2);
+        }
+
+        if (bFound) {
+            offCirc->restore(false, domSqrdTime, offCirc->arcs(), offCirc->isects(),
+                             offCirc->lefts(), offCirc->rights());
+        }
+    }
+}
+
+// Rebuilds the vertices from the end points of the edges that are vertices,
+// where equal points are merged, and the DCEL (if requested) from the edges
+// like compVorDcel().
+void VorDiag::rebuildTopology() const {
+    m_bIsTopoStale = false;
+
+    std::vector<VorVert> verts;
+    std::map<Circular_arc_point_2, int> ids;
+    const auto fVert = [&](int &vert) {
+        if (vert >= 0) {
+            const auto it = ids.emplace(m_vorVerts.at(vert).pnt, static_cast<int>(verts.size()));
+            if (it.second) {
+                verts.push_back(m_vorVerts.at(vert));
+            }
+
+            vert = it.first->second;
+        }
+    };
+
+    for (auto &info : m_vorEdgeInfos) {
+        fVert(info.vert1);
+        fVert(info.vert2);
+    }
+
+    for (auto &info : m_vorSegInfos) {
+        fVert(info.vert1);
+        fVert(info.vert2);
+    }
+
+    m_vorVerts.swap(verts);
+    m_nVorVerts = static_cast<int>(m_vorVerts.size());
+
+    if (!m_opts.bCompDcel && m_opts.dcelFilePath.empty()) {
+        return;
+    }
+
+    m_dcel = VorDcel{};
+    for (const auto &vert : m_vorVerts) {
+        m_dcel.addVert(CGAL::to_double(vert.pnt.x()), CGAL::to_double(vert.pnt.y()));
+    }
+
+    // The cell of the lighter site lies inside of the supporting circle.
+    const auto fSites = [this](const EdgeInfo &info, SitePtr &light, SitePtr &heavy) {
+        const auto &site1 = m_sites.at(m_sitePos.at(info.site1)),
+                &site2 = m_sites.at(m_sitePos.at(info.site2));
+        light = *site1 < *site2 ? site1 : site2;
+        heavy = *site1 < *site2 ? site2 : site1;
+    };
+
+    SitePtr light, heavy;
+    for (size_t i = 0; i < m_vorEdges.size(); i++) {
+        const auto &info = m_vorEdgeInfos.at(i);
+        if (info.vert1 < 0 || info.vert2 < 0) {
+            continue;
+        }
+
+        fSites(info, light, heavy);
+        const auto &circ = m_vorEdges.at(i).supporting_circle();
+        m_dcel.addArc(info.vert1, info.vert2, light->id(), heavy->id(),
+                      CGAL::to_double(circ.center().x()), CGAL::to_double(circ.center().y()),
+                      std::sqrt(CGAL::to_double(circ.squared_radius())));
+    }
+
+    for (size_t i = 0; i < m_vorSegs.size(); i++) {
+        const auto &info = m_vorSegInfos.at(i);
+        if (info.vert1 < 0 || info.vert2 < 0) {
+            continue;
+        }
+
+        fSites(info, light, heavy);
+        const auto &src = m_dcel.verts().at(info.vert1), &tgt = m_dcel.verts().at(info.vert2);
+        const auto center = light->center();
+        double x = CGAL::to_double(center.x()), y = CGAL::to_double(center.y());
+        bool bIsLightLeft = (tgt.x - src.x) * (y - src.y) - (tgt.y - src.y) * (x - src.x) > 0.;
+
+        m_dcel.addSeg(info.vert1, info.vert2, bIsLightLeft ? light->id() : heavy->id(),
+                      bIsLightLeft ? heavy->id() : light->id());
+    }
+
+    m_dcel.build();
+}
+
+std::vector<SiteData> VorDiag::sitesAsData() const {
+    std::vector<SiteData> res;
+    for (const auto &site : m_sites) {
+        res.push_back(toSiteData(site));
+    }
+
+    return res;
+}
+
+void VorDiag::compColls(const std::vector<std::set<int>> &candSets) {
+    std::set<std::pair<int, int>> candColls;
+    std::vector<std::pair<int, int>> candPairs;
+    for (const auto &candSet : candSets) {
+        for (int cand1 : candSet) {
+            for (int cand2 : candSet) {
+                if (cand1 != cand2 && cand1 != -1 && cand2 != -1) {
+                    const auto candPair = std::minmax({cand1, cand2});
+                    
+                    if (candColls.find(candPair) == candColls.end()) {
+                        candColls.insert(candPair);
+                        candPairs.push_back(candPair);
+                    }
+                }
+            }
+        }
+    }
+
+    compColls(candPairs);
+}
+
+// Computes intervals that contain the squared times d^2 / (w1 + w2)^2 of the
+// collisions of the pairs of point sites. The coordinates and the weights
+// are integers, hence the differences and the sums are exact in double
+// precision, and every operation adds a relative error of at most 2^-53. The
+// pairs are gathered into arrays first, such that the main loop vectorizes.
+static std::vector<TimeIval> collTimeIvals(const std::vector<double> &xs,
+        const std::vector<double> &ys, const std::vector<double> &ws,
+        const std::vector<std::pair<int, int>> &pairs) {
+    size_t n = pairs.size();
+    std::vector<double> dxs(n), dys(n), sums(n), times(n);
+    for (size_t i = 0; i < n; i++) {
+        dxs[i] = xs[pairs[i].first] - xs[pairs[i].second];
+        dys[i] = ys[pairs[i].first] - ys[pairs[i].second];
+        sums[i] = ws[pairs[i].first] + ws[pairs[i].second];
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        times[i] = (dxs[i] * dxs[i] + dys[i] * dys[i]) / (sums[i] * sums[i]);
+    }
+
+    const double err = 8. * std::numeric_limits<double>::epsilon();
+    std::vector<TimeIval> ivals(n);
+    for (size_t i = 0; i < n; i++) {
+        ivals[i] = TimeIval{times[i] * (1. - err), times[i] * (1. + err)};
+    }
+
+    return ivals;
+}
+
+// The collision events of all pairs are collected first and turned into the
+// event queue at once (in linear time).
+void VorDiag::compColls(const std::vector<std::pair<int, int>> &candPairs) {
+    std::vector<double> xs, ys, ws;
+    for (const auto &site : m_sites) {
+        const auto pnt = site->center();
+        xs.push_back(CGAL::to_double(pnt.x()));
+        ys.push_back(CGAL::to_double(pnt.y()));
+        ws.push_back(CGAL::to_double(site->weight()));
+    }
+
+    const auto ivals = collTimeIvals(xs, ys, ws, candPairs);
+    std::vector<EvPtr> evs;
+    for (size_t i = 0; i < candPairs.size(); i++) {
+        compCandColl(m_sites.at(candPairs[i].first), m_sites.at(candPairs[i].second),
+                     ivals[i], evs);
+    }
+
+    CGAL_assertion(m_queue.empty());
+    m_queue.assign(std::move(evs));
+}
+
+void VorDiag::compCandColl(const SitePtr &site1, const SitePtr &site2,
+                           const TimeIval &timeIval, std::vector<EvPtr> &evs) {
+    if (isBeyondMaxTime(site1, site2)) {
+        return;
+    }
+
+    const auto id = std::minmax({site1->id(), site2->id()});
+
+    if (m_bisecs.find(id) == m_bisecs.end()) {
+        const auto bisec = BisecFactory{site1, site2}.makeBisec();
+        m_bisecs[id] = bisec;
+    }
+
+    if (m_bisecs.at(id)->trajs().size() == 2) {
+        const auto traj1 = m_bisecs.at(id)->trajs().at(0),
+                traj2 = m_bisecs.at(id)->trajs().at(1);
+
+        evs.push_back(std::make_shared<CollEv>(traj1->start()->arcPnt(),
+                                               traj1->start()->sqrdTime(),
+                                               site1, traj1, traj2, false, timeIval));
+        evs.push_back(std::make_shared<CollEv>(traj1->start()->arcPnt(),
+                                               traj1->start()->sqrdTime(),
+                                               site2, traj1, traj2, false, timeIval));
+    } else if (m_bisecs.at(id)->trajs().size() == 4) {
+        CGAL_assertion(false);
+    }
+}
+
+void VorDiag::compColls() {
+    for (const auto &val1 : m_offCircs) {
+        for (const auto &val2 : m_offCircs) {
+            const auto site1 = val1.second->site(), site2 = val2.second->site();
+            compColl(site1, site2);
+        }
+    }
+}
+
+void VorDiag::compColl(const SitePtr &site1, const SitePtr &site2) {
+    if (site1->id() != site2->id() && !isBeyondMaxTime(site1, site2)) {
+        const auto id = std::minmax({site1->id(), site2->id()});
+
+        if (m_bisecs.find(id) == m_bisecs.end()) {
+            m_bisecs[id] = BisecFactory(site1, site2).makeBisec();
+        }
+
+        CGAL_assertion(m_bisecs.at(id)->trajs().size() == 2
+               || m_bisecs.at(id)->trajs().size() == 4);
+
+        if (m_bisecs.at(id)->trajs().size() == 2) {
+            const auto traj1 = m_bisecs[id]->trajs().at(0),
+                    traj2 = m_bisecs[id]->trajs().at(1);
+
+            // The domination event follows from the collision event (see
+            // processEv()), like for the candidate collisions.
+            pushEv(std::make_shared<CollEv>(traj1->start()->arcPnt(),
+                                            traj1->start()->sqrdTime(),
+                                            site1, traj1, traj2, false));
+        }
+    }
+}
+
+void VorDiag::run() {
+    std::vector<EvPtr> evs;
+    while (popGroup(evs)) {
+        handleGroup(evs);
+        checkCkpt(evs.size());
+    }
+}
+
+// Handles the events in windows of up to SWEEP_WINDOW groups per thread,
+// where the groups of a window touch disjoint sets of offset circles. The
+// groups are handled concurrently, and their effects are buffered. Then they
+// are committed in the order of the serial sweep, as long as no committed
+// group has pushed an event that the serial sweep would have handled before
+// (or along with) the next group. The remaining groups are rolled back and
+// handled again, hence the result equals the one of run().
+//
+// The groups of a window share no offset circles and moving intersections,
+// but they read and copy the handles of common CGAL objects, e.g., of the
+// points of the sites and of the bisectors. This relies on the atomic
+// reference counts of CGAL's handles (i.e., on CGAL_HAS_THREADS), and on the
+// exact kernel not caching lazily computed values in shared objects. New
+// moving intersections are inserted under a mutex, and the events and the
+// counters are buffered in the log.
+void VorDiag::runSpeculative(size_t nThreads) {
+    std::mutex isectMutex;
+    std::vector<std::vector<EvPtr>> groups;
+    std::vector<EvLog> logs;
+    std::atomic<size_t> next{0};
+    bool bDone = false;
+    boost::barrier barrier(static_cast<unsigned int>(nThreads));
+
+    const auto fHandle = [&]() {
+        for (size_t i = next++; i < groups.size(); i = next++) {
+            s_evLog = &logs[i];
+            handleGroup(groups[i]);
+            s_evLog = nullptr;
+        }
+    };
+
+    boost::thread_group threads;
+    for (size_t i = 1; i < nThreads; i++) {
+        threads.create_thread([&]() {
+            for (;;) {
+                barrier.wait();
+                if (bDone) {
+                    return;
+                }
+
+                fHandle();
+                barrier.wait();
+            }
+        });
+    }
+
+    std::vector<EvPtr> evs;
+    std::vector<std::vector<int>> groupSites;
+    std::set<int> siteIds;
+    while (popGroup(evs)) {
+        groups.assign(1, evs);
+        groupSites.assign(1, touchedSites(evs));
+        siteIds.clear();
+        siteIds.insert(groupSites.front().begin(), groupSites.front().end());
+
+        while (groups.size() < SWEEP_WINDOW * nThreads && popGroup(evs)) {
+            auto ids = touchedSites(evs);
+            if (std::any_of(ids.begin(), ids.end(),
+                            [&siteIds](int id) {
+                                return siteIds.count(id) > 0;
+                            })) {
+                for (const auto &ev : evs) {
+                    m_queue.push(ev);
+                }
+
+                break;
+            }
+
+            siteIds.insert(ids.begin(), ids.end());
+            groups.push_back(evs);
+            groupSites.push_back(std::move(ids));
+        }
+
+        if (groups.size() == 1) {
+            handleGroup(groups.front());
+            checkCkpt(groups.front().size());
+            continue;
+        }
+
+        logs.assign(groups.size(), EvLog{});
+        for (size_t i = 0; i < groups.size(); i++) {
+            logs[i].isectMutex = &isectMutex;
+            saveState(logs[i], groupSites[i]);
+        }
+
+        next = 0;
+        barrier.wait();
+        fHandle();
+        barrier.wait();
+
+        std::vector<EvPtr> pushed;
+        size_t nCommitted = 0, nEvs = 0;
+        for (; nCommitted < groups.size(); nCommitted++) {
+            const auto &group = groups[nCommitted];
+            if (!std::all_of(pushed.begin(), pushed.end(),
+                             [this, &group](const EvPtr &ev) {
+                                 return isLaterThan(ev, group);
+                             })) {
+                break;
+            }
+
+            commit(logs[nCommitted]);
+            nEvs += group.size();
+            pushed.insert(pushed.end(), logs[nCommitted].evs.begin(),
+                          logs[nCommitted].evs.end());
+        }
+
+        for (size_t i = groups.size(); i-- > nCommitted;) {
+            rollBack(logs[i]);
+            for (const auto &ev : groups[i]) {
+                m_queue.push(ev);
+            }
+        }
+
+        checkCkpt(nEvs);
+    }
+
+    bDone = true;
+    barrier.wait();
+    threads.join_all();
+}
+
+// Pops the next group of events from the queue, i.e., the events that the
+// serial sweep handles at once: the two events of a collision or a
+// domination, or the edge events at the same point.
+bool VorDiag::popGroup(std::vector<EvPtr> &evs) {
+    evs.clear();
+    if (m_queue.empty()) {
+        return false;
+    }
+
+    const auto ev = m_queue.top();
+    m_queue.pop();
+    evs.push_back(ev);
+
+    switch (ev->type()) {
+        case EvType::Coll:
+        {
+            if (!m_queue.empty() && m_queue.top()->type() == EvType::Coll) {
+                evs.push_back(m_queue.top());
+                m_queue.pop();
+            }
+            break;
+        }
+        case EvType::Dom:
+        {
+            // The event of the other site follows, since ties are broken by
+            // the bisector first. Duplicates of the event of the same site
+            // are dropped.
+            const auto bisecId = std::static_pointer_cast<DomEv>(ev)->isect1()->traj()->id();
+            while (!m_queue.empty() && m_queue.top()->type() == EvType::Dom
+                   && m_queue.top()->sqrdTime() == ev->sqrdTime()
+                   && std::static_pointer_cast<DomEv>(m_queue.top())->isect1()->traj()->id()
+                      == bisecId) {
+                const auto other = m_queue.top();
+                m_queue.pop();
+                if (other->site()->id() != ev->site()->id()) {
+                    evs.push_back(other);
+                    break;
+                }
+            }
+            break;
+        }
+        case EvType::Edge:
+        {
+            while (!m_queue.empty() && m_queue.top()->type() == EvType::Edge
+                   && m_queue.top()->arcPnt() == ev->arcPnt()) {
+                evs.push_back(m_queue.top());
+                m_queue.pop();
+            }
+
+            // The twins of a vertex leave the queue after its first event,
+            // hence the group is brought into the order of the queue.
+            std::sort(evs.begin(), evs.end(),
+                    [](const EvPtr &ev1, const EvPtr &ev2) { return EvPtrComp{}(ev2, ev1); });
+            break;
+        }
+        case EvType::None:
+        default:
+            break;
+    }
+
+    return true;
+}
+
+// Returns the (sorted) ids of the sites whose offset circles and moving
+// intersections a group of events may touch.
+std::vector<int> VorDiag::touchedSites(const std::vector<EvPtr> &evs) const {
+    std::vector<int> ids;
+    const auto fAdd = [&ids](const TrajPtr &traj) {
+        ids.push_back(traj->site1()->id());
+        ids.push_back(traj->site2()->id());
+    };
+
+    for (const auto &ev : evs) {
+        ids.push_back(ev->site()->id());
+
+        switch (ev->type()) {
+            case EvType::Coll:
+            {
+                const auto collEv = std::static_pointer_cast<CollEv>(ev);
+                fAdd(collEv->traj1());
+                fAdd(collEv->traj2());
+                break;
+            }
+            case EvType::Edge:
+            {
+                const auto edgeEv = std::static_pointer_cast<EdgeEv>(ev);
+                fAdd(edgeEv->isect1()->traj());
+                fAdd(edgeEv->isect2()->traj());
+                break;
+            }
+            case EvType::Dom:
+            {
+                const auto domEv = std::static_pointer_cast<DomEv>(ev);
+                fAdd(domEv->isect1()->traj());
+                fAdd(domEv->isect2()->traj());
+                break;
+            }
+            case EvType::None:
+            default:
+                break;
+        }
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    return ids;
+}
+
+// Returns true if the serial sweep would have handled the group of events
+// in the same way after ev had been pushed, i.e., if ev is popped after the
+// group and could not have been popped along with it.
+bool VorDiag::isLaterThan(const EvPtr &ev, const std::vector<EvPtr> &evs) const {
+    if (!EvPtrComp{}(ev, evs.back())) {
+        return false;
+    }
+
+    switch (evs.front()->type()) {
+        case EvType::Coll:
+            return evs.size() > 1 || ev->type() != EvType::Coll;
+        case EvType::Dom:
+            return evs.size() > 1;
+        case EvType::Edge:
+            return ev->type() != EvType::Edge || ev->arcPnt() != evs.front()->arcPnt();
+        case EvType::None:
+        default:
+            return true;
+    }
+}
+
+// Saves the moving intersections between the given sites and attaches an
+// undo to their offset circles, which saves only the arcs and neighbors that
+// the group of events changes, such that the group can be rolled back.
+void VorDiag::saveState(EvLog &log, const std::vector<int> &siteIds) const {
+    // The undos must not move once they are attached.
+    log.offCircs.reserve(siteIds.size());
+    for (int id : siteIds) {
+        const auto &offCirc = m_offCircs.at(id);
+        log.offCircs.emplace_back(offCirc, OffCircUndo{});
+        offCirc->attachUndo(log.offCircs.back().second);
+    }
+
+    for (size_t i = 0; i < siteIds.size(); i++) {
+        for (size_t j = i + 1; j < siteIds.size(); j++) {
+            for (auto it = m_isects.lower_bound(std::make_tuple(siteIds[i], siteIds[j],
+                                                                false, false));
+                 it != m_isects.end() && std::get<0>(it->first) == siteIds[i]
+                 && std::get<1>(it->first) == siteIds[j]; ++it) {
+                log.isects.emplace_back(it->second, *it->second);
+            }
+        }
+    }
+}
+
+void VorDiag::commit(const EvLog &log) {
+    for (const auto &val : log.offCircs) {
+        val.first->detachUndo();
+    }
+
+    for (const auto &val : log.cnts) {
+        *val.first += val.second;
+    }
+
+    for (size_t i = 0; i < log.stamps.size(); i++) {
+        int vertId = vertAt(log.stamps[i].first);
+        for (const auto &isect : log.stamps[i].second) {
+            isect->restampSwitches(PROVISIONAL_VERT - static_cast<int>(i), vertId);
+        }
+    }
+
+    for (const auto &ev : log.evs) {
+        m_queue.push(ev);
+    }
+}
+
+void VorDiag::rollBack(const EvLog &log) {
+    for (const auto &val : log.offCircs) {
+        val.first->detachUndo();
+        val.first->restore(val.second);
+    }
+
+    for (const auto &val : log.isects) {
+        *val.first = val.second;
+    }
+
+    for (const auto &id : log.newIsects) {
+        m_isects.erase(id);
+    }
+}
+
+// Returns the counter to increment, which is buffered in the log while a
+// group of events is handled speculatively.
+int & VorDiag::cnt(int &counter) const {
+    return s_evLog ? s_evLog->cnts[&counter] : counter;
+}
+
+void VorDiag::handleGroup(const std::vector<EvPtr> &evs) {
+    const auto &ev = evs.front();
+
+    switch (ev->type()) {
+        case EvType::Coll:
+        {
+            const auto collEv = std::static_pointer_cast<CollEv>(ev);
+            handleEv(collEv, evs);
+            break;
+        }
+        case EvType::Edge:
+        {
+            const auto edgeEv = std::static_pointer_cast<EdgeEv>(ev);
+            handleEv(edgeEv, evs);
+            break;
+        }
+        case EvType::Dom:
+        {
+            const auto domEv = std::static_pointer_cast<DomEv>(ev);
+            handleEv(domEv, evs);
+            break;
+        }
+        case EvType::None:
+        default:
+            break;
+    }
+}
+
+// Writes a checkpoint if ckptEvCnt events have been handled or ckptSecs
+// seconds have passed since the last one. It is called between groups of
+// events, when all effects of the handled events are in place.
+// Since a checkpoint is written in full (see writeCkpt()), ckptEvCnt and
+// ckptSecs should be large compared to the size of the state.
+void VorDiag::checkCkpt(size_t nEvs) {
+    if (m_opts.ckptFilePath.empty()) {
+        return;
+    }
+
+    m_nCkptEvs += nEvs;
+    if ((m_opts.ckptEvCnt == 0 || m_nCkptEvs < m_opts.ckptEvCnt)
+        && (m_opts.ckptSecs <= 0.
+            || std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                             - m_ckptTime).count() < m_opts.ckptSecs)) {
+        return;
+    }
+
+    if (!writeCkpt(m_opts.ckptFilePath)) {
+        std::cout << "Could not write checkpoint " << m_opts.ckptFilePath << ".\n";
+    }
+
+    m_nCkptEvs = 0;
+    m_ckptTime = std::chrono::steady_clock::now();
+}
+
+static void putId(CkptWriter &cw, const MovIsectId &id) {
+    cw.put(static_cast<int32_t>(std::get<0>(id)));
+    cw.put(static_cast<int32_t>(std::get<1>(id)));
+    cw.put(std::get<2>(id));
+    cw.put(std::get<3>(id));
+}
+
+static bool getId(CkptReader &cr, MovIsectId &id) {
+    int32_t site1, site2;
+    bool bIsLeft, bIsFirst;
+    if (!cr.get(site1) || !cr.get(site2) || !cr.get(bIsLeft) || !cr.get(bIsFirst)) {
+        return false;
+    }
+
+    id = std::make_tuple(site1, site2, bIsLeft, bIsFirst);
+    return true;
+}
+
+// Returns the id of the moving intersection along the trajectory.
+static MovIsectId trajId(const TrajPtr &traj) {
+    return std::make_tuple(traj->id().first, traj->id().second, traj->isLeft(),
+                           traj->isFirst());
+}
+
+// Returns the trajectory with the given id (null if there is none).
+static TrajPtr findTraj(const std::map<std::pair<int, int>, BisecPtr> &bisecs,
+                        const MovIsectId &id) {
+    const auto it = bisecs.find(std::make_pair(std::get<0>(id), std::get<1>(id)));
+    if (it != bisecs.end()) {
+        for (const auto &traj : it->second->trajs()) {
+            if (traj->isLeft() == std::get<2>(id) && traj->isFirst() == std::get<3>(id)) {
+                return traj;
+            }
+        }
+    }
+
+    return TrajPtr{};
+}
+
+// Writes the state of the sweep, i.e., the sites (to recognize the input),
+// the counters, the bisectors (by their sites, in the order of their keys in
+// m_bisecs), the moving intersections, the offset circles, the vertices and
+// the events in the queue. Trajectories and moving intersections are
+// referred to by their ids. Every checkpoint is complete, hence it takes time
+// linear in the total size of the state, regardless of how little has
+// changed since the last one. The events are written as they are stored in
+// the queue (see EvQueue::forEach()), without copying it, and readCkpt()
+// rebuilds the queue from them.
+bool VorDiag::writeCkpt(const std::string &filePath) const {
+    // A repaired diagram has no sweep to resume.
+    if (m_bIsRepaired) {
+        return false;
+    }
+
+    CkptWriter cw{filePath};
+    if (!cw.isOpen()) {
+        return false;
+    }
+
+    const auto siteData = sitesAsData();
+    cw.put(static_cast<uint64_t>(siteData.size()));
+    for (const auto &s : siteData) {
+        cw.put(static_cast<int32_t>(std::get<0>(s)));
+        cw.put(static_cast<int32_t>(std::get<1>(s)));
+        cw.put(static_cast<int32_t>(std::get<2>(s)));
+        cw.put(static_cast<int32_t>(std::get<3>(s)));
+    }
+
+    for (int counter : {m_collEvCnt, m_invalidCollEvCnt, m_domEvCnt, m_invalidDomEvCnt,
+                        m_edgeEvCnt, m_invalidEdgeEvCnt, m_nVorVerts}) {
+        cw.put(static_cast<int32_t>(counter));
+    }
+
+    cw.put(static_cast<uint64_t>(m_bisecs.size()));
+    for (const auto &val : m_bisecs) {
+        cw.put(static_cast<int32_t>(val.second->site1()->id()));
+        cw.put(static_cast<int32_t>(val.second->site2()->id()));
+    }
+
+    cw.put(static_cast<uint64_t>(m_isects.size()));
+    for (const auto &val : m_isects) {
+        const auto &isect = val.second;
+        putId(cw, val.first);
+        cw.put(isect->isWfVert());
+        cw.put(static_cast<uint64_t>(isect->switches().size()));
+        for (size_t i = 0; i < isect->switches().size(); i++) {
+            cw.put(isect->switches()[i].first);
+            cw.put(isect->switches()[i].second);
+            cw.put(static_cast<int32_t>(isect->switchVerts()[i]));
+        }
+    }
+
+    cw.put(static_cast<uint64_t>(m_offCircs.size()));
+    for (const auto &val : m_offCircs) {
+        const auto &offCirc = val.second;
+        cw.put(static_cast<int32_t>(val.first));
+        cw.put(offCirc->isActive());
+        cw.put(offCirc->domSqrdTime());
+
+        cw.put(static_cast<uint64_t>(offCirc->arcs().size()));
+        for (const auto &arc : offCirc->arcs()) {
+            putId(cw, arc.first.first);
+            putId(cw, arc.first.second);
+            cw.put(arc.second);
+        }
+
+        cw.put(static_cast<uint64_t>(offCirc->isects().size()));
+        for (const auto &isect : offCirc->isects()) {
+            putId(cw, isect.first);
+        }
+
+        for (const auto *links : {&offCirc->lefts(), &offCirc->rights()}) {
+            cw.put(static_cast<uint64_t>(links->size()));
+            for (const auto &link : *links) {
+                putId(cw, link.first);
+                putId(cw, link.second);
+            }
+        }
+    }
+
+    cw.put(static_cast<uint64_t>(m_vorVerts.size()));
+    for (const auto &vert : m_vorVerts) {
+        cw.put(vert.pnt);
+        cw.put(vert.sqrdTime);
+    }
+
+    cw.put(static_cast<uint64_t>(m_queue.size()));
+    m_queue.forEach([&cw](const EvPtr &ev) {
+        cw.put(static_cast<int32_t>(ev->type()));
+        cw.put(static_cast<int32_t>(ev->site()->id()));
+        cw.put(ev->arcPnt());
+        cw.put(ev->sqrdTime());
+        if (ev->type() == EvType::Coll) {
+            const auto collEv = std::static_pointer_cast<CollEv>(ev);
+            putId(cw, trajId(collEv->traj1()));
+            putId(cw, trajId(collEv->traj2()));
+            cw.put(collEv->pierces());
+        } else if (ev->type() == EvType::Dom) {
+            const auto domEv = std::static_pointer_cast<DomEv>(ev);
+            putId(cw, domEv->isect1()->id());
+            putId(cw, domEv->isect2()->id());
+        } else {
+            const auto edgeEv = std::static_pointer_cast<EdgeEv>(ev);
+            putId(cw, edgeEv->isect1()->id());
+            putId(cw, edgeEv->isect2()->id());
+        }
+    });
+
+    return cw.close();
+}
+
+// Restores the state of the sweep from a checkpoint that has been written
+// for the same (clipped and sorted) sites. The bisectors are constructed
+// again; everything else is read. The state is replaced only if the whole
+// checkpoint is valid.
+bool VorDiag::readCkpt(const std::string &filePath, const std::vector<SiteData> &siteData) {
+    CkptReader cr{filePath};
+    uint64_t n = 0;
+    if (!cr.isValid() || !cr.get(n) || n != siteData.size()) {
+        return false;
+    }
+
+    for (const auto &s : siteData) {
+        int32_t x, y, w, id;
+        if (!cr.get(x) || !cr.get(y) || !cr.get(w) || !cr.get(id)
+            || SiteData{x, y, w, id} != s) {
+            return false;
+        }
+    }
+
+    int32_t counters[7];
+    for (auto &counter : counters) {
+        if (!cr.get(counter)) {
+            return false;
+        }
+    }
+
+    std::map<std::pair<int, int>, BisecPtr> bisecs;
+    if (!cr.get(n)) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < n; i++) {
+        int32_t site1, site2;
+        if (!cr.get(site1) || !cr.get(site2) || m_offCircs.count(site1) == 0
+            || m_offCircs.count(site2) == 0) {
+            return false;
+        }
+
+        bisecs[std::minmax({site1, site2})] = BisecFactory{m_offCircs.at(site1)->site(),
+                                                          m_offCircs.at(site2)->site()}.makeBisec();
+    }
+
+    std::map<MovIsectId, MovIsectPtr> isects;
+    if (!cr.get(n)) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < n; i++) {
+        MovIsectId id;
+        bool bIsWfVert;
+        uint64_t nSwitches = 0;
+        if (!getId(cr, id) || !cr.get(bIsWfVert) || !cr.get(nSwitches)) {
+            return false;
+        }
+
+        const auto traj = findTraj(bisecs, id);
+        if (!traj) {
+            return false;
+        }
+
+        std::vector<std::pair<Root_of_2, bool>> switches(nSwitches);
+        std::vector<int> switchVerts(nSwitches);
+        for (uint64_t j = 0; j < nSwitches; j++) {
+            int32_t vertId;
+            if (!cr.get(switches[j].first) || !cr.get(switches[j].second)
+                || !cr.get(vertId)) {
+                return false;
+            }
+
+            switchVerts[j] = vertId;
+        }
+
+        const auto isect = std::make_shared<MovIsect>(traj);
+        isect->restore(bIsWfVert, std::move(switches), std::move(switchVerts));
+        isects[id] = isect;
+    }
+
+    const auto fIsect = [&isects, &cr](MovIsectPtr &isect) {
+        MovIsectId id;
+        if (!getId(cr, id) || isects.find(id) == isects.end()) {
+            return false;
+        }
+
+        isect = isects.at(id);
+        return true;
+    };
+
+    std::map<int, OffCircPtr> offCircs;
+    if (!cr.get(n) || n != m_offCircs.size()) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < n; i++) {
+        int32_t siteId;
+        bool bIsActive;
+        Root_of_2 domSqrdTime;
+        if (!cr.get(siteId) || m_offCircs.count(siteId) == 0 || !cr.get(bIsActive)
+            || !cr.get(domSqrdTime)) {
+            return false;
+        }
+
+        uint64_t nArcs = 0;
+        ArcStates arcs;
+        if (!cr.get(nArcs)) {
+            return false;
+        }
+
+        for (uint64_t j = 0; j < nArcs; j++) {
+            MovIsectId from, to;
+            bool bIsOnWf;
+            if (!getId(cr, from) || !getId(cr, to) || !cr.get(bIsOnWf)) {
+                return false;
+            }
+
+            arcs[std::make_pair(from, to)] = bIsOnWf;
+        }
+
+        uint64_t nIsects = 0;
+        std::map<MovIsectId, MovIsectPtr> circIsects;
+        if (!cr.get(nIsects)) {
+            return false;
+        }
+
+        for (uint64_t j = 0; j < nIsects; j++) {
+            MovIsectPtr isect;
+            if (!fIsect(isect)) {
+                return false;
+            }
+
+            circIsects[isect->id()] = isect;
+        }
+
+        std::map<MovIsectId, MovIsectId> links[2];
+        for (auto &sideLinks : links) {
+            uint64_t nLinks = 0;
+            if (!cr.get(nLinks)) {
+                return false;
+            }
+
+            for (uint64_t j = 0; j < nLinks; j++) {
+                MovIsectId id, neighbor;
+                if (!getId(cr, id) || !getId(cr, neighbor)) {
+                    return false;
+                }
+
+                sideLinks[id] = neighbor;
+            }
+        }
+
+        const auto offCirc = std::make_shared<OffCirc>(m_offCircs.at(siteId)->site());
+        offCirc->restore(bIsActive, domSqrdTime, std::move(arcs), std::move(circIsects),
+                         std::move(links[0]), std::move(links[1]));
+        offCircs[siteId] = offCirc;
+    }
+
+    std::vector<VorVert> vorVerts;
+    if (!cr.get(n)) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < n; i++) {
+        auto vert = VorVert{};
+        if (!cr.get(vert.pnt) || !cr.get(vert.sqrdTime)) {
+            return false;
+        }
+
+        vorVerts.push_back(vert);
+    }
+
+    std::vector<EvPtr> evs;
+    if (!cr.get(n)) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < n; i++) {
+        int32_t type, siteId;
+        Circular_arc_point_2 arcPnt;
+        Root_of_2 sqrdTime;
+        if (!cr.get(type) || !cr.get(siteId) || offCircs.count(siteId) == 0
+            || !cr.get(arcPnt) || !cr.get(sqrdTime)) {
+            return false;
+        }
+
+        const auto &site = offCircs.at(siteId)->site();
+        if (type == static_cast<int32_t>(EvType::Coll)) {
+            MovIsectId id1, id2;
+            bool bPierces;
+            if (!getId(cr, id1) || !getId(cr, id2) || !cr.get(bPierces)) {
+                return false;
+            }
+
+            const auto traj1 = findTraj(bisecs, id1), traj2 = findTraj(bisecs, id2);
+            if (!traj1 || !traj2) {
+                return false;
+            }
+
+            evs.push_back(std::make_shared<CollEv>(arcPnt, sqrdTime, site, traj1, traj2,
+                                                   bPierces));
+        } else {
+            MovIsectPtr isect1, isect2;
+            if (!fIsect(isect1) || !fIsect(isect2)) {
+                return false;
+            }
+
+            if (type == static_cast<int32_t>(EvType::Dom)) {
+                evs.push_back(std::make_shared<DomEv>(arcPnt, sqrdTime, site, isect1, isect2));
+            } else {
+                evs.push_back(std::make_shared<EdgeEv>(arcPnt, sqrdTime, site, isect1, isect2));
+            }
+        }
+    }
+
+    m_bisecs.swap(bisecs);
+    m_isects.swap(isects);
+    m_offCircs.swap(offCircs);
+    m_vorVerts.swap(vorVerts);
+    m_queue.assign(std::move(evs));
+
+    int *dsts[] = {&m_collEvCnt, &m_invalidCollEvCnt, &m_domEvCnt, &m_invalidDomEvCnt,
+                   &m_edgeEvCnt, &m_invalidEdgeEvCnt, &m_nVorVerts};
+    for (size_t i = 0; i < 7; i++) {
+        *dsts[i] = counters[i];
+    }
+
+    return true;
+}
+
+void VorDiag::handleEv(const std::shared_ptr<CollEv> &collEv1,
+                       const std::vector<EvPtr> &evs) {
+    CGAL_assertion(evs.size() == 2);
+    if (evs.size() == 2) {
+        const auto collEv2 = std::static_pointer_cast<CollEv>(evs.back());
+        bool bDom = (*collEv1->site() > *collEv2->site()),
+                bIsValid = isValidCollEv(collEv1, collEv2);
+        
+        CGAL_assertion(collEv1->sqrdTime() == collEv2->sqrdTime());
+        CGAL_assertion(collEv1->pierces() == collEv2->pierces());
+        processEv(collEv1, bDom, bIsValid, collEv1->pierces());
+        processEv(collEv2, !bDom, bIsValid, collEv1->pierces());
+    }
+}
+
+bool VorDiag::isValidCollEv(const std::shared_ptr<CollEv> &collEv1,
+                            const std::shared_ptr<CollEv> &collEv2) const {
+    const auto offCirc1 = m_offCircs.at(collEv1->site()->id()),
+            offCirc2 = m_offCircs.at(collEv2->site()->id());
+    const auto arcPnt = collEv1->arcPnt();
+    const auto sqrdTime = collEv1->sqrdTime();
+
+    return offCirc1->isInActiveArc(sqrdTime, arcPnt) && offCirc2->isInActiveArc(sqrdTime, arcPnt);
+}
+
+bool VorDiag::isValidDomEv(const std::shared_ptr<DomEv> &domEv1,
+                           const std::shared_ptr<DomEv> &domEv2) const {
+    const auto offCirc1 = m_offCircs.at(domEv1->site()->id()),
+            offCirc2 = m_offCircs.at(domEv2->site()->id());
+    const auto arcPnt = domEv1->arcPnt();
+    const auto sqrdTime = domEv1->sqrdTime();
+
+    return (offCirc1->isInActiveArc(sqrdTime, arcPnt) && offCirc2->isInActiveArc(sqrdTime, arcPnt))
+            || (offCirc1->isActive() && offCirc2->isActive());
+}
+
+void VorDiag::processEv(const std::shared_ptr<CollEv> &collEv, bool bDom,
+                        bool bIsValid, bool bPierces) {
+#ifdef ENABLE_LOGGING
+    BOOST_LOG_NAMED_SCOPE("processCollEv");
+    src::severity_logger<severity_level> slg;
+#endif
+    
+    const auto sqrdTime = collEv->sqrdTime();
+    const auto site = collEv->site();
+    const auto offCirc = m_offCircs.at(site->id());
+    const auto &isect1 = makeMovIsect(collEv->traj1()),
+            &isect2 = makeMovIsect(collEv->traj2());
+    
+    CGAL_assertion(collEv->traj1()->isLeft() && !collEv->traj2()->isLeft());
+
+    if (bIsValid) {
+#ifdef ENABLE_LOGGING
+        BOOST_LOG_SEV(slg, normal) << "Triggered valid collision event at time "
+                << std::sqrt(CGAL::to_double(sqrdTime))
+                << " along offset circle " << collEv->site()->id() << ".";
+#endif
+    
+        offCirc->spawnArc(sqrdTime, isect1, isect2, bDom, bPierces);
+        stampSwitches(collEv, {isect1, isect2});
+        checkEdgeEv(offCirc, sqrdTime, isect1, bPierces ? !bDom : bDom);
+        checkEdgeEv(offCirc, sqrdTime, isect2, bPierces ? bDom : !bDom);
+        storeEv(collEv);
+    } else {
+#ifdef ENABLE_LOGGING
+        BOOST_LOG_SEV(slg, normal) << "Ignored invalid collision event at time "
+                << std::sqrt(CGAL::to_double(sqrdTime))
+                << " along offset circle " << collEv->site()->id() << ".";
+#endif
+        cnt(m_invalidCollEvCnt)++;
+    }
+
+    pushEv(std::make_shared<DomEv>(isect1->traj()->end()->arcPnt(),
+                                   isect1->traj()->end()->sqrdTime(),
+                                   site, isect1, isect2));
+}
+
+void VorDiag::handleEv(const std::shared_ptr<DomEv> &domEv1,
+                       const std::vector<EvPtr> &evs) {
+#ifdef ENABLE_LOGGING
+    BOOST_LOG_NAMED_SCOPE("handleDomEv");
+    src::severity_logger<severity_level> slg;
+#endif
+    
+    CGAL_assertion(evs.size() == 2);
+    const auto ev = evs.back();
+    
+    CGAL_assertion(ev->type() == EvType::Dom);
+    if (evs.size() == 2 && ev->type() == EvType::Dom) {
+        const auto domEv2 = std::static_pointer_cast<DomEv>(ev);
+        //bool bDom = domEv1->site()->weight() > domEv2->site()->weight();
+        bool bDom = *domEv1->site() > *domEv2->site();
+    
+        CGAL_assertion(domEv1->sqrdTime() == domEv2->sqrdTime());
+
+        if (isValidDomEv(domEv1, domEv2)) {
+            processEv(domEv1, bDom);
+            processEv(domEv2, !bDom);
+        } else {
+            cnt(m_invalidDomEvCnt) += 2;
+#ifdef ENABLE_LOGGING
+            BOOST_LOG_SEV(slg, normal)
+                    << "Ignored two invalid domination events at time "
+                    << std::sqrt(CGAL::to_double(domEv1->sqrdTime()))
+                    << " along the offset circles "
+                    << domEv1->site()->id() << " and "
+                    << domEv2->site()->id() << ".";
+#endif
+        }
+    }
+}
+
+void VorDiag::processEv(const std::shared_ptr<DomEv> &domEv, bool bDom) {
+    const auto sqrdTime = domEv->sqrdTime();
+    const auto site = domEv->site();
+    const auto offCirc = m_offCircs.at(site->id());
+    const auto isect1 = domEv->isect1(), isect2 = domEv->isect2();
+
+#ifdef ENABLE_LOGGING
+    BOOST_LOG_NAMED_SCOPE("processDomEv");
+    src::severity_logger<severity_level> slg;
+    BOOST_LOG_SEV(slg, normal) << "Triggered valid domination event at time "
+            << std::sqrt(CGAL::to_double(sqrdTime))
+            << " along offset circle " << domEv->site()->id() << ".";
+#endif
+    
+    std::pair<MovIsectPtr, MovIsectPtr> newArc;
+    bool bOk = offCirc->deleteArc(newArc, sqrdTime, isect1, isect2, bDom);
+    stampSwitches(domEv, {isect1, isect2});
+    if (bOk) {
+        checkEdgeEv(offCirc, sqrdTime, newArc.first, newArc.second);
+    }
+
+    storeEv(domEv);
+}
+
+void VorDiag::handleEv(const std::shared_ptr<EdgeEv> &edgeEv,
+                       const std::vector<EvPtr> &evs) {
+    const auto sqrdTime = edgeEv->sqrdTime();
+    const auto site1 = edgeEv->site(),
+            &site2 = otherSite(site1, edgeEv->isect1()),
+            &site3 = otherSite(site1, edgeEv->isect2());
+
+#ifdef ENABLE_LOGGING
+    BOOST_LOG_NAMED_SCOPE("handleEdgeEv");
+    src::severity_logger<severity_level> slg;
+    BOOST_LOG_SEV(slg, normal) << "Triggered edge event at time "
+            << std::sqrt(CGAL::to_double(sqrdTime))
+            << " involving the sites "
+            << site1->id() << " (with weight " << site1->weight() << "), "
+            << site2->id() << " (with weight " << site2->weight() << "), "
+            << site3->id() << " (with weight " << site3->weight() << ").";
+#endif
+
+    std::set<int> ids;
+    ids.insert(edgeEv->site()->id());
+    std::vector<std::shared_ptr<EdgeEv>> twins;
+
+#ifdef ENABLE_LOGGING
+    if (evs.size() > 1) {
+        BOOST_LOG_SEV(slg, normal) << "The current event point equals the next event point.";
+    }
+#endif
+    // The other edge events at the same point have been popped along with
+    // the event (see popGroup()).
+    for (size_t i = 1; i < evs.size(); i++) {
+        const auto &nextEv = evs[i];
+        const auto twin = std::static_pointer_cast<EdgeEv>(nextEv);
+        const auto offCirc = m_offCircs.at(nextEv->site()->id());
+        const auto isect1 = twin->isect1(), isect2 = twin->isect2();
+
+        if (ids.find(nextEv->site()->id()) == ids.end()
+            && offCirc->inclsIsect(isect1) && offCirc->inclsIsect(isect2)) {
+            twins.push_back(twin);
+            ids.insert(nextEv->site()->id());
+
+#ifdef ENABLE_LOGGING
+            BOOST_LOG_SEV(slg, normal) << "Found twin event at site "
+                    << nextEv->site()->id() << ".";
+#endif
+            cnt(m_edgeEvCnt)++;
+        } else {
+#ifdef ENABLE_LOGGING
+            BOOST_LOG_SEV(slg, warning) << "Invalid edge event found!";
+#endif
+            cnt(m_invalidEdgeEvCnt)++;
+        }
+    }
 
-    return (offCirc1->isInActiveArc(sqrdTime, arcPnt) && offCirc2->isInActiveArc(sqrdTime, arcPnt))
-            || (offCirc1->isActive() && offCirc2->isActive());
+    if (!twins.empty()) {
+#ifdef ENABLE_LOGGING
+        BOOST_LOG_SEV(slg, normal) << "Three arcs vanished simultaneously.";
+#endif
+        SitePtr lowSite, medSite, highSite;
+        if (twins.size() != 2) {
+#ifdef ENABLE_LOGGING
+            BOOST_LOG_SEV(slg, warning) << "Number of twin events does not equal two!";
+#endif
+            std::vector<SitePtr> sites{site1, site2, site3};
+            std::sort(sites.begin(), sites.end(),
+                      [](const SitePtr &lhs, const SitePtr & rhs) {
+                          //return lhs->weight() < rhs->weight();
+                          return *lhs < *rhs;
+                      }
+                      );
+
+            lowSite = sites.at(0);
+            medSite = sites.at(1);
+            highSite = sites.at(2);
+        } else {
+            twins.push_back(edgeEv);
+            std::sort(twins.begin(), twins.end(),
+                      [](const std::shared_ptr<EdgeEv> &lhs,
+                         const std::shared_ptr<EdgeEv> & rhs) {
+                          //return lhs->site()->weight() < rhs->site()->weight();
+                          return *lhs->site() < *rhs->site();
+                      }
+                      );
+
+            lowSite = twins.at(0)->site();
+            medSite = twins.at(1)->site();
+            highSite = twins.at(2)->site();
+        }
+
+        if (!deleteLowestArc(edgeEv, lowSite, medSite, highSite)) {
+            return;
+        }
+    } else {
+        if (*site1 > *site2 && *site1 > *site3) {
+#ifdef ENABLE_LOGGING
+            BOOST_LOG_SEV(slg, normal) << "Arc vanished along the highest weighted site.";
+#endif
+            const auto lowSite = *site2 < *site3 ? site2 : site3,
+                    medSite = *site2 < *site3 ? site3 : site2;
+
+            const auto &isect1 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, medSite),
+                    &isect2 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, site1),
+                    &isect3 = makeMovIsectAt(edgeEv->arcPnt(), medSite, site1);
+
+            if (!isect1 || !isect2 || !isect3) {
+                return;
+            }
+            
+            const auto low = m_offCircs.at(lowSite->id()),
+                    med = m_offCircs.at(medSite->id()),
+                    high = m_offCircs.at(site1->id());
+
+            if (!low->inclsIsect(isect2) || !med->inclsIsect(isect3)
+                || !high->inclsIsect(isect2) || !high->inclsIsect(isect3)) {
+#ifdef ENABLE_LOGGING
+                BOOST_LOG_SEV(slg, warning) << "Invalid edge event found!";
+#endif
+                cnt(m_invalidEdgeEvCnt)++;
+                return;
+            }
+
+            bool bIsWfVert2 = isect2->isWfVert(),
+                    bIsWfVert3 = isect3->isWfVert();
+            const auto bCheckNeighbors = med->expandIsect(sqrdTime, edgeEv->arcPnt(),
+                                                          isect3, isect1,
+                                                          bIsWfVert2 && !bIsWfVert3);
+            bool bLeft1 = high->collapseArc(sqrdTime, isect2, isect3),
+                    bLeft3 = low->replaceIsect(sqrdTime, isect2, isect1);
+
+            checkEdgeEv(high, sqrdTime, isect3, bLeft1);
+
+            if (bCheckNeighbors.first) {
+                checkEdgeEv(med, sqrdTime, isect1, true);
+                checkEdgeEv(med, sqrdTime, isect1, false);
+            } else {
+                checkEdgeEv(med, sqrdTime, isect1, bCheckNeighbors.second);
+            }
+
+            checkEdgeEv(low, sqrdTime, isect1, bLeft3);
+
+            if (bIsWfVert2 && bIsWfVert3) {
+                isect1->setIsWfVert(sqrdTime, true);
+                isect2->setIsWfVert(sqrdTime, false);
+                isect3->setIsWfVert(sqrdTime, false);
+                cnt(m_nVorVerts)++;
+            } else if (bIsWfVert2 && !bIsWfVert3) {
+                isect1->setIsWfVert(sqrdTime, true);
+                isect2->setIsWfVert(sqrdTime, false);
+                isect3->setIsWfVert(sqrdTime, true);
+                cnt(m_nVorVerts)++;
+            } else if (!bIsWfVert2 && !bIsWfVert3) {
+                isect1->setIsWfVert(sqrdTime, false);
+                //isect2->setIsWfVert(sqrdTime, false);
+                //isect3->setIsWfVert(sqrdTime, false);
+            }
+
+            stampSwitches(edgeEv, {isect1, isect2, isect3});
+        } else if (*site1 < *site2 && *site1 < *site3) {
+#ifdef ENABLE_LOGGING
+            BOOST_LOG_SEV(slg, normal) << "Arc vanished along the lowest weighted site.";
+#endif
+            /*std::vector<SitePtr> sites{site1, site2, site3};
+            std::sort(
+                      sites.begin(),
+                      sites.end(),
+                      [](const SitePtr &lhs, const SitePtr & rhs) {
+                          return lhs->weight() < rhs->weight();
+                      }
+                      );
+
+            const auto lowSite = sites.at(0), medSite = sites.at(1),
+                    highSite = sites.at(2);
+
+            if (!deleteLowestArc(edgeEv, lowSite, medSite, highSite)) {
+                return;
+            }*/
+#ifdef ENABLE_LOGGING
+            BOOST_LOG_SEV(slg, error) << "twins.size() != 2 at time " 
+                    << std::sqrt(CGAL::to_double(sqrdTime)) << "!\n";
+            BOOST_LOG_SEV(slg, error) << "Lowest edge vanished without twin event!\n";
+#ifndef NDEBUG
+            CGAL_assertion(false);
+#endif
+#endif
+        } else { // The edge that is associated with the medium weight vanished.
+#ifdef ENABLE_LOGGING
+            BOOST_LOG_SEV(slg, normal) << "Arc vanished along the medium weighted site.";
+#endif
+            const auto lowSite = *site2 < *site3 ? site2 : site3,
+                    highSite = *site2 < *site3 ? site3 : site2;
+            
+            const auto &isect1 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, site1),
+                    &isect2 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, highSite),
+                    &isect3 = makeMovIsectAt(edgeEv->arcPnt(), site1, highSite);
+
+            if (!isect1 || !isect2 || !isect3) {
+                return;
+            }
+            
+            const auto low = m_offCircs.at(lowSite->id()),
+                    med = m_offCircs.at(site1->id()),
+                    high = m_offCircs.at(highSite->id());
+
+            if (!low->inclsIsect(isect1) || !med->inclsIsect(isect1)
+                || !med->inclsIsect(isect3) || !high->inclsIsect(isect3)) {
+#ifdef ENABLE_LOGGING
+                BOOST_LOG_SEV(slg, warning) << "Invalid edge event found!";
+#endif
+                cnt(m_invalidEdgeEvCnt)++;
+                return;
+            }
+
+            bool bIsWfVert1 = isect1->isWfVert(), bIsWfVert3 = isect3->isWfVert();
+            const auto &bCheckNeighbors = high->expandIsect(sqrdTime, edgeEv->arcPnt(),
+                                                            isect3, isect2,
+                                                            bIsWfVert1 && !bIsWfVert3);
+            bool bLeft2 = med->collapseArc(sqrdTime, isect1, isect3),
+                    bLeft3 = low->replaceIsect(sqrdTime, isect1, isect2);
+
+            if (bCheckNeighbors.first) {
+                checkEdgeEv(high, sqrdTime, isect2, true);
+                checkEdgeEv(high, sqrdTime, isect2, false);
+            } else {
+                checkEdgeEv(high, sqrdTime, isect2, bCheckNeighbors.second);
+            }
+
+            checkEdgeEv(med, sqrdTime, isect3, bLeft2);
+            checkEdgeEv(low, sqrdTime, isect2, bLeft3);
+
+            if (bIsWfVert1 && bIsWfVert3) {
+                isect1->setIsWfVert(sqrdTime, false);
+                isect2->setIsWfVert(sqrdTime, true);
+                isect3->setIsWfVert(sqrdTime, false);
+                cnt(m_nVorVerts)++;
+            } else if (bIsWfVert1 && !bIsWfVert3) {
+                isect1->setIsWfVert(sqrdTime, false);
+                isect2->setIsWfVert(sqrdTime, true);
+                isect3->setIsWfVert(sqrdTime, true);
+                cnt(m_nVorVerts)++;
+            } else if (!bIsWfVert1 && !bIsWfVert3) {
+                //isect1->setIsWfVert(sqrdTime, false);
+                isect2->setIsWfVert(sqrdTime, false);
+                //isect3->setIsWfVert(sqrdTime, false);
+            }
+
+            stampSwitches(edgeEv, {isect1, isect2, isect3});
+        }
+    }
+
+    storeEv(edgeEv);
 }
 
-void VorDiag::processEv(const std::shared_ptr<CollEv> &collEv, bool bDom,
-                        bool bIsValid, bool bPierces) {
+bool VorDiag::deleteLowestArc(const std::shared_ptr<EdgeEv> &edgeEv,
+                              const SitePtr &lowSite, const SitePtr &medSite,
+                              const SitePtr &highSite) {
 #ifdef ENABLE_LOGGING
-    BOOST_LOG_NAMED_SCOPE("processCollEv");
+    BOOST_LOG_NAMED_SCOPE("deleteLowestArc");
     src::severity_logger<severity_level> slg;
 #endif
+    const auto sqrdTime = edgeEv->sqrdTime();
+    const auto &isect1 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, medSite),
+            &isect2 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, highSite),
+            &isect3 = makeMovIsectAt(edgeEv->arcPnt(), medSite, highSite);
+
+    if (!isect1 || !isect2 || !isect3) {
+        return false;
+    }
     
-    const auto sqrdTime = collEv->sqrdTime();
-    const auto site = collEv->site();
-    const auto offCirc = m_offCircs.at(site->id());
-    const auto &isect1 = makeMovIsect(collEv->traj1()),
-            &isect2 = makeMovIsect(collEv->traj2());
-    
-    CGAL_assertion(collEv->traj1()->isLeft() && !collEv->traj2()->isLeft());
+    const auto low = m_offCircs.at(lowSite->id()),
+            med = m_offCircs.at(medSite->id()),
+            high = m_offCircs.at(highSite->id());
+
+    if (!low->inclsIsect(isect1) || !low->inclsIsect(isect2)
+        || !med->inclsIsect(isect1) || !med->inclsIsect(isect3)
+        || !high->inclsIsect(isect2) || !high->inclsIsect(isect3)) {
+#ifdef ENABLE_LOGGING
+        BOOST_LOG_SEV(slg, warning) << "Invalid edge event found!";
+#endif
+        cnt(m_invalidEdgeEvCnt)++;
+        return false;
+    }
+
+    bool bIsWfVert1 = isect1->isWfVert(), bIsWfVert2 = isect2->isWfVert(),
+            bIsWfVert3 = isect3->isWfVert();
+    bool bLeft1 = high->collapseArc(sqrdTime, isect2, isect3),
+            bLeft2 = med->collapseArc(sqrdTime, isect1, isect3);
+    std::pair<MovIsectPtr, MovIsectPtr> newArc;
+    low->deleteArcUnordered(newArc, sqrdTime, isect1, isect2, false);
+
+    checkEdgeEv(high, sqrdTime, isect3, bLeft1);
+    checkEdgeEv(med, sqrdTime, isect3, bLeft2);
+
+    if (bIsWfVert1 && bIsWfVert2 && bIsWfVert3) {
+        isect1->setIsWfVert(sqrdTime, false);
+        isect2->setIsWfVert(sqrdTime, false);
+        isect3->setIsWfVert(sqrdTime, false);
+    } else if (bIsWfVert1 && bIsWfVert2 && !bIsWfVert3) {
+        isect1->setIsWfVert(sqrdTime, false);
+        isect2->setIsWfVert(sqrdTime, false);
+        isect3->setIsWfVert(sqrdTime, true);
+        cnt(m_nVorVerts)++;
+    }
+
+    stampSwitches(edgeEv, {isect1, isect2, isect3});
+
+    return true;
+}
+
+SitePtr VorDiag::otherSite(const SitePtr &site, const MovIsectPtr &isect) const {
+    CGAL_assertion(isect->traj()->site1()->id() == site->id()
+           || isect->traj()->site2()->id() == site->id());
+    return isect->traj()->site1()->id() == site->id()
+            ? isect->traj()->site2() : isect->traj()->site1();
+}
 
-    if (bIsValid) {
+MovIsectPtr VorDiag::makeMovIsectAt(const Circular_arc_point_2 &pnt,
+                                    const SitePtr &site1, const SitePtr &site2) {
 #ifdef ENABLE_LOGGING
-        BOOST_LOG_SEV(slg, normal) << "Triggered valid collision event at time "
-                << std::sqrt(CGAL::to_double(sqrdTime))
-                << " along offset circle " << collEv->site()->id() << ".";
+    BOOST_LOG_NAMED_SCOPE("makeMovIsectAt");
+    src::severity_logger<severity_level> slg;
 #endif
+    const auto &bisecId = std::minmax({site1->id(), site2->id()});
     
-        offCirc->spawnArc(sqrdTime, isect1, isect2, bDom, bPierces);
-        checkEdgeEv(offCirc, sqrdTime, isect1, bPierces ? !bDom : bDom);
-        checkEdgeEv(offCirc, sqrdTime, isect2, bPierces ? bDom : !bDom);
-        storeEv(collEv);
-    } else {
+    if (m_bisecs.find(bisecId) != m_bisecs.end()) {
+        const auto bisec = m_bisecs.at(bisecId);
+        return makeMovIsect(bisec->findTraj(pnt));
+    }
+
 #ifdef ENABLE_LOGGING
-        BOOST_LOG_SEV(slg, normal) << "Ignored invalid collision event at time "
-                << std::sqrt(CGAL::to_double(sqrdTime))
-                << " along offset circle " << collEv->site()->id() << ".";
+    BOOST_LOG_SEV(slg, error) << "Bisector (" << bisecId.first << ", "
+            << bisecId.second << ") not found!";
 #endif
-        m_invalidCollEvCnt++;
+
+    return MovIsectPtr{};
+}
+
+MovIsectPtr VorDiag::makeMovIsect(const TrajPtr &traj) {
+    const auto &trajId = std::make_tuple(traj->id().first, traj->id().second,
+                                         traj->isLeft(), traj->isFirst());
+
+    // Groups of events that are handled speculatively touch disjoint moving
+    // intersections, but they share the map.
+    std::unique_lock<std::mutex> lock;
+    if (s_evLog) {
+        lock = std::unique_lock<std::mutex>{*s_evLog->isectMutex};
     }
 
-    m_queue.push(std::make_shared<DomEv>(isect1->traj()->end()->arcPnt(),
-                                         isect1->traj()->end()->sqrdTime(),
-                                         site, isect1, isect2));
+    auto it = m_isects.find(trajId);
+    if (it == m_isects.end()) {
+        it = m_isects.emplace(trajId, std::make_shared<MovIsect>(traj)).first;
+        if (s_evLog) {
+            s_evLog->newIsects.push_back(trajId);
+        }
+    }
+
+    return it->second;
+}
+
+void VorDiag::checkEdgeEv(const OffCircPtr &offCirc, const Root_of_2 &tNow,
+                          const MovIsectPtr &isect, bool bLeft) {
+    MovIsectPtr other;
+    bool bOk = offCirc->neighbor(other, isect, bLeft);
+
+    CGAL_assertion(bOk);
+    if (bOk) {
+        checkEdgeEv(offCirc, tNow, isect, other);
+    }
 }
 
-void VorDiag::handleEv(const std::shared_ptr<DomEv> &domEv1) {
+void VorDiag::checkEdgeEv(const OffCircPtr &offCirc, const Root_of_2 &sqrdTimeNow,
+                          const MovIsectPtr &isect, const MovIsectPtr &other) {
 #ifdef ENABLE_LOGGING
-    BOOST_LOG_NAMED_SCOPE("handleDomEv");
+    BOOST_LOG_NAMED_SCOPE("checkEdgeEv");
     src::severity_logger<severity_level> slg;
 #endif
+
+    auto temp = std::make_shared<TimePnt>(Point_2{},
+                                          Root_of_2{std::numeric_limits<double>::max()});
+    bool bIsValid = false;
+    std::vector<TimePntPtr> verts;
+    isect->traj()->isect(verts, other->traj());
+
+    for (const auto &vert : verts) {
+        if (vert->sqrdTime() < temp->sqrdTime()
+            && sqrdTimeNow < vert->sqrdTime()) {
+            temp = vert;
+            bIsValid = true;
+        }
+    }
     
-    const auto ev = m_queue.top();
-    m_queue.pop();
-    
-    CGAL_assertion(ev->type() == EvType::Dom);
-    if (ev->type() == EvType::Dom) {
-        const auto domEv2 = std::static_pointer_cast<DomEv>(ev);
-        //bool bDom = domEv1->site()->weight() > domEv2->site()->weight();
-        bool bDom = *domEv1->site() > *domEv2->site();
-    
-        CGAL_assertion(domEv1->sqrdTime() == domEv2->sqrdTime());
+    if (bIsValid) {
+        const auto &edgeEv = std::make_shared<EdgeEv>(temp->arcPnt(), temp->sqrdTime(), offCirc->site(), isect, other);
+        pushEv(edgeEv);
 
-        if (isValidDomEv(domEv1, domEv2)) {
-            processEv(domEv1, bDom);
-            processEv(domEv2, !bDom);
-        } else {
-            m_invalidDomEvCnt += 2;
+#ifdef ENABLE_LOGGING    
+        BOOST_LOG_SEV(slg, normal) << std::setprecision(30)
+                << "Inserting edge event at time "
+                << std::sqrt(CGAL::to_double(temp->sqrdTime())) << " at point ("
+                << CGAL::to_double(temp->arcPnt().x()) << ", "
+                << CGAL::to_double(temp->arcPnt().y()) << ") ... ";
+#endif
+    } else {
 #ifdef ENABLE_LOGGING
-            BOOST_LOG_SEV(slg, normal)
-                    << "Ignored two invalid domination events at time "
-                    << std::sqrt(CGAL::to_double(domEv1->sqrdTime()))
-                    << " along the offset circles "
-                    << domEv1->site()->id() << " and "
-                    << domEv2->site()->id() << ".";
+        BOOST_LOG_SEV(slg, normal) << std::setprecision(30) 
+                << "Invalid edge event at time "
+                << std::sqrt(CGAL::to_double(temp->sqrdTime())) << " at point ("
+                << CGAL::to_double(temp->arcPnt().x()) << ", "
+                << CGAL::to_double(temp->arcPnt().y()) << ") has been discarded ... ";
 #endif
+    }
+}
+
+// Events after the maximum time are never enqueued.
+void VorDiag::pushEv(const EvPtr &ev) {
+    if (!m_bIsBounded || ev->sqrdTime() <= m_maxSqrdTime) {
+        if (s_evLog) {
+            s_evLog->evs.push_back(ev);
+        } else {
+            m_queue.push(ev);
         }
     }
 }
 
-void VorDiag::processEv(const std::shared_ptr<DomEv> &domEv, bool bDom) {
-    const auto sqrdTime = domEv->sqrdTime();
-    const auto site = domEv->site();
-    const auto offCirc = m_offCircs.at(site->id());
-    const auto isect1 = domEv->isect1(), isect2 = domEv->isect2();
+// Returns true if the offset circles of both sites collide only after the
+// maximum time, i.e., if their distance exceeds the maximum time times the
+// sum of their weights.
+bool VorDiag::isBeyondMaxTime(const SitePtr &site1, const SitePtr &site2) const {
+    if (!m_bIsBounded) {
+        return false;
+    }
 
-#ifdef ENABLE_LOGGING
-    BOOST_LOG_NAMED_SCOPE("processDomEv");
-    src::severity_logger<severity_level> slg;
-    BOOST_LOG_SEV(slg, normal) << "Triggered valid domination event at time "
-            << std::sqrt(CGAL::to_double(sqrdTime))
-            << " along offset circle " << domEv->site()->id() << ".";
-#endif
+    const FT sqrdDist = CGAL::squared_distance(site1->center(), site2->center()),
+            sumWeight = site1->weight() + site2->weight();
+    return sqrdDist > m_maxSqrdTime * sumWeight * sumWeight;
+}
+
+void VorDiag::storeEv(const EvPtr &ev) {
+    switch(ev->type())
+    {
+        case EvType::Coll:
+        {
+            cnt(m_collEvCnt)++;
+            break;
+        }
+        case EvType::Dom:
+        {
+            cnt(m_domEvCnt)++;
+            break;
+        }
+        case EvType::Edge:
+        {
+            cnt(m_edgeEvCnt)++;
+            break;
+        }
+        case EvType::None:
+        default:
+        {
+            break;
+        }
+    };
     
-    std::pair<MovIsectPtr, MovIsectPtr> newArc;
-    bool bOk = offCirc->deleteArc(newArc, sqrdTime, isect1, isect2, bDom);
-    if (bOk) {
-        checkEdgeEv(offCirc, sqrdTime, newArc.first, newArc.second);
+#ifdef ENABLE_VIEW
+    m_evs.push_back(ev);
+#endif
+}
+
+// Assigns the Voronoi vertex at the point of the given event to the
+// switches of the moving intersections that have been caused by the event.
+// While a group of events is handled speculatively, the switches are stamped
+// with a provisional id that is replaced when the group is committed.
+void VorDiag::stampSwitches(const EvPtr &ev,
+                            std::initializer_list<MovIsectPtr> isects) {
+    bool bIsStamped = false;
+    int vertId = -1;
+
+    for (const auto &isect : isects) {
+        if (!isect->hasUnstampedSwitch()) {
+            continue;
+        }
+
+        if (!bIsStamped) {
+            if (s_evLog) {
+                vertId = PROVISIONAL_VERT - static_cast<int>(s_evLog->stamps.size());
+                s_evLog->stamps.push_back({ev, {}});
+            } else {
+                vertId = vertAt(ev);
+            }
+
+            bIsStamped = true;
+        }
+
+        isect->stampSwitches(vertId);
+        if (s_evLog) {
+            s_evLog->stamps.back().second.push_back(isect);
+        }
     }
+}
 
-    storeEv(domEv);
+// Returns the id of the Voronoi vertex at the point of the given event.
+// Consecutive events at the same point and time share their vertex.
+int VorDiag::vertAt(const EvPtr &ev) {
+    if (m_vorVerts.empty() || m_vorVerts.back().sqrdTime != ev->sqrdTime()
+        || m_vorVerts.back().pnt != ev->arcPnt()) {
+        m_vorVerts.push_back(VorVert{ev->arcPnt(), ev->sqrdTime()});
+    }
+
+    return static_cast<int>(m_vorVerts.size()) - 1;
 }
 
-void VorDiag::handleEv(const std::shared_ptr<EdgeEv> &edgeEv) {
-    const auto sqrdTime = edgeEv->sqrdTime();
-    const auto site1 = edgeEv->site(),
-            &site2 = otherSite(site1, edgeEv->isect1()),
-            &site3 = otherSite(site1, edgeEv->isect2());
+bool VorDiag::hasEqualWeights() const {
+    return m_sites.size() > 1
+            && std::all_of(m_sites.begin(), m_sites.end(), [this](const SitePtr &site) {
+                   return site->weight() == m_sites.front()->weight();
+               });
+}
 
-#ifdef ENABLE_LOGGING
-    BOOST_LOG_NAMED_SCOPE("handleEdgeEv");
-    src::severity_logger<severity_level> slg;
-    BOOST_LOG_SEV(slg, normal) << "Triggered edge event at time "
-            << std::sqrt(CGAL::to_double(sqrdTime))
-            << " involving the sites "
-            << site1->id() << " (with weight " << site1->weight() << "), "
-            << site2->id() << " (with weight " << site2->weight() << "), "
-            << site3->id() << " (with weight " << site3->weight() << ").";
-#endif
+// Computes the diagram of sites with equal weights, which is the ordinary
+// Voronoi diagram, as the dual of their Delaunay triangulation. The vertices
+// are the distinct circumcenters of the finite faces, and every edge of the
+// triangulation yields a piece of the bisector line of its sites. Like the
+// sweep, which extracts the unbounded edges only up to the time of the clip
+// box, the unbounded edges (and the whole lines of collinear sites) are kept
+// only with a clip box, to which they are clipped. They end at a far point
+// (at coordinates around 1e12, like the trajectories of BisecPntPnt).
+// Duplicate sites are not passed to the triangulation (see VorDiag()).
+void VorDiag::compLinear() {
+    using Kernel = CGAL::Cartesian<FT>;
+    using Vb = CGAL::Triangulation_vertex_base_with_info_2<size_t, Kernel>;
+    using Tds = CGAL::Triangulation_data_structure_2<Vb>;
+    using DT = CGAL::Delaunay_triangulation_2<Kernel, Tds>;
 
-    std::set<int> ids;
-    ids.insert(edgeEv->site()->id());
-    std::vector<std::shared_ptr<EdgeEv>> twins;
-    auto nextEv = m_queue.top();
+    std::vector<std::pair<Kernel::Point_2, size_t>> pnts;
+    for (size_t i = 0; i < m_sites.size(); i++) {
+        const auto center = m_sites[i]->center();
+        pnts.emplace_back(Kernel::Point_2{center.x(), center.y()}, i);
+    }
 
-#ifdef ENABLE_LOGGING
-    if (edgeEv->arcPnt() == nextEv->arcPnt()) {
-        BOOST_LOG_SEV(slg, normal) << "The current event point equals the next event point.";
+    DT dt;
+    dt.insert(pnts.begin(), pnts.end());
+
+    const FT far{1e12};
+    const auto fFarPnt = [&far](const Point_2 &pnt, const FT &dx, const FT &dy) {
+        const auto scale = far / std::max(CGAL::abs(dx), CGAL::abs(dy));
+        return Point_2{pnt.x() + scale * dx, pnt.y() + scale * dy};
+    };
+
+    const auto fAddEdge = [this](size_t i, size_t j, const Point_2 &start,
+                                 const Point_2 &end, int vert1, int vert2) {
+        if (start != end) {
+            m_lineEdges.push_back(LineEdge{m_sites[i]->id(), m_sites[j]->id(),
+                                           Line_2{start, end}, Circular_arc_point_2{start},
+                                           Circular_arc_point_2{end}, vert1, vert2});
+        }
+    };
+
+    if (dt.dimension() < 2) {
+        if (!m_bIsBounded) {
+            return;
+        }
+
+        std::sort(pnts.begin(), pnts.end(), [](const std::pair<Kernel::Point_2, size_t> &lhs,
+                                               const std::pair<Kernel::Point_2, size_t> &rhs) {
+            return lhs.first < rhs.first;
+        });
+
+        for (size_t k = 0; k + 1 < pnts.size(); k++) {
+            const auto &p = pnts[k].first, &q = pnts[k + 1].first;
+            if (p == q) {
+                continue;
+            }
+
+            const auto mid = Point_2{(p.x() + q.x()) / 2, (p.y() + q.y()) / 2};
+            const FT dx = p.y() - q.y(), dy = q.x() - p.x();
+            fAddEdge(pnts[k].second, pnts[k + 1].second, fFarPnt(mid, -dx, -dy),
+                     fFarPnt(mid, dx, dy), -1, -1);
+        }
+
+        return;
     }
-#endif
-    while (typeid(*nextEv) == typeid(EdgeEv) && edgeEv->arcPnt() == nextEv->arcPnt()) {
-        const auto twin = std::static_pointer_cast<EdgeEv>(nextEv);
-        const auto offCirc = m_offCircs.at(nextEv->site()->id());
-        const auto isect1 = twin->isect1(), isect2 = twin->isect2();
 
-        if (ids.find(nextEv->site()->id()) == ids.end()
-            && offCirc->inclsIsect(isect1) && offCirc->inclsIsect(isect2)) {
-            twins.push_back(twin);
-            ids.insert(nextEv->site()->id());
+    // The faces of co-circular sites share their circumcenter, which is a
+    // single vertex of the diagram (and the edges between them vanish).
+    std::map<DT::Face_handle, std::pair<Point_2, int>> centers;
+    std::map<Point_2, int> vertIds;
+    for (auto fit = dt.finite_faces_begin(); fit != dt.finite_faces_end(); ++fit) {
+        const auto center = dt.circumcenter(fit);
+        const auto pnt = Point_2{center.x(), center.y()};
+        const auto it = vertIds.emplace(pnt, static_cast<int>(m_vorVerts.size()));
+        if (it.second) {
+            const auto arcPnt = Circular_arc_point_2{pnt};
+            m_vorVerts.push_back(VorVert{arcPnt,
+                                         m_sites[fit->vertex(0)->info()]->sqrdDist(arcPnt)});
+        }
 
-#ifdef ENABLE_LOGGING
-            BOOST_LOG_SEV(slg, normal) << "Found twin event at site "
-                    << nextEv->site()->id() << ".";
-#endif
-            m_edgeEvCnt++;
-        } else {
-#ifdef ENABLE_LOGGING
-            BOOST_LOG_SEV(slg, warning) << "Invalid edge event found!";
+        centers.emplace(fit, std::make_pair(pnt, it.first->second));
+    }
+
+    m_nVorVerts = static_cast<int>(m_vorVerts.size());
+
+    for (auto eit = dt.finite_edges_begin(); eit != dt.finite_edges_end(); ++eit) {
+        auto face = eit->first;
+        int i = eit->second;
+        auto other = face->neighbor(i);
+        if (dt.is_infinite(face)) {
+            std::swap(face, other);
+            i = dt.mirror_index(other, i);
+        }
+
+        // The third vertex of face lies to the left of the edge from a to b.
+        const auto a = face->vertex(face->ccw(i)), b = face->vertex(face->cw(i));
+        const auto &center = centers.at(face);
+        if (!dt.is_infinite(other)) {
+            const auto &otherCenter = centers.at(other);
+            fAddEdge(a->info(), b->info(), center.first, otherCenter.first,
+                     center.second, otherCenter.second);
+        } else if (m_bIsBounded) {
+            const auto &p = a->point(), &q = b->point();
+            fAddEdge(a->info(), b->info(), center.first,
+                     fFarPnt(center.first, q.y() - p.y(), p.x() - q.x()), center.second, -1);
+        }
+    }
+}
+
+// The number of moving intersections whose edges are extracted as one chunk
+// and the number of extracted chunks per thread that may wait to be written.
+const size_t EDGE_CHUNK = 256;
+const size_t PENDING_CHUNKS = 4;
+
+// Computes the Voronoi edges from the switches of the moving intersections.
+// The moving intersections are split into chunks, which are extracted by
+// nThreads threads in ascending order and written in this order as soon as
+// they are complete, hence the output is deterministic and at most
+// PENDING_CHUNKS * nThreads chunks are held in memory. Every edge is written
+// to binWriter (if given), and it is kept in memory only if bStoreEdges is
+// set.
+//
+// The threads share the exact numbers and points of the vertices, the
+// switches and the trajectories, which are reference counted handles of
+// CGAL. They only read and copy these handles, i.e., they never modify a
+// shared representation, and the reference counts are atomic if CGAL is
+// configured with CGAL_HAS_THREADS; otherwise, a single thread extracts the
+// edges.
+void VorDiag::compVorEdges(BinWriter *binWriter, bool bStoreEdges, size_t nThreads) {
+    // The moving intersections of a repaired diagram are gone, but its
+    // edges are kept up to date by the repairs.
+    CGAL_assertion(!m_bIsRepaired);
+    if (m_bIsRepaired) {
+        return;
+    }
+
+    // The writer forgets a vertex after its last edge.
+    const auto vertDegs = binWriter ? compVertDegs() : std::vector<size_t>{};
+    const auto fDeg = [&vertDegs](int vert) {
+        return vert >= 0 ? vertDegs.at(vert) : 0;
+    };
+
+    const auto fWrite = [&](EdgeBatch &batch) {
+        if (binWriter) {
+            for (const auto &edge : batch.binEdges) {
+                if (edge.bIsArc) {
+                    binWriter->addArc(edge.x1, edge.y1, edge.x2, edge.y2,
+                                      edge.site1, edge.site2, edge.cx, edge.cy, edge.r,
+                                      fDeg(edge.vert1), fDeg(edge.vert2));
+                } else {
+                    binWriter->addSeg(edge.x1, edge.y1, edge.x2, edge.y2,
+                                      edge.site1, edge.site2,
+                                      fDeg(edge.vert1), fDeg(edge.vert2));
+                }
+            }
+        }
+
+        if (bStoreEdges) {
+            m_vorEdges.insert(m_vorEdges.end(), batch.arcs.begin(), batch.arcs.end());
+            m_vorSegs.insert(m_vorSegs.end(), batch.segs.begin(), batch.segs.end());
+            m_vorEdgeInfos.insert(m_vorEdgeInfos.end(), batch.arcInfos.begin(),
+                                  batch.arcInfos.end());
+            m_vorSegInfos.insert(m_vorSegInfos.end(), batch.segInfos.begin(),
+                                 batch.segInfos.end());
+        }
+
+        batch = EdgeBatch{};
+    };
+
+    if (m_bIsLinear) {
+        EdgeBatch batch;
+        extractLineEdges(batch, binWriter != nullptr, bStoreEdges);
+        fWrite(batch);
+        return;
+    }
+
+    std::vector<MovIsectPtr> isects;
+    isects.reserve(m_isects.size());
+    for (const auto &val : m_isects) {
+        isects.push_back(val.second);
+    }
+
+    size_t nChunks = (isects.size() + EDGE_CHUNK - 1) / EDGE_CHUNK;
+#ifdef CGAL_HAS_THREADS
+    nThreads = std::max<size_t>(1, std::min(nThreads, nChunks));
+#else
+    nThreads = 1;
 #endif
-            m_invalidEdgeEvCnt++;
+
+    const auto fExtract = [&](EdgeBatch &batch, size_t chunk) {
+        size_t end = std::min(isects.size(), (chunk + 1) * EDGE_CHUNK);
+        for (size_t j = chunk * EDGE_CHUNK; j < end; j++) {
+            extractEdges(batch, isects.at(j), binWriter != nullptr, bStoreEdges);
+        }
+    };
+
+    if (nThreads == 1) {
+        EdgeBatch batch;
+        for (size_t chunk = 0; chunk < nChunks; chunk++) {
+            fExtract(batch, chunk);
+            fWrite(batch);
+        }
+
+        return;
+    }
+
+    std::vector<EdgeBatch> batches(nChunks);
+    std::vector<char> done(nChunks, 0);
+    size_t next = 0, written = 0;
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    boost::thread_group threads;
+    for (size_t i = 0; i < nThreads; i++) {
+        threads.create_thread([&]() {
+            std::unique_lock<std::mutex> lock{mutex};
+            while (true) {
+                cond.wait(lock, [&]() {
+                    return next == nChunks || next < written + PENDING_CHUNKS * nThreads;
+                });
+                if (next == nChunks) {
+                    return;
+                }
+
+                size_t chunk = next++;
+                lock.unlock();
+                fExtract(batches.at(chunk), chunk);
+                lock.lock();
+                done.at(chunk) = 1;
+                cond.notify_all();
+            }
+        });
+    }
+
+    for (size_t chunk = 0; chunk < nChunks; chunk++) {
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            cond.wait(lock, [&]() {
+                return done.at(chunk) != 0;
+            });
+        }
+
+        fWrite(batches.at(chunk));
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            written++;
         }
-        
-        m_queue.pop();
-        nextEv = m_queue.top();
-    }
 
-    if (!twins.empty()) {
-#ifdef ENABLE_LOGGING
-        BOOST_LOG_SEV(slg, normal) << "Three arcs vanished simultaneously.";
-#endif
-        SitePtr lowSite, medSite, highSite;
-        if (twins.size() != 2) {
-#ifdef ENABLE_LOGGING
-            BOOST_LOG_SEV(slg, warning) << "Number of twin events does not equal two!";
-#endif
-            std::vector<SitePtr> sites{site1, site2, site3};
-            std::sort(sites.begin(), sites.end(),
-                      [](const SitePtr &lhs, const SitePtr & rhs) {
-                          //return lhs->weight() < rhs->weight();
-                          return *lhs < *rhs;
-                      }
-                      );
+        cond.notify_all();
+    }
 
-            lowSite = sites.at(0);
-            medSite = sites.at(1);
-            highSite = sites.at(2);
-        } else {
-            twins.push_back(edgeEv);
-            std::sort(twins.begin(), twins.end(),
-                      [](const std::shared_ptr<EdgeEv> &lhs,
-                         const std::shared_ptr<EdgeEv> & rhs) {
-                          //return lhs->site()->weight() < rhs->site()->weight();
-                          return *lhs->site() < *rhs->site();
-                      }
-                      );
+    threads.join_all();
+}
 
-            lowSite = twins.at(0)->site();
-            medSite = twins.at(1)->site();
-            highSite = twins.at(2)->site();
+// Returns the numbers of edges at the vertices as extracted by
+// extractEdges() or extractLineEdges(), where the edges that are clipped
+// away still count (i.e., a vertex on a side of the clip box may be kept
+// longer by a BinWriter, but never dropped too early).
+std::vector<size_t> VorDiag::compVertDegs() const {
+    std::vector<size_t> degs(m_vorVerts.size(), 0);
+    const auto fCnt = [&degs](int vert) {
+        if (vert >= 0) {
+            degs.at(vert)++;
         }
+    };
 
-        if (!deleteLowestArc(edgeEv, lowSite, medSite, highSite)) {
-            return;
+    if (m_bIsLinear) {
+        for (const auto &edge : m_lineEdges) {
+            fCnt(edge.vert1);
+            fCnt(edge.vert2);
         }
-    } else {
-        if (*site1 > *site2 && *site1 > *site3) {
-#ifdef ENABLE_LOGGING
-            BOOST_LOG_SEV(slg, normal) << "Arc vanished along the highest weighted site.";
-#endif
-            const auto lowSite = *site2 < *site3 ? site2 : site3,
-                    medSite = *site2 < *site3 ? site3 : site2;
 
-            const auto &isect1 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, medSite),
-                    &isect2 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, site1),
-                    &isect3 = makeMovIsectAt(edgeEv->arcPnt(), medSite, site1);
+        return degs;
+    }
 
-            if (!isect1 || !isect2 || !isect3) {
-                return;
+    for (const auto &val : m_isects) {
+        const auto &isect = val.second;
+        const auto &switches = isect->switches();
+        const auto &switchVerts = isect->switchVerts();
+        for (const auto &trajSec : isect->traj()->secs()) {
+            if (typeid(*trajSec) != typeid(TrajSecPntPnt)) {
+                continue;
             }
-            
-            const auto low = m_offCircs.at(lowSite->id()),
-                    med = m_offCircs.at(medSite->id()),
-                    high = m_offCircs.at(site1->id());
 
-            if (!low->inclsIsect(isect2) || !med->inclsIsect(isect3)
-                || !high->inclsIsect(isect2) || !high->inclsIsect(isect3)) {
-#ifdef ENABLE_LOGGING
-                BOOST_LOG_SEV(slg, warning) << "Invalid edge event found!";
-#endif
-                m_invalidEdgeEvCnt++;
-                return;
+            for (size_t i = 0; i + 1 < switches.size(); i++) {
+                if (switches.at(i).second && switches.at(i).first != switches.at(i + 1).first) {
+                    fCnt(switchVerts.at(i));
+                    fCnt(switchVerts.at(i + 1));
+                }
             }
 
-            bool bIsWfVert2 = isect2->isWfVert(),
-                    bIsWfVert3 = isect3->isWfVert();
-            const auto bCheckNeighbors = med->expandIsect(sqrdTime, edgeEv->arcPnt(),
-                                                          isect3, isect1,
-                                                          bIsWfVert2 && !bIsWfVert3);
-            bool bLeft1 = high->collapseArc(sqrdTime, isect2, isect3),
-                    bLeft3 = low->replaceIsect(sqrdTime, isect2, isect1);
+            if (m_bIsBounded && !switches.empty() && switches.back().second
+                    && switches.back().first < std::min(m_maxSqrdTime,
+                                                        isect->traj()->end()->sqrdTime())) {
+                fCnt(switchVerts.back());
+            }
+        }
+    }
 
-            checkEdgeEv(high, sqrdTime, isect3, bLeft1);
+    return degs;
+}
 
-            if (bCheckNeighbors.first) {
-                checkEdgeEv(med, sqrdTime, isect1, true);
-                checkEdgeEv(med, sqrdTime, isect1, false);
-            } else {
-                checkEdgeEv(med, sqrdTime, isect1, bCheckNeighbors.second);
+// Appends the Voronoi edges traced by the given moving intersection to the
+// batch. The end points of the edges are the vertices at which the switches
+// took place, i.e., they are only recomputed if a switch is not stamped.
+void VorDiag::extractEdges(EdgeBatch &batch, const MovIsectPtr &isect,
+                           bool bBin, bool bStoreEdges) const {
+    const auto &switches = isect->switches();
+    const auto &switchVerts = isect->switchVerts();
+    bool bIsLeft = isect->traj()->isLeft();
+    int site1 = isect->traj()->site1()->id(),
+            site2 = isect->traj()->site2()->id();
+
+    const auto fPntAt = [&](size_t i) {
+        return switchVerts.at(i) >= 0 ? m_vorVerts.at(switchVerts.at(i)).pnt
+                : isect->pntAt(switches.at(i).first);
+    };
+
+    for (const auto &trajSec : isect->traj()->secs()) {
+        if (typeid(*trajSec) != typeid(TrajSecPntPnt)) {
+            continue;
+        }
+
+        const auto tspp = std::static_pointer_cast<TrajSecPntPnt>(trajSec);
+
+        const auto fAddArc = [&](const Circle_2 &circ, const Circular_arc_point_2 &source,
+                                 const Circular_arc_point_2 &target, int vert1, int vert2) {
+            if (bBin) {
+                batch.binEdges.push_back(BinEdge{true,
+                        CGAL::to_double(source.x()), CGAL::to_double(source.y()),
+                        CGAL::to_double(target.x()), CGAL::to_double(target.y()),
+                        site1, site2,
+                        CGAL::to_double(circ.center().x()),
+                        CGAL::to_double(circ.center().y()),
+                        std::sqrt(CGAL::to_double(circ.squared_radius())), vert1, vert2});
             }
 
-            checkEdgeEv(low, sqrdTime, isect1, bLeft3);
+            if (bStoreEdges) {
+                batch.arcs.push_back(Circular_arc_2{circ, source, target});
+                batch.arcInfos.push_back(EdgeInfo{site1, site2, vert1, vert2});
+            }
+        };
 
-            if (bIsWfVert2 && bIsWfVert3) {
-                isect1->setIsWfVert(sqrdTime, true);
-                isect2->setIsWfVert(sqrdTime, false);
-                isect3->setIsWfVert(sqrdTime, false);
-                m_nVorVerts++;
-            } else if (bIsWfVert2 && !bIsWfVert3) {
-                isect1->setIsWfVert(sqrdTime, true);
-                isect2->setIsWfVert(sqrdTime, false);
-                isect3->setIsWfVert(sqrdTime, true);
-                m_nVorVerts++;
-            } else if (!bIsWfVert2 && !bIsWfVert3) {
-                isect1->setIsWfVert(sqrdTime, false);
-                //isect2->setIsWfVert(sqrdTime, false);
-                //isect3->setIsWfVert(sqrdTime, false);
+        const auto fAddSeg = [&](const Line_2 &line, const Circular_arc_point_2 &start,
+                                 const Circular_arc_point_2 &end, int vert1, int vert2) {
+            if (bBin) {
+                batch.binEdges.push_back(BinEdge{false,
+                        CGAL::to_double(start.x()), CGAL::to_double(start.y()),
+                        CGAL::to_double(end.x()), CGAL::to_double(end.y()),
+                        site1, site2, 0., 0., 0., vert1, vert2});
             }
-        } else if (*site1 < *site2 && *site1 < *site3) {
-#ifdef ENABLE_LOGGING
-            BOOST_LOG_SEV(slg, normal) << "Arc vanished along the lowest weighted site.";
-#endif
-            /*std::vector<SitePtr> sites{site1, site2, site3};
-            std::sort(
-                      sites.begin(),
-                      sites.end(),
-                      [](const SitePtr &lhs, const SitePtr & rhs) {
-                          return lhs->weight() < rhs->weight();
-                      }
-                      );
 
-            const auto lowSite = sites.at(0), medSite = sites.at(1),
-                    highSite = sites.at(2);
+            if (bStoreEdges) {
+                batch.segs.push_back(Line_arc_2{line, start, end});
+                batch.segInfos.push_back(EdgeInfo{site1, site2, vert1, vert2});
+            }
+        };
 
-            if (!deleteLowestArc(edgeEv, lowSite, medSite, highSite)) {
-                return;
-            }*/
-#ifdef ENABLE_LOGGING
-            BOOST_LOG_SEV(slg, error) << "twins.size() != 2 at time " 
-                    << std::sqrt(CGAL::to_double(sqrdTime)) << "!\n";
-            BOOST_LOG_SEV(slg, error) << "Lowest edge vanished without twin event!\n";
-#ifndef NDEBUG
-            CGAL_assertion(false);
-#endif
-#endif
-        } else { // The edge that is associated with the medium weight vanished.
-#ifdef ENABLE_LOGGING
-            BOOST_LOG_SEV(slg, normal) << "Arc vanished along the medium weighted site.";
-#endif
-            const auto lowSite = *site2 < *site3 ? site2 : site3,
-                    highSite = *site2 < *site3 ? site3 : site2;
-            
-            const auto &isect1 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, site1),
-                    &isect2 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, highSite),
-                    &isect3 = makeMovIsectAt(edgeEv->arcPnt(), site1, highSite);
+        // The pieces of a clipped edge keep the vertices at their ends
+        // within the box.
+        const auto fAddEdge = [&](const Circular_arc_point_2 &start,
+                                  const Circular_arc_point_2 &end, int startVert, int endVert) {
+            if (!tspp->isEqual()) {
+                const auto &circ = tspp->arc().supporting_circle();
+                const auto &source = bIsLeft ? start : end,
+                        &target = bIsLeft ? end : start;
+                int sourceVert = bIsLeft ? startVert : endVert,
+                        targetVert = bIsLeft ? endVert : startVert;
 
-            if (!isect1 || !isect2 || !isect3) {
-                return;
+                if (!m_bClip) {
+                    fAddArc(circ, source, target, sourceVert, targetVert);
+                } else {
+                    for (const auto &piece : clipArc(circ, source, target,
+                                                     m_clipBox, m_clipLines)) {
+                        fAddArc(circ, piece.first, piece.second,
+                                piece.first == source ? sourceVert : -1,
+                                piece.second == target ? targetVert : -1);
+                    }
+                }
+            } else {
+                const auto &line = tspp->seg().supporting_line();
+
+                if (!m_bClip) {
+                    fAddSeg(line, start, end, startVert, endVert);
+                } else {
+                    for (const auto &piece : clipSeg(line, start, end,
+                                                     m_clipBox, m_clipLines)) {
+                        fAddSeg(line, piece.first, piece.second,
+                                piece.first == start ? startVert : -1,
+                                piece.second == end ? endVert : -1);
+                    }
+                }
             }
-            
-            const auto low = m_offCircs.at(lowSite->id()),
-                    med = m_offCircs.at(site1->id()),
-                    high = m_offCircs.at(highSite->id());
+        };
 
-            if (!low->inclsIsect(isect1) || !med->inclsIsect(isect1)
-                || !med->inclsIsect(isect3) || !high->inclsIsect(isect3)) {
-#ifdef ENABLE_LOGGING
-                BOOST_LOG_SEV(slg, warning) << "Invalid edge event found!";
-#endif
-                m_invalidEdgeEvCnt++;
-                return;
+        for (size_t i = 0; i + 1 < switches.size(); i++) {
+            const auto &t1 = switches.at(i).first, &t2 = switches.at(i + 1).first;
+            bool bIsWfEdge = switches.at(i).second;
+
+            if (!bIsWfEdge || t1 == t2) {
+                continue;
             }
 
-            bool bIsWfVert1 = isect1->isWfVert(), bIsWfVert3 = isect3->isWfVert();
-            const auto &bCheckNeighbors = high->expandIsect(sqrdTime, edgeEv->arcPnt(),
-                                                            isect3, isect2,
-                                                            bIsWfVert1 && !bIsWfVert3);
-            bool bLeft2 = med->collapseArc(sqrdTime, isect1, isect3),
-                    bLeft3 = low->replaceIsect(sqrdTime, isect1, isect2);
+            fAddEdge(fPntAt(i), fPntAt(i + 1), switchVerts.at(i), switchVerts.at(i + 1));
+        }
 
-            if (bCheckNeighbors.first) {
-                checkEdgeEv(high, sqrdTime, isect2, true);
-                checkEdgeEv(high, sqrdTime, isect2, false);
-            } else {
-                checkEdgeEv(high, sqrdTime, isect2, bCheckNeighbors.second);
+        // If the sweep was stopped at the maximum time, then edges that are
+        // still traced by the wavefront end at the maximum time (or at the end
+        // of their trajectory).
+        if (m_bIsBounded && !switches.empty() && switches.back().second) {
+            const auto tEnd = std::min(m_maxSqrdTime, isect->traj()->end()->sqrdTime());
+            if (switches.back().first < tEnd) {
+                fAddEdge(fPntAt(switches.size() - 1), isect->pntAt(tEnd),
+                         switchVerts.back(), -1);
             }
+        }
+    }
+}
 
-            checkEdgeEv(med, sqrdTime, isect3, bLeft2);
-            checkEdgeEv(low, sqrdTime, isect2, bLeft3);
+// Appends the edges computed by compLinear() to the batch, clipped to the
+// clip box (if any).
+void VorDiag::extractLineEdges(EdgeBatch &batch, bool bBin, bool bStoreEdges) const {
+    const auto fAddSeg = [&](const LineEdge &edge, const Circular_arc_point_2 &start,
+                             const Circular_arc_point_2 &end) {
+        int vert1 = start == edge.start ? edge.vert1 : -1,
+                vert2 = end == edge.end ? edge.vert2 : -1;
+        if (bBin) {
+            batch.binEdges.push_back(BinEdge{false,
+                    CGAL::to_double(start.x()), CGAL::to_double(start.y()),
+                    CGAL::to_double(end.x()), CGAL::to_double(end.y()),
+                    edge.site1, edge.site2, 0., 0., 0., vert1, vert2});
+        }
 
-            if (bIsWfVert1 && bIsWfVert3) {
-                isect1->setIsWfVert(sqrdTime, false);
-                isect2->setIsWfVert(sqrdTime, true);
-                isect3->setIsWfVert(sqrdTime, false);
-                m_nVorVerts++;
-            } else if (bIsWfVert1 && !bIsWfVert3) {
-                isect1->setIsWfVert(sqrdTime, false);
-                isect2->setIsWfVert(sqrdTime, true);
-                isect3->setIsWfVert(sqrdTime, true);
-                m_nVorVerts++;
-            } else if (!bIsWfVert1 && !bIsWfVert3) {
-                //isect1->setIsWfVert(sqrdTime, false);
-                isect2->setIsWfVert(sqrdTime, false);
-                //isect3->setIsWfVert(sqrdTime, false);
+        if (bStoreEdges) {
+            batch.segs.push_back(Line_arc_2{edge.line, start, end});
+            batch.segInfos.push_back(EdgeInfo{edge.site1, edge.site2, vert1, vert2});
+        }
+    };
+
+    for (const auto &edge : m_lineEdges) {
+        if (!m_bClip) {
+            fAddSeg(edge, edge.start, edge.end);
+        } else {
+            for (const auto &piece : clipSeg(edge.line, edge.start, edge.end,
+                                             m_clipBox, m_clipLines)) {
+                fAddSeg(edge, piece.first, piece.second);
             }
         }
     }
+}
 
-    storeEv(edgeEv);
+// Points on the boundary of the box (up to rounding) belong to the box.
+static bool isInBox(const CGAL::Bbox_2 &box, double x, double y) {
+    double eps = 1e-9 * std::max(box.xmax() - box.xmin(), box.ymax() - box.ymin());
+    return x >= box.xmin() - eps && x <= box.xmax() + eps
+            && y >= box.ymin() - eps && y <= box.ymax() + eps;
 }
 
-bool VorDiag::deleteLowestArc(const std::shared_ptr<EdgeEv> &edgeEv,
-                              const SitePtr &lowSite, const SitePtr &medSite,
-                              const SitePtr &highSite) {
-#ifdef ENABLE_LOGGING
-    BOOST_LOG_NAMED_SCOPE("deleteLowestArc");
-    src::severity_logger<severity_level> slg;
-#endif
-    const auto sqrdTime = edgeEv->sqrdTime();
-    const auto &isect1 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, medSite),
-            &isect2 = makeMovIsectAt(edgeEv->arcPnt(), lowSite, highSite),
-            &isect3 = makeMovIsectAt(edgeEv->arcPnt(), medSite, highSite);
+// Splits the arc at its intersections with the lines through the sides of
+// the box and returns the pieces inside (or outside) of the box. Each piece
+// is classified by its midpoint, which is computed with doubles only.
+std::vector<std::pair<Circular_arc_point_2, Circular_arc_point_2>>
+VorDiag::clipArc(const Circle_2 &circ, const Circular_arc_point_2 &source,
+                 const Circular_arc_point_2 &target, const CGAL::Bbox_2 &box,
+                 const std::vector<Line_2> &sides, bool bInside) const {
+    using IsectResult = CGAL::CK2_Intersection_traits<CK, Circular_arc_2, Line_2>::type;
+    using Isect = std::pair<Circular_arc_point_2, unsigned int>;
+    std::vector<IsectResult> results;
+    const auto arc = Circular_arc_2{circ, source, target};
+    for (const auto &side : sides) {
+        CGAL::intersection(arc, side, std::back_inserter(results));
+    }
 
-    if (!isect1 || !isect2 || !isect3) {
-        return false;
+    double cx = CGAL::to_double(circ.center().x()), cy = CGAL::to_double(circ.center().y()),
+            r = std::sqrt(CGAL::to_double(circ.squared_radius()));
+    const auto fAngle = [&](const Circular_arc_point_2 &pnt) {
+        return std::atan2(CGAL::to_double(pnt.y()) - cy, CGAL::to_double(pnt.x()) - cx);
+    };
+
+    // The angles are measured counterclockwise from the source.
+    double start = fAngle(source), span = fAngle(target) - start;
+    if (span <= 0.) {
+        span += 2 * M_PI;
     }
-    
-    const auto low = m_offCircs.at(lowSite->id()),
-            med = m_offCircs.at(medSite->id()),
-            high = m_offCircs.at(highSite->id());
 
-    if (!low->inclsIsect(isect1) || !low->inclsIsect(isect2)
-        || !med->inclsIsect(isect1) || !med->inclsIsect(isect3)
-        || !high->inclsIsect(isect2) || !high->inclsIsect(isect3)) {
-#ifdef ENABLE_LOGGING
-        BOOST_LOG_SEV(slg, warning) << "Invalid edge event found!";
-#endif
-        m_invalidEdgeEvCnt++;
-        return false;
+    std::vector<std::pair<double, Circular_arc_point_2>> pnts{{0., source}, {span, target}};
+    for (const auto &result : results) {
+        const auto *isect = boost::get<Isect>(&result);
+        if (isect && isect->first != source && isect->first != target) {
+            double angle = fAngle(isect->first) - start;
+            if (angle < 0.) {
+                angle += 2 * M_PI;
+            }
+
+            pnts.emplace_back(std::min(angle, span), isect->first);
+        }
     }
 
-    bool bIsWfVert1 = isect1->isWfVert(), bIsWfVert2 = isect2->isWfVert(),
-            bIsWfVert3 = isect3->isWfVert();
-    bool bLeft1 = high->collapseArc(sqrdTime, isect2, isect3),
-            bLeft2 = med->collapseArc(sqrdTime, isect1, isect3);
-    std::pair<MovIsectPtr, MovIsectPtr> newArc;
-    low->deleteArcUnordered(newArc, sqrdTime, isect1, isect2, false);
+    std::sort(pnts.begin(), pnts.end(),
+              [](const std::pair<double, Circular_arc_point_2> &lhs,
+                 const std::pair<double, Circular_arc_point_2> &rhs) {
+                  return lhs.first < rhs.first;
+              });
 
-    checkEdgeEv(high, sqrdTime, isect3, bLeft1);
-    checkEdgeEv(med, sqrdTime, isect3, bLeft2);
+    std::vector<std::pair<Circular_arc_point_2, Circular_arc_point_2>> res;
+    for (size_t i = 0; i + 1 < pnts.size(); i++) {
+        if (pnts.at(i).second == pnts.at(i + 1).second) {
+            continue;
+        }
 
-    if (bIsWfVert1 && bIsWfVert2 && bIsWfVert3) {
-        isect1->setIsWfVert(sqrdTime, false);
-        isect2->setIsWfVert(sqrdTime, false);
-        isect3->setIsWfVert(sqrdTime, false);
-    } else if (bIsWfVert1 && bIsWfVert2 && !bIsWfVert3) {
-        isect1->setIsWfVert(sqrdTime, false);
-        isect2->setIsWfVert(sqrdTime, false);
-        isect3->setIsWfVert(sqrdTime, true);
-        m_nVorVerts++;
+        double mid = start + (pnts.at(i).first + pnts.at(i + 1).first) / 2.;
+        if (isInBox(box, cx + r * std::cos(mid), cy + r * std::sin(mid)) == bInside) {
+            if (!res.empty() && res.back().second == pnts.at(i).second) {
+                res.back().second = pnts.at(i + 1).second;
+            } else {
+                res.emplace_back(pnts.at(i).second, pnts.at(i + 1).second);
+            }
+        }
+    }
+
+    return res;
+}
+
+std::vector<std::pair<Circular_arc_point_2, Circular_arc_point_2>>
+VorDiag::clipSeg(const Line_2 &line, const Circular_arc_point_2 &start,
+                 const Circular_arc_point_2 &end, const CGAL::Bbox_2 &box,
+                 const std::vector<Line_2> &sides, bool bInside) const {
+    using IsectResult = CGAL::CK2_Intersection_traits<CK, Line_arc_2, Line_2>::type;
+    using Isect = std::pair<Circular_arc_point_2, unsigned int>;
+    std::vector<IsectResult> results;
+    const auto seg = Line_arc_2{line, start, end};
+    for (const auto &side : sides) {
+        CGAL::intersection(seg, side, std::back_inserter(results));
+    }
+
+    double x1 = CGAL::to_double(start.x()), y1 = CGAL::to_double(start.y()),
+            dx = CGAL::to_double(end.x()) - x1, dy = CGAL::to_double(end.y()) - y1,
+            sqrdLen = dx * dx + dy * dy;
+    const auto fParam = [&](const Circular_arc_point_2 &pnt) {
+        return sqrdLen > 0. ? ((CGAL::to_double(pnt.x()) - x1) * dx
+                               + (CGAL::to_double(pnt.y()) - y1) * dy) / sqrdLen : 0.;
+    };
+
+    // Overlaps with the lines (i.e., segments on the boundary of the box)
+    // yield no points and are kept as a whole.
+    std::vector<std::pair<double, Circular_arc_point_2>> pnts{{0., start}, {1., end}};
+    for (const auto &result : results) {
+        const auto *isect = boost::get<Isect>(&result);
+        if (isect && isect->first != start && isect->first != end) {
+            pnts.emplace_back(std::max(0., std::min(fParam(isect->first), 1.)), isect->first);
+        }
     }
 
-    return true;
-}
+    std::sort(pnts.begin(), pnts.end(),
+              [](const std::pair<double, Circular_arc_point_2> &lhs,
+                 const std::pair<double, Circular_arc_point_2> &rhs) {
+                  return lhs.first < rhs.first;
+              });
 
-SitePtr VorDiag::otherSite(const SitePtr &site, const MovIsectPtr &isect) const {
-    CGAL_assertion(isect->traj()->site1()->id() == site->id()
-           || isect->traj()->site2()->id() == site->id());
-    return isect->traj()->site1()->id() == site->id()
-            ? isect->traj()->site2() : isect->traj()->site1();
+    std::vector<std::pair<Circular_arc_point_2, Circular_arc_point_2>> res;
+    for (size_t i = 0; i + 1 < pnts.size(); i++) {
+        if (pnts.at(i).second == pnts.at(i + 1).second) {
+            continue;
+        }
+
+        double mid = (pnts.at(i).first + pnts.at(i + 1).first) / 2.;
+        if (isInBox(box, x1 + mid * dx, y1 + mid * dy) == bInside) {
+            if (!res.empty() && res.back().second == pnts.at(i).second) {
+                res.back().second = pnts.at(i + 1).second;
+            } else {
+                res.emplace_back(pnts.at(i).second, pnts.at(i + 1).second);
+            }
+        }
+    }
+
+    return res;
 }
 
-MovIsectPtr VorDiag::makeMovIsectAt(const Circular_arc_point_2 &pnt,
-                                    const SitePtr &site1, const SitePtr &site2) {
-#ifdef ENABLE_LOGGING
-    BOOST_LOG_NAMED_SCOPE("makeMovIsectAt");
-    src::severity_logger<severity_level> slg;
-#endif
-    const auto &bisecId = std::minmax({site1->id(), site2->id()});
-    
-    if (m_bisecs.find(bisecId) != m_bisecs.end()) {
-        const auto bisec = m_bisecs.at(bisecId);
-        const auto traj = bisec->findTraj(pnt);
-        const auto &trajId = std::make_tuple(traj->id().first, traj->id().second,
-                                             traj->isLeft(), traj->isFirst());
+// Builds the DCEL of the diagram directly from the switches of the moving
+// intersections and the vertices at which they took place.
+void VorDiag::compVorDcel() {
+    m_dcel = VorDcel{};
+    std::vector<int> dcelVerts(m_vorVerts.size(), -1);
 
-        if (m_isects.find(trajId) == m_isects.end()) {
-            m_isects[trajId] = std::make_shared<MovIsect>(traj);
+    const auto fDcelVert = [&](int vertId) {
+        if (dcelVerts.at(vertId) < 0) {
+            const auto &pnt = m_vorVerts.at(vertId).pnt;
+            dcelVerts.at(vertId) = m_dcel.addVert(CGAL::to_double(pnt.x()),
+                                                  CGAL::to_double(pnt.y()));
         }
 
-        return m_isects.at(trajId);
-    }
+        return dcelVerts.at(vertId);
+    };
 
-#ifdef ENABLE_LOGGING
-    BOOST_LOG_SEV(slg, error) << "Bisector (" << bisecId.first << ", "
-            << bisecId.second << ") not found!";
-#endif
+    for (const auto &val : m_isects) {
+        const auto &isect = val.second;
+        const auto &traj = isect->traj();
+        const auto &switches = isect->switches();
+        const auto &switchVerts = isect->switchVerts();
 
-    return MovIsectPtr{};
-}
+        if (traj->secs().empty()
+            || typeid(*traj->secs().front()) != typeid(TrajSecPntPnt)) {
+            continue;
+        }
 
-MovIsectPtr VorDiag::makeMovIsect(const TrajPtr &traj) {
-    const auto &trajId = std::make_tuple(traj->id().first, traj->id().second,
-                                         traj->isLeft(), traj->isFirst());
+        const auto tspp = std::static_pointer_cast<TrajSecPntPnt>(traj->secs().front());
+        bool bIsLeft = traj->isLeft();
+        // The cell of the lighter site lies inside of the supporting circle.
+        const auto &light = *traj->site1() < *traj->site2() ? traj->site1() : traj->site2(),
+                &heavy = *traj->site1() < *traj->site2() ? traj->site2() : traj->site1();
+
+        const auto fAddEdge = [&](int v1, int v2) {
+            if (!tspp->isEqual()) {
+                const auto &circ = tspp->arc().supporting_circle();
+                m_dcel.addArc(bIsLeft ? v1 : v2, bIsLeft ? v2 : v1,
+                              light->id(), heavy->id(),
+                              CGAL::to_double(circ.center().x()),
+                              CGAL::to_double(circ.center().y()),
+                              std::sqrt(CGAL::to_double(circ.squared_radius())));
+            } else {
+                const auto &src = m_dcel.verts().at(v1), &tgt = m_dcel.verts().at(v2);
+                const auto center = light->center();
+                double x = CGAL::to_double(center.x()), y = CGAL::to_double(center.y());
+                bool bIsLightLeft = (tgt.x - src.x) * (y - src.y)
+                        - (tgt.y - src.y) * (x - src.x) > 0.;
 
-    if (m_isects.find(trajId) == m_isects.end()) {
-        m_isects[trajId] = std::make_shared<MovIsect>(traj);
+                m_dcel.addSeg(v1, v2, bIsLightLeft ? light->id() : heavy->id(),
+                              bIsLightLeft ? heavy->id() : light->id());
+            }
+        };
+
+        for (size_t i = 0; i + 1 < switches.size(); i++) {
+            if (!switches.at(i).second || switches.at(i).first == switches.at(i + 1).first
+                || switchVerts.at(i) < 0 || switchVerts.at(i + 1) < 0) {
+                continue;
+            }
+
+            fAddEdge(fDcelVert(switchVerts.at(i)), fDcelVert(switchVerts.at(i + 1)));
+        }
+
+        // Edges that are still traced at the maximum time end at a vertex of
+        // their own, which leaves the faces along the wavefront open.
+        if (m_bIsBounded && !switches.empty() && switches.back().second
+            && switchVerts.back() >= 0) {
+            const auto tEnd = std::min(m_maxSqrdTime, traj->end()->sqrdTime());
+            if (switches.back().first < tEnd) {
+                const auto pnt = isect->pntAt(tEnd);
+                fAddEdge(fDcelVert(switchVerts.back()),
+                         m_dcel.addVert(CGAL::to_double(pnt.x()), CGAL::to_double(pnt.y())));
+            }
+        }
     }
 
-    return m_isects.at(trajId);
+    m_dcel.build();
 }
 
-void VorDiag::checkEdgeEv(const OffCircPtr &offCirc, const Root_of_2 &tNow,
-                          const MovIsectPtr &isect, bool bLeft) {
-    MovIsectPtr other;
-    bool bOk = offCirc->neighbor(other, isect, bLeft);
+std::vector<std::vector<WfArc>> VorDiag::wavefrontsAt(
+        const std::vector<Root_of_2> &sqrdTimes) const {
+    CGAL_assertion(!m_bIsRepaired);
+    if (m_bIsRepaired) {
+        return std::vector<std::vector<WfArc>>(sqrdTimes.size());
+    }
 
-    CGAL_assertion(bOk);
-    if (bOk) {
-        checkEdgeEv(offCirc, tNow, isect, other);
+    // Every offset circle replays its actions once for all times, which
+    // requires the times in increasing order.
+    std::vector<size_t> order(sqrdTimes.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
     }
-}
 
-void VorDiag::checkEdgeEv(const OffCircPtr &offCirc, const Root_of_2 &sqrdTimeNow,
-                          const MovIsectPtr &isect, const MovIsectPtr &other) {
-#ifdef ENABLE_LOGGING
-    BOOST_LOG_NAMED_SCOPE("checkEdgeEv");
-    src::severity_logger<severity_level> slg;
-#endif
+    std::sort(order.begin(), order.end(), [&sqrdTimes](size_t i, size_t j) {
+        return sqrdTimes.at(i) < sqrdTimes.at(j);
+    });
 
-    auto temp = std::make_shared<TimePnt>(Point_2{},
-                                          Root_of_2{std::numeric_limits<double>::max()});
-    bool bIsValid = false;
-    std::vector<TimePntPtr> verts;
-    isect->traj()->isect(verts, other->traj());
+    std::vector<Root_of_2> sortedSqrdTimes;
+    for (size_t i : order) {
+        sortedSqrdTimes.push_back(sqrdTimes.at(i));
+    }
 
-    for (const auto &vert : verts) {
-        if (vert->sqrdTime() < temp->sqrdTime()
-            && sqrdTimeNow < vert->sqrdTime()) {
-            temp = vert;
-            bIsValid = true;
+    std::vector<std::vector<WfArc>> res(sqrdTimes.size());
+    for (const auto &val : m_offCircs) {
+        const auto arcs = val.second->arcsAt(sortedSqrdTimes);
+        for (size_t i = 0; i < order.size(); i++) {
+            auto &wf = res.at(order[i]);
+            wf.insert(wf.end(), arcs.at(i).begin(), arcs.at(i).end());
         }
     }
-    
-    if (bIsValid) {
-        const auto &edgeEv = std::make_shared<EdgeEv>(temp->arcPnt(), temp->sqrdTime(), offCirc->site(), isect, other);
-        m_queue.push(edgeEv);
 
-#ifdef ENABLE_LOGGING    
-        BOOST_LOG_SEV(slg, normal) << std::setprecision(30)
-                << "Inserting edge event at time "
-                << std::sqrt(CGAL::to_double(temp->sqrdTime())) << " at point ("
-                << CGAL::to_double(temp->arcPnt().x()) << ", "
-                << CGAL::to_double(temp->arcPnt().y()) << ") ... ";
-#endif
+    return res;
+}
+
+// Full circles cannot be written as arcs.
+static void addWfArc(IpeWriter &iw, const WfArc &wfArc, const std::string &layer,
+                     double scale, const std::string &color) {
+    if (wfArc.arc.is_full()) {
+        iw.add(wfArc.arc.supporting_circle(), layer, scale, color);
     } else {
-#ifdef ENABLE_LOGGING
-        BOOST_LOG_SEV(slg, normal) << std::setprecision(30) 
-                << "Invalid edge event at time "
-                << std::sqrt(CGAL::to_double(temp->sqrdTime())) << " at point ("
-                << CGAL::to_double(temp->arcPnt().x()) << ", "
-                << CGAL::to_double(temp->arcPnt().y()) << ") has been discarded ... ";
-#endif
+        iw.add(wfArc.arc, layer, scale, color);
     }
 }
 
-void VorDiag::storeEv(const EvPtr &ev) {
-    switch(ev->type())
-    {
-        case EvType::Coll:
-        {
-            m_collEvCnt++;
-            break;
-        }
-        case EvType::Dom:
-        {
-            m_domEvCnt++;
-            break;
-        }
-        case EvType::Edge:
-        {
-            m_edgeEvCnt++;
-            break;
-        }
-        case EvType::None:
-        default:
-        {
-            break;
-        }
-    };
-    
+void VorDiag::writeToIpe(const std::string &filePath) const {
+    std::vector<std::string> layers{"Sites", "VorDiag"};
 #ifdef ENABLE_VIEW
-    m_evs.push_back(ev);
+    std::vector<Root_of_2> evSqrdTimes;
+    const auto maxTime = FT{10},
+            timeStep = FT{.2};
+
+    // The layers of the offset circles have to be declared in advance.
+    size_t nSteps = 0;
+    for (Root_of_2 time = timeStep; time < maxTime; time += timeStep) {
+        nSteps++;
+    }
+
+    for (size_t i = 1; i <= nSteps; i++) {
+        layers.push_back("Wavefront" + std::to_string(i));
+        layers.push_back("Active" + std::to_string(i));
+    }
+
+    for (size_t i = 1; i <= evSqrdTimes.size(); i++) {
+        layers.push_back("Event" + std::to_string(i));
+    }
 #endif
-}
 
-void VorDiag::compVorEdges() {
-    for (const auto &val : m_isects) {
-        const auto isect = val.second;
-        const auto switches = isect->switches();
-        bool bIsLeft = isect->traj()->isLeft();
-
-        for (const auto trajSec : isect->traj()->secs()) {
-            if (typeid(*trajSec) == typeid(TrajSecPntPnt)) {
-                const auto tspp
-                        = std::static_pointer_cast<TrajSecPntPnt>(trajSec);
-
-                if (!tspp->isEqual()) {
-                    const auto circ = tspp->arc().supporting_circle();
-
-                    if (!switches.empty()) {
-                        for (size_t i = 0; i < switches.size() - 1; i++) {
-                            auto t1 = switches.at(i).first,
-                                    t2 = switches.at(i + 1).first;
-                            bool bIsWfEdge = switches.at(i).second;
-
-                            if (bIsWfEdge && t1 != t2) {
-                                const auto start = isect->pntAt(t1),
-                                        end = isect->pntAt(t2);
-                                const auto arc = Circular_arc_2{circ, bIsLeft ? start : end, bIsLeft ? end : start};
-                                m_vorEdges.push_back(arc);
-                            }
-                        }
-                    }
-                } else {
-                    if (!switches.empty()) {
-                        for (size_t i = 0; i < switches.size() - 1; i++) {
-                            auto t1 = switches.at(i).first,
-                                    t2 = switches.at(i + 1).first;
-                            bool bIsWfEdge = switches.at(i).second;
-
-                            if (bIsWfEdge && t1 != t2) {
-                                const auto start = isect->pntAt(t1),
-                                        end = isect->pntAt(t2);
-                                double x1 = CGAL::to_double(start.x()),
-                                        y1 = CGAL::to_double(start.y()),
-                                        x2 = CGAL::to_double(end.x()),
-                                        y2 = CGAL::to_double(end.y());
-                                m_vorSegs.push_back(Line_arc_2{Point_2{x1, y1}, Point_2{x2, y2}});
-                            }
-                        }
-                    }
-                }
-            }
-        }
+    if (!m_wavefront.empty()) {
+        layers.push_back("Wavefront");
     }
-}
 
-void VorDiag::writeToIpe(const std::string &filePath) const {
-    auto iw = IpeWriter{filePath};
-    double scale = 1e-4 / 6.;
+    IpeWriter iw{filePath, layers};
+    double scale = IPE_SCALE;
 
     for (const auto &site : m_sites) {
         std::ostringstream strs;
@@ -876,35 +3957,70 @@ void VorDiag::writeToIpe(const std::string &filePath) const {
 
         if (typeid(*site) == typeid(PntSite)) {
             const auto pntSite = std::static_pointer_cast<PntSite>(site);
-            iw.addIpeObj(IpeObj{pntSite->pnt(), "Sites", scale,
-                         "seagreen", "large", strs.str()});
+            iw.add(pntSite->pnt(), "Sites", scale,
+                   "seagreen", "large", strs.str());
         }
     }
 
     for (const auto &vorEdge : m_vorEdges) {
-        iw.addIpeObj(IpeObj{vorEdge, "VorDiag", scale, "black", "fat"});
+        iw.add(vorEdge, "VorDiag", scale, "black", "fat");
+    }
+
+    for (const auto &wfArc : m_wavefront) {
+        addWfArc(iw, wfArc, "Wavefront", scale, "blue");
     }
     
 #ifdef ENABLE_VIEW
-    std::vector<Root_of_2> evSqrdTimes;
     /*for (size_t i = 0; i < m_evs.size(); i++) {
         const auto ev = m_evs.at(i);
         std::stringstream strs;
         
         strs << "Event" << (i + 1);
         evSqrdTimes.push_back(ev->sqrdTime());
-        iw.addIpeObj(IpeObj{ev->arcPnt(), strs.str(), scale, "red"});
+        iw.add(ev->arcPnt(), strs.str(), scale, "red");
     }*/
     
-    const auto maxTime = FT{10},
-            timeStep = FT{.2};
     for (const auto &val : m_offCircs) {
         const auto offCirc = val.second;
         offCirc->writeArcsToIpe(iw, maxTime, timeStep, scale, evSqrdTimes);
     }
 #endif
 
-    iw.write();
+    iw.close();
+}
+
+// Writes one layer per snapshot time, which holds the wavefront (blue) and
+// the active arcs behind it (orange).
+void VorDiag::writeSnapshotsToIpe(const std::string &filePath,
+                                  const std::vector<double> &times) const {
+    std::vector<std::string> layers{"Sites"};
+    std::vector<Root_of_2> sqrdTimes;
+    for (size_t i = 0; i < times.size(); i++) {
+        const FT time{times.at(i)};
+        sqrdTimes.push_back(time * time);
+        layers.push_back("Snapshot" + std::to_string(i + 1));
+    }
+
+    const auto wavefronts = wavefrontsAt(sqrdTimes);
+
+    IpeWriter iw{filePath, layers};
+    double scale = IPE_SCALE;
+
+    for (const auto &site : m_sites) {
+        if (typeid(*site) == typeid(PntSite)) {
+            const auto pntSite = std::static_pointer_cast<PntSite>(site);
+            iw.add(pntSite->pnt(), "Sites", scale, "seagreen", "large");
+        }
+    }
+
+    for (size_t i = 0; i < wavefronts.size(); i++) {
+        const auto layer = "Snapshot" + std::to_string(i + 1);
+        for (const auto &wfArc : wavefronts.at(i)) {
+            addWfArc(iw, wfArc, layer, scale, wfArc.bIsOnWf ? "blue" : "orange");
+        }
+    }
+
+    iw.close();
 }
 
 void VorDiag::writeToCsv(const std::string &filePath, long long runtime,
@@ -926,17 +4042,98 @@ void VorDiag::writeToCsv(const std::string &filePath, long long runtime,
 
 #ifdef ENABLE_VIEW
 
+// The maximum number of pieces of an arc.
+const size_t MAX_ARC_PIECES = 512;
+
+// Returns the bounding box of an arc, i.e., of its end points and the
+// extreme points of the circle within its span.
+static QRectF arcRect(double cx, double cy, double r, double a1, double span) {
+    double a2 = a1 + span;
+    QPointF p1{cx + r * std::cos(a1), cy + r * std::sin(a1)},
+            p2{cx + r * std::cos(a2), cy + r * std::sin(a2)};
+    double xMin = std::min(p1.x(), p2.x()), xMax = std::max(p1.x(), p2.x()),
+            yMin = std::min(p1.y(), p2.y()), yMax = std::max(p1.y(), p2.y());
+
+    for (int k = -4; k <= 8; k++) {
+        double a = k * CGAL_PI / 2.;
+        if (a1 < a && a < a2) {
+            switch ((k % 4 + 4) % 4) {
+                case 0: xMax = cx + r; break;
+                case 1: yMax = cy + r; break;
+                case 2: xMin = cx - r; break;
+                default: yMin = cy - r; break;
+            }
+        }
+    }
+
+    return QRectF{QPointF{xMin, yMin}, QPointF{xMax, yMax}};
+}
+
+static bool overlaps(const QRectF &rect1, const QRectF &rect2) {
+    return rect1.left() <= rect2.right() && rect2.left() <= rect1.right()
+            && rect1.top() <= rect2.bottom() && rect2.top() <= rect1.bottom();
+}
+
 VorDiagGraphicsItem::VorDiagGraphicsItem(const VorDiag &vorDiag)
 : m_vorDiag{vorDiag}
 {
-    prepareGeometryChange();
-    QRectF rect;
+    setAcceptHoverEvents(true);
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+
     for (const auto &edge : m_vorDiag.edges()) {
         const auto circ = edge.supporting_circle();
-        rect |= Util::boundingRect(circ);
+        ViewEdge viewEdge;
+        viewEdge.p1 = QPointF{CGAL::to_double(edge.source().x()),
+                              CGAL::to_double(edge.source().y())};
+        viewEdge.p2 = QPointF{CGAL::to_double(edge.target().x()),
+                              CGAL::to_double(edge.target().y())};
+        viewEdge.cx = CGAL::to_double(circ.center().x());
+        viewEdge.cy = CGAL::to_double(circ.center().y());
+        viewEdge.r = std::sqrt(CGAL::to_double(circ.squared_radius()));
+        viewEdge.a1 = std::atan2(viewEdge.p1.y() - viewEdge.cy, viewEdge.p1.x() - viewEdge.cx);
+        viewEdge.span = std::atan2(viewEdge.p2.y() - viewEdge.cy,
+                                   viewEdge.p2.x() - viewEdge.cx) - viewEdge.a1;
+        if (viewEdge.span <= 0.) {
+            viewEdge.span += 2. * CGAL_PI;
+        }
+
+        viewEdge.rect = arcRect(viewEdge.cx, viewEdge.cy, viewEdge.r,
+                                viewEdge.a1, viewEdge.span);
+        m_edges.push_back(viewEdge);
     }
-    
+
+    for (const auto &seg : m_vorDiag.segs()) {
+        ViewEdge viewEdge{};
+        viewEdge.p1 = QPointF{CGAL::to_double(seg.source().x()),
+                              CGAL::to_double(seg.source().y())};
+        viewEdge.p2 = QPointF{CGAL::to_double(seg.target().x()),
+                              CGAL::to_double(seg.target().y())};
+        viewEdge.rect = QRectF{viewEdge.p1, viewEdge.p2}.normalized();
+        m_edges.push_back(viewEdge);
+    }
+
+    QRectF rect;
+    for (const auto &site : m_vorDiag.sites()) {
+        double x = CGAL::to_double(site->center().x()),
+                y = CGAL::to_double(site->center().y());
+        m_sitePnts.push_back(QPointF{x, y});
+        rect |= QRectF{x - 5., y - 5., 10., 10.};
+    }
+
+    for (const auto &viewEdge : m_edges) {
+        rect |= viewEdge.rect.adjusted(-1., -1., 1., 1.);
+    }
+
+    prepareGeometryChange();
     m_boundingRect = rect;
+    buildGrid();
+    m_stamps.assign(m_edges.size(), 0);
+    m_polylines.resize(m_edges.size());
+
+    // The events are stored in the order of processing, i.e., sorted by time.
+    for (const auto &ev : m_vorDiag.events()) {
+        m_evSqrdTimes.push_back(CGAL::to_double(ev->sqrdTime()));
+    }
 }
 
 QRectF VorDiagGraphicsItem::boundingRect() const {
@@ -947,69 +4144,246 @@ void VorDiagGraphicsItem::modelChanged() {
     update();
 }
 
-void VorDiagGraphicsItem::onToggle(bool bIsVisible) {
-    setVisible(bIsVisible);
-    update();
+// The grid has about as many cells as there are edges (or sites).
+void VorDiagGraphicsItem::buildGrid() {
+    m_gridRect = m_boundingRect;
+    size_t n = std::max<size_t>(1, std::max(m_edges.size(), m_sitePnts.size()));
+    double w = std::max(m_gridRect.width(), 1.), h = std::max(m_gridRect.height(), 1.),
+            cellSize = std::sqrt(w * h / n);
+    m_nx = std::min<size_t>(4096, std::max<size_t>(1, std::ceil(w / cellSize)));
+    m_ny = std::min<size_t>(4096, std::max<size_t>(1, std::ceil(h / cellSize)));
+
+    const auto fCompress = [](const std::vector<std::vector<size_t>> &cells,
+                              std::vector<size_t> &offsets,
+                              std::vector<size_t> &items) {
+        offsets.assign(1, 0);
+        items.clear();
+        for (const auto &cell : cells) {
+            items.insert(items.end(), cell.begin(), cell.end());
+            offsets.push_back(items.size());
+        }
+    };
+
+    std::vector<std::vector<size_t>> cells(m_nx * m_ny);
+    size_t x1, y1, x2, y2;
+    for (size_t i = 0; i < m_edges.size(); i++) {
+        if (cellRange(m_edges.at(i).rect, x1, y1, x2, y2)) {
+            for (size_t y = y1; y <= y2; y++) {
+                for (size_t x = x1; x <= x2; x++) {
+                    cells.at(y * m_nx + x).push_back(i);
+                }
+            }
+        }
+    }
+
+    fCompress(cells, m_edgeOffsets, m_cellEdges);
+
+    cells.assign(m_nx * m_ny, std::vector<size_t>{});
+    for (size_t i = 0; i < m_sitePnts.size(); i++) {
+        const auto &pnt = m_sitePnts.at(i);
+        if (cellRange(QRectF{pnt, pnt}, x1, y1, x2, y2)) {
+            cells.at(y1 * m_nx + x1).push_back(i);
+        }
+    }
+
+    fCompress(cells, m_siteOffsets, m_cellSites);
 }
 
+// Determines the cells that intersect rect; returns false if there are none.
+bool VorDiagGraphicsItem::cellRange(const QRectF &rect, size_t &x1, size_t &y1,
+                                    size_t &x2, size_t &y2) const {
+    if (!overlaps(rect, m_gridRect)) {
+        return false;
+    }
 
-void VorDiagGraphicsItem::onPrevEv(double t) {
-    const auto evs = m_vorDiag.events();
-    if (m_evIndex > 0) {
-        auto ev = evs.at(--m_evIndex);
-        double evTime = CGAL::to_double(ev->sqrdTime());
-        
-        while (m_evIndex > 0 && evTime > t) {
-            ev = evs.at(--m_evIndex);
-            evTime = CGAL::to_double(ev->sqrdTime());
+    double cellWidth = m_gridRect.width() / m_nx,
+            cellHeight = m_gridRect.height() / m_ny;
+    const auto fIndex = [](double val, double cellSize, size_t n) {
+        if (!(cellSize > 0.) || val < 0.) {
+            return size_t{0};
         }
 
-        m_evPnt = ev->arcPnt();
-        m_bEvPntVisible = true;
-        emit timeChanged(std::sqrt(evTime));
+        return std::min(n - 1, static_cast<size_t>(val / cellSize));
+    };
+
+    x1 = fIndex(rect.left() - m_gridRect.left(), cellWidth, m_nx);
+    x2 = fIndex(rect.right() - m_gridRect.left(), cellWidth, m_nx);
+    y1 = fIndex(rect.top() - m_gridRect.top(), cellHeight, m_ny);
+    y2 = fIndex(rect.bottom() - m_gridRect.top(), cellHeight, m_ny);
+    return true;
+}
+
+// Every zoom level (a power of two of the scale) has its own resolution, at
+// which the chords of the polylines deviate by less than a pixel from the
+// arcs.
+const std::vector<QPointF> & VorDiagGraphicsItem::polyline(size_t edge, double scale) {
+    int lodLevel = static_cast<int>(std::floor(std::log2(scale)));
+    if (lodLevel != m_lodLevel) {
+        m_polylines.assign(m_edges.size(), std::vector<QPointF>{});
+        m_lodLevel = lodLevel;
     }
+
+    auto &pnts = m_polylines.at(edge);
+    if (!pnts.empty()) {
+        return pnts;
+    }
+
+    const auto &viewEdge = m_edges.at(edge);
+    size_t nPieces = 1;
+    double tol = .5 / std::ldexp(1., lodLevel);
+    if (viewEdge.r > tol) {
+        double step = 2. * std::acos(1. - tol / viewEdge.r);
+        nPieces = std::min(MAX_ARC_PIECES,
+                           std::max<size_t>(1, std::ceil(viewEdge.span / step)));
+    }
+
+    pnts.push_back(viewEdge.p1);
+    for (size_t i = 1; i < nPieces; i++) {
+        double a = viewEdge.a1 + viewEdge.span * i / nPieces;
+        pnts.push_back(QPointF{viewEdge.cx + viewEdge.r * std::cos(a),
+                               viewEdge.cy + viewEdge.r * std::sin(a)});
+    }
+
+    pnts.push_back(viewEdge.p2);
+    return pnts;
 }
 
-void VorDiagGraphicsItem::onNextEv(double t) {
-    const auto evs = m_vorDiag.events();
-    if (m_evIndex < evs.size() - 1) {
-        auto ev = evs.at(++m_evIndex);
-        double evTime = CGAL::to_double(ev->sqrdTime());
+void VorDiagGraphicsItem::hoverMoveEvent(QGraphicsSceneHoverEvent *event) {
+    const auto pos = event->pos();
+    const auto rect = QRectF{pos.x() - m_pickRadius, pos.y() - m_pickRadius,
+                             2. * m_pickRadius, 2. * m_pickRadius};
+    QString toolTip;
+    size_t x1, y1, x2, y2;
 
-        while (m_evIndex < evs.size() - 1 && evTime < t) {
-            ev = evs.at(++m_evIndex);
-            evTime = CGAL::to_double(ev->sqrdTime());
+    if (m_bShowSites && cellRange(rect, x1, y1, x2, y2)) {
+        double minSqrdDist = m_pickRadius * m_pickRadius;
+        const SitePtr *nearest = nullptr;
+        for (size_t y = y1; y <= y2; y++) {
+            for (size_t x = x1; x <= x2; x++) {
+                size_t cell = y * m_nx + x;
+                for (size_t i = m_siteOffsets.at(cell); i < m_siteOffsets.at(cell + 1); i++) {
+                    const auto &pnt = m_sitePnts.at(m_cellSites.at(i));
+                    double dx = pnt.x() - pos.x(), dy = pnt.y() - pos.y();
+                    if (dx * dx + dy * dy <= minSqrdDist) {
+                        minSqrdDist = dx * dx + dy * dy;
+                        nearest = &m_vorDiag.sites().at(m_cellSites.at(i));
+                    }
+                }
+            }
+        }
+
+        if (nearest) {
+            toolTip = "id " + QString::number((*nearest)->id()) + "\nweight "
+                    + QString::number(CGAL::to_double((*nearest)->weight()));
         }
+    }
+
+    setToolTip(toolTip);
+    CGAL::Qt::GraphicsItem::hoverMoveEvent(event);
+}
 
-        m_evPnt = ev->arcPnt();
-        m_bEvPntVisible = true;
-        emit timeChanged(std::sqrt(evTime));
+void VorDiagGraphicsItem::onToggle(bool bIsVisible) {
+    m_bShow = bIsVisible;
+    update();
+}
+
+void VorDiagGraphicsItem::onToggleSites(bool bIsVisible) {
+    m_bShowSites = bIsVisible;
+    update();
+}
+
+
+// Moves to the last event before the current one that does not succeed t.
+void VorDiagGraphicsItem::onPrevEv(double t) {
+    if (m_evIndex == 0 || m_evSqrdTimes.empty()) {
+        return;
+    }
+
+    size_t nPrev = std::upper_bound(m_evSqrdTimes.begin(), m_evSqrdTimes.end(), t)
+            - m_evSqrdTimes.begin();
+    m_evIndex = std::min(m_evIndex - 1, nPrev > 0 ? nPrev - 1 : 0);
+    showEv();
+}
+
+// Moves to the first event after the current one that does not precede t.
+void VorDiagGraphicsItem::onNextEv(double t) {
+    if (m_evIndex + 1 >= m_evSqrdTimes.size()) {
+        return;
     }
+
+    size_t next = std::lower_bound(m_evSqrdTimes.begin(), m_evSqrdTimes.end(), t)
+            - m_evSqrdTimes.begin();
+    m_evIndex = std::min(std::max(m_evIndex + 1, next), m_evSqrdTimes.size() - 1);
+    showEv();
+}
+
+void VorDiagGraphicsItem::showEv() {
+    m_evPnt = m_vorDiag.events().at(m_evIndex)->arcPnt();
+    m_bEvPntVisible = true;
+    emit timeChanged(std::sqrt(m_evSqrdTimes.at(m_evIndex)));
 }
 
 void VorDiagGraphicsItem::onHideEvPnt() {
     m_bEvPntVisible = false;
 }
 
+// The edges are collected in a single list of lines and the sites in a single
+// list of points, such that each of them is drawn by a single call.
 void VorDiagGraphicsItem::paint(QPainter *painter,
-                                const QStyleOptionGraphicsItem *, QWidget *) {
+                                const QStyleOptionGraphicsItem *option, QWidget *) {
     const auto scale = std::max(painter->worldTransform().m11(), 
                                 painter->worldTransform().m22());
-    auto brush = QBrush{Qt::black};
-    painter->setBrush(brush);
-    painter->setPen(QPen{brush, 1. / scale});
+    const auto exposedRect = option->exposedRect;
+    m_pickRadius = 5. / scale;
+    m_paintCnt++;
 
-    for (const auto &edge : m_vorDiag.edges()) {
-        Util::draw(painter, edge);
+    size_t x1, y1, x2, y2;
+    bool bIsExposed = cellRange(exposedRect, x1, y1, x2, y2);
+
+    if (m_bShow && bIsExposed) {
+        std::vector<QLineF> lines;
+        for (size_t y = y1; y <= y2; y++) {
+            for (size_t x = x1; x <= x2; x++) {
+                size_t cell = y * m_nx + x;
+                for (size_t i = m_edgeOffsets.at(cell); i < m_edgeOffsets.at(cell + 1); i++) {
+                    size_t edge = m_cellEdges.at(i);
+                    if (m_stamps.at(edge) == m_paintCnt
+                        || !overlaps(m_edges.at(edge).rect, exposedRect)) {
+                        continue;
+                    }
+
+                    m_stamps.at(edge) = m_paintCnt;
+                    const auto &pnts = polyline(edge, scale);
+                    for (size_t j = 1; j < pnts.size(); j++) {
+                        lines.push_back(QLineF{pnts.at(j - 1), pnts.at(j)});
+                    }
+                }
+            }
+        }
+
+        painter->setPen(QPen{QBrush{Qt::black}, 1. / scale});
+        painter->drawLines(lines.data(), static_cast<int>(lines.size()));
     }
-    
-    for (const auto &edge : m_vorDiag.segs()) {
-        Util::draw(painter, edge);
+
+    if (m_bShowSites && bIsExposed) {
+        std::vector<QPointF> pnts;
+        for (size_t y = y1; y <= y2; y++) {
+            for (size_t x = x1; x <= x2; x++) {
+                size_t cell = y * m_nx + x;
+                for (size_t i = m_siteOffsets.at(cell); i < m_siteOffsets.at(cell + 1); i++) {
+                    pnts.push_back(m_sitePnts.at(m_cellSites.at(i)));
+                }
+            }
+        }
+
+        painter->setPen(QPen{QBrush{Qt::darkGreen}, 10. / scale, Qt::SolidLine, Qt::RoundCap});
+        painter->drawPoints(pnts.data(), static_cast<int>(pnts.size()));
     }
 
     if (m_bEvPntVisible) {
-        brush = QBrush{Qt::red};
+        const auto brush = QBrush{Qt::red};
         painter->setBrush(brush);
+        painter->setPen(QPen{brush, 1. / scale});
         Util::draw(painter, m_evPnt, 8.);
     }
 }
@@ -1,15 +1,24 @@
 #ifndef MWVD_H
 #define MWVD_H
 
-#include <queue>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <unordered_map>
 #ifdef ENABLE_VIEW
 #include <CGAL/Qt/Converter.h>
 #endif
 #include "offcirc.h"
+#include "dcel.h"
+#include "file_io.h"
 
 class Ev;
 
 using EvPtr = std::shared_ptr<Ev>;
+// An interval of doubles that contains the squared time of an event.
+using TimeIval = std::pair<double, double>;
 
 enum class EvType {
     None,
@@ -22,6 +31,8 @@ class Ev {
 public:
     Ev(const Circular_arc_point_2 &arcPnt = Circular_arc_point_2{}, 
             const Root_of_2 &sqrdTime = 0., const SitePtr &site = SitePtr{});
+    Ev(const Circular_arc_point_2 &arcPnt, const Root_of_2 &sqrdTime,
+            const SitePtr &site, const TimeIval &timeIval);
 
     virtual ~Ev() = default;
 
@@ -42,12 +53,17 @@ public:
         return m_site;
     }
 
+    const TimeIval & timeIval() const {
+        return m_timeIval;
+    }
+
     virtual EvType type() const = 0;
 
 private:
     Circular_arc_point_2 m_arcPnt;
     Root_of_2 m_sqrdTime;
     SitePtr m_site;
+    TimeIval m_timeIval;
 };
 
 class CollEv : public Ev {
@@ -55,6 +71,9 @@ public:
     CollEv(const Circular_arc_point_2 &arcPnt, const Root_of_2 &sqrdTime, 
             const SitePtr &site, const TrajPtr &traj1, const TrajPtr &traj2, 
             bool bPierces);
+    CollEv(const Circular_arc_point_2 &arcPnt, const Root_of_2 &sqrdTime,
+            const SitePtr &site, const TrajPtr &traj1, const TrajPtr &traj2,
+            bool bPierces, const TimeIval &timeIval);
 
     EvType type() const override {
         return EvType::Coll;
@@ -127,6 +146,15 @@ private:
 class EvPtrComp {
 public:
     bool operator()(const EvPtr &lhs, const EvPtr &rhs) const {
+        // Disjoint intervals decide without comparing the exact times.
+        if (lhs->timeIval().second < rhs->timeIval().first) {
+            return false;
+        }
+
+        if (rhs->timeIval().second < lhs->timeIval().first) {
+            return true;
+        }
+
         if (lhs->sqrdTime() != rhs->sqrdTime()) {
             return lhs->sqrdTime() > rhs->sqrdTime();
         }
@@ -173,17 +201,334 @@ public:
             }
         } 
         
-        return false;
+        // Ties are broken by the bisector, the site and the moving
+        // intersections, such that the order of the events does not depend
+        // on the order in which they have been pushed. Hence, the events of
+        // the two sites of a collision or a domination follow each other,
+        // unless one of them has been pushed twice (see
+        // VorDiag::popGroup()).
+        return tieKey(lhs) > tieKey(rhs);
+    }
+
+private:
+    using TieKey = std::tuple<std::pair<int, int>, int, MovIsectId, MovIsectId>;
+
+    static MovIsectId trajId(const TrajPtr &traj) {
+        return std::make_tuple(traj->id().first, traj->id().second,
+                               traj->isLeft(), traj->isFirst());
+    }
+
+    static TieKey tieKey(const EvPtr &ev) {
+        switch (ev->type()) {
+            case EvType::Coll:
+            {
+                const auto collEv = std::static_pointer_cast<CollEv>(ev);
+                return TieKey{collEv->traj1()->id(), ev->site()->id(),
+                              trajId(collEv->traj1()), trajId(collEv->traj2())};
+            }
+            case EvType::Dom:
+            {
+                const auto domEv = std::static_pointer_cast<DomEv>(ev);
+                return TieKey{domEv->isect1()->traj()->id(), ev->site()->id(),
+                              domEv->isect1()->id(), domEv->isect2()->id()};
+            }
+            case EvType::Edge:
+            {
+                const auto edgeEv = std::static_pointer_cast<EdgeEv>(ev);
+                return TieKey{std::make_pair(-1, -1), ev->site()->id(),
+                              edgeEv->isect1()->id(), edgeEv->isect2()->id()};
+            }
+            case EvType::None:
+            default:
+                return TieKey{};
+        }
+    }
+};
+
+// The implementation of the event queue.
+enum class QueueType {
+    // A binary heap.
+    Heap,
+    // A bucket queue on the lower bounds of the squared times.
+    Buckets
+};
+
+// The queue of the events in the order of EvPtrComp, i.e., top() is the
+// event that compares greatest. The binary heap compares exactly on every
+// push and pop. The bucket queue splits a range of squared times into
+// buckets of equal width, each of which is a binary heap, and the events
+// beyond the last bucket are kept in an overflow heap. An event goes into
+// the bucket of the lower bound of its time interval (see Ev::timeIval()),
+// such that the heaps of the buckets are small. Since the intervals of
+// events in neighboring buckets may overlap, top() compares the top of the
+// first nonempty bucket with the tops of the buckets that its interval
+// reaches. The width is chosen whenever the buckets have run empty, from
+// the times of the next events in the overflow heap. Events that are pushed
+// behind the current bucket (e.g., by a rollback of the speculative sweep)
+// go into the current bucket.
+class EvQueue {
+public:
+    EvQueue(QueueType type = QueueType::Heap);
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    const EvPtr & top();
+    // Exact duplicates of pending edge events are dropped.
+    void push(const EvPtr &ev);
+    void pop();
+    // Replaces the events by evs in linear time.
+    void assign(std::vector<EvPtr> evs);
+
+    // Calls f for every pending event without copying the queue. The events
+    // that follow a popped event come first and the other edge events of a
+    // vertex after the one in the heap, such that assign() restores the
+    // order of the edge events of every vertex.
+    template<class F>
+    void forEach(F f) const {
+        for (auto it = m_twins.rbegin(); it != m_twins.rend(); ++it) {
+            f(*it);
+        }
+
+        for (const auto &ev : m_heap) {
+            f(ev);
+        }
+
+        for (const auto &bucket : m_buckets) {
+            for (const auto &ev : bucket) {
+                f(ev);
+            }
+        }
+
+        for (const auto &val : m_verts) {
+            for (const auto &evs : val.second) {
+                for (auto it = evs.begin() + 1; it != evs.end(); ++it) {
+                    f(*it);
+                }
+            }
+        }
     }
+
+private:
+    using VertKey = std::array<int, 3>;
+
+    struct VertKeyHash {
+        size_t operator()(const VertKey &key) const;
+    };
+
+    static bool vertKey(const EvPtr &ev, VertKey &key);
+    bool addToVert(const EvPtr &ev, bool &bIsDup);
+    const EvPtr & heapTop();
+    void heapPush(const EvPtr &ev);
+    void heapPop();
+    double bucketOf(double sqrdTime) const;
+    void locateTop();
+    void fillBuckets();
+
+    QueueType m_type;
+    size_t m_size{0};
+    // The pending edge events by their vertex, i.e., by the sorted ids of
+    // the three sites and by their time and point. Only the first edge
+    // event of a vertex is in the heap, the others follow it in m_twins
+    // when it is popped.
+    std::unordered_map<VertKey, std::vector<std::vector<EvPtr>>, VertKeyHash> m_verts;
+    std::vector<EvPtr> m_twins;
+    // The binary heap (or the overflow heap of the buckets).
+    std::vector<EvPtr> m_heap;
+    std::vector<std::vector<EvPtr>> m_buckets;
+    double m_width{1.};
+    double m_base{0.};
+    size_t m_cur{0};
+    // The bucket of the top event (m_buckets.size() for the overflow heap)
+    // if m_bIsTopValid is set.
+    size_t m_top{0};
+    bool m_bIsTopValid{false};
+};
+
+class BinWriter;
+
+// How the pairs of sites whose initial collisions are computed are found.
+enum class CandMode {
+    // Classes if the classes of equal weight are large, otherwise Overlay
+    // (the choice is reported).
+    Auto,
+    // All pairs of sites.
+    All,
+    // The pairs within the candidate sets of the overlay of the Voronoi
+    // cells of the sites at their insertion (see Overlay).
+    Overlay,
+    // The neighbors within a class of equal weight among the sites of at
+    // least its weight (see Overlay) and the pairs of sites of different
+    // classes whose bounding disks may touch (see CandGrid).
+    Classes,
+    // The pairs of sites whose bounding disks may touch (see CandGrid).
+    Grid
+};
+
+// The squared distances from (x, y) to the nearest and farthest box points.
+template<class T>
+T boxMinSqrdDist(const T &xMin, const T &yMin, const T &xMax, const T &yMax,
+        const T &x, const T &y) {
+    const T dx = x < xMin ? xMin - x : (x > xMax ? x - xMax : T{0}),
+            dy = y < yMin ? yMin - y : (y > yMax ? y - yMax : T{0});
+    return dx * dx + dy * dy;
+}
+
+template<class T>
+T boxMaxSqrdDist(const T &xMin, const T &yMin, const T &xMax, const T &yMax,
+        const T &x, const T &y) {
+    const T dx = std::max(x - xMin, xMax - x), dy = std::max(y - yMin, yMax - y);
+    return dx * dx + dy * dy;
+}
+
+// Options that control the computation and the output of a VorDiag.
+struct VorDiagOpts {
+    CandMode candMode{CandMode::Auto};
+    QueueType queueType{QueueType::Heap};
+    // Compute the diagram of sites with equal weights as the dual of their
+    // Delaunay triangulation instead of by the sweep (see
+    // VorDiag::compLinear()). Ignored if the sweep is recorded, if the
+    // maximum time is given or if the DCEL is computed.
+    bool bUseDelaunay{true};
+    // Directory of the on-disk cache of the overlay (none if empty).
+    std::string overlayCacheDir;
+    std::string ipeFilePath;
+    std::string csvFilePath;
+    std::string binFilePath;
+    std::string dcelFilePath;
+    bool bEnableView{false};
+    // Number of threads used for extracting the edges (0 means one per core).
+    size_t nThreads{0};
+    // Handle events that touch disjoint offset circles concurrently (see
+    // VorDiag::runSpeculative()). Ignored if the sweep is recorded.
+    bool bParallelSweep{false};
+    // Compute the DCEL even if it is not written to a file.
+    bool bCompDcel{false};
+    // Compute the edges even if they are not written to a file.
+    bool bCompEdges{false};
+    // Process only the events up to maxTime (if not negative) and keep the
+    // wavefront at maxTime.
+    double maxTime{-1.};
+    // Compute the diagram only within clipBox (if bClip is set).
+    bool bClip{false};
+    CGAL::Bbox_2 clipBox;
+    // Record the arcs of the offset circles, such that the wavefront can be
+    // restored at the snapshot times after the sweep (see wavefrontsAt()).
+    std::vector<double> snapshotTimes;
+    std::string snapshotFilePath;
+    // Write a checkpoint of the sweep to ckptFilePath after every ckptEvCnt
+    // events or ckptSecs seconds (zero disables either), and resume from it
+    // if bResume is set and it exists. Ignored if the sweep is recorded.
+    std::string ckptFilePath;
+    size_t ckptEvCnt{0};
+    double ckptSecs{0.};
+    bool bResume{false};
+};
+
+// A vertex of the diagram, i.e., the point and the time of an event at which
+// moving intersections switched their state.
+struct VorVert {
+    Circular_arc_point_2 pnt;
+    Root_of_2 sqrdTime;
 };
 
 class VorDiag {
+    // An edge of the binary output format. The end points refer to the
+    // vertices in m_vorVerts (-1 if they are not vertices, e.g., on the
+    // sides of the clip box).
+    struct BinEdge {
+        bool bIsArc;
+        double x1;
+        double y1;
+        double x2;
+        double y2;
+        int site1;
+        int site2;
+        double cx;
+        double cy;
+        double r;
+        int vert1;
+        int vert2;
+    };
+
+    // An edge of the diagram of sites with equal weights, i.e., a piece of
+    // the bisector line of site1 and site2.
+    struct LineEdge {
+        int site1;
+        int site2;
+        Line_2 line;
+        Circular_arc_point_2 start;
+        Circular_arc_point_2 end;
+        // The vertices in m_vorVerts (-1 for far points).
+        int vert1;
+        int vert2;
+    };
+
+    // The sites of a stored edge and the vertices in m_vorVerts at its end
+    // points (-1 if they are not vertices, see BinEdge).
+    struct EdgeInfo {
+        int site1;
+        int site2;
+        int vert1;
+        int vert2;
+    };
+
+    // Holds the edges that have been extracted by a single thread.
+    struct EdgeBatch {
+        std::vector<Circular_arc_2> arcs;
+        std::vector<Line_arc_2> segs;
+        std::vector<EdgeInfo> arcInfos;
+        std::vector<EdgeInfo> segInfos;
+        std::vector<BinEdge> binEdges;
+    };
+
+    // Buffers the effects of a group of events that is handled
+    // speculatively, such that it can be committed in the order of the serial
+    // sweep or rolled back.
+    struct EvLog {
+        std::vector<EvPtr> evs;
+        // The increments of the counters.
+        std::map<int *, int> cnts;
+        // The events at which the moving intersections have been stamped
+        // with the provisional vertex ids PROVISIONAL_VERT - i.
+        std::vector<std::pair<EvPtr, std::vector<MovIsectPtr>>> stamps;
+        std::vector<MovIsectId> newIsects;
+        std::mutex *isectMutex{nullptr};
+        // The entries of the offset circles that the group has changed and
+        // the moving intersections that it may touch, as they were before.
+        std::vector<std::pair<OffCircPtr, OffCircUndo>> offCircs;
+        std::vector<std::pair<MovIsectPtr, MovIsect>> isects;
+    };
+
 public:
     VorDiag(const std::string &inFilePath,
-            bool bUseOverlay = true,
-            const std::string &ipeFilePath = "",
-            const std::string &csvFilePath = "",
-            bool bEnableView = false);
+            const VorDiagOpts &opts = VorDiagOpts{});
+    VorDiag(std::vector<SiteData> siteData,
+            const VorDiagOpts &opts = VorDiagOpts{});
+
+    // Insert, delete or reweight a site and update the edges (see
+    // bCompEdges), the offset circles, the vertices and the DCEL (see
+    // repair()). Only the box around the old and the new cell of the site is
+    // recomputed, unless a cell may be unbounded or the sweep has not run to
+    // completion (see maxTime, bClip and snapshotTimes), which requires a
+    // full recomputation with the same options. Return false if the id
+    // exists already (or does not exist, respectively).
+    bool insertSite(const SiteData &site);
+    bool deleteSite(int id);
+    bool reweightSite(int id, int weight);
+
+    // Recomputes the diagram of the current sites from scratch (without
+    // output files) and compares it with this diagram up to the order of the
+    // sites and the edges. Prints the differences and returns false if there
+    // are any.
+    bool checkUpdates() const;
+
+    void writeToIpe(const std::string &filePath) const;
     
     const std::vector<SitePtr> & sites() const {
         return m_sites;
@@ -200,6 +545,37 @@ public:
     const std::map<int, OffCircPtr> & offCircs() const {
         return m_offCircs;
     }
+
+    // After updates, the vertices are those at the ends of the edges and
+    // the DCEL is rebuilt from the edges, both on demand.
+    const std::vector<VorVert> & verts() const {
+        if (m_bIsTopoStale) {
+            rebuildTopology();
+        }
+
+        return m_vorVerts;
+    }
+
+    const VorDcel & dcel() const {
+        if (m_bIsTopoStale) {
+            rebuildTopology();
+        }
+
+        return m_dcel;
+    }
+
+    // Returns the wavefront at the maximum time (if given).
+    const std::vector<WfArc> & wavefront() const {
+        return m_wavefront;
+    }
+
+    // Returns the arcs of the offset circles at the given times (in the
+    // given order), i.e., the wavefront and the arcs behind it that are
+    // still active. Requires that the sweep has been recorded and that the
+    // diagram has not been repaired (see repair()); returns no arcs
+    // otherwise.
+    std::vector<std::vector<WfArc>> wavefrontsAt(
+            const std::vector<Root_of_2> &sqrdTimes) const;
     
 #ifdef ENABLE_VIEW
     const std::vector<EvPtr> & events() const {
@@ -208,12 +584,45 @@ public:
 #endif
     
 private:
+    std::vector<SiteData> clipSites(const std::vector<SiteData> &sites,
+            const CGAL::Bbox_2 &clipBox);
+    void prepareUpdates();
+    bool isRepairable() const;
+    VorDiagOpts recomputeOpts() const;
+    void recompute(const std::vector<SiteData> &siteData);
+    void repair(const CGAL::Bbox_2 &box, const SiteData *newSite, int oldId);
+    bool cellBox(const SiteData &site, CGAL::Bbox_2 &box) const;
+    std::vector<SiteData> localSites(const CGAL::Bbox_2 &box,
+            const SiteData *newSite, int oldId) const;
+    void addSite(const SitePtr &site);
+    void removeSite(int id);
+    std::set<int> spliceEdges(const VorDiag &local, const CGAL::Bbox_2 &box,
+            const std::vector<SiteData> &siteData, int oldId);
+    void updateDomTimes(const std::set<int> &siteIds);
+    void rebuildTopology() const;
+    std::vector<SiteData> sitesAsData() const;
     void compColls(const std::vector<std::set<int>> &candSets);
+    void compColls(const std::vector<std::pair<int, int>> &candPairs);
     void compColls();
+    void compCandColl(const SitePtr &site1, const SitePtr &site2,
+            const TimeIval &timeIval, std::vector<EvPtr> &evs);
     void compColl(const SitePtr &site1, const SitePtr &site2);
     void run();
-
-    void handleEv(const std::shared_ptr<CollEv> &collEv);
+    void runSpeculative(size_t nThreads);
+    bool popGroup(std::vector<EvPtr> &evs);
+    std::vector<int> touchedSites(const std::vector<EvPtr> &evs) const;
+    bool isLaterThan(const EvPtr &ev, const std::vector<EvPtr> &evs) const;
+    void saveState(EvLog &log, const std::vector<int> &siteIds) const;
+    void commit(const EvLog &log);
+    void rollBack(const EvLog &log);
+    int & cnt(int &counter) const;
+    void handleGroup(const std::vector<EvPtr> &evs);
+    void checkCkpt(size_t nEvs);
+    bool writeCkpt(const std::string &filePath) const;
+    bool readCkpt(const std::string &filePath, const std::vector<SiteData> &siteData);
+
+    void handleEv(const std::shared_ptr<CollEv> &collEv,
+            const std::vector<EvPtr> &evs);
     bool isValidCollEv(const std::shared_ptr<CollEv> &collEv1,
             const std::shared_ptr<CollEv> &collEv2) const;
     bool isValidDomEv(const std::shared_ptr<DomEv> &domEv1,
@@ -221,10 +630,12 @@ private:
     void processEv(const std::shared_ptr<CollEv> &collEv, bool bDom,
             bool bIsValid, bool bPierces);
 
-    void handleEv(const std::shared_ptr<DomEv> &domEv);
+    void handleEv(const std::shared_ptr<DomEv> &domEv,
+            const std::vector<EvPtr> &evs);
     void processEv(const std::shared_ptr<DomEv> &domEv, bool bDom);
 
-    void handleEv(const std::shared_ptr<EdgeEv> &edgeEv);
+    void handleEv(const std::shared_ptr<EdgeEv> &edgeEv,
+            const std::vector<EvPtr> &evs);
     bool deleteLowestArc(const std::shared_ptr<EdgeEv> &edgeEv,
             const SitePtr &lowSite, const SitePtr &medSite, const SitePtr &highSite);
 
@@ -237,21 +648,77 @@ private:
             const MovIsectPtr &isect, bool bLeft);
     void checkEdgeEv(const OffCircPtr &offCirc, const Root_of_2 &t,
             const MovIsectPtr &isect, const MovIsectPtr &other);
-    void compVorEdges();
-    void writeToIpe(const std::string &filePath) const;
+    void stampSwitches(const EvPtr &ev, std::initializer_list<MovIsectPtr> isects);
+    int vertAt(const EvPtr &ev);
+    bool hasEqualWeights() const;
+    void compLinear();
+    void compVorEdges(BinWriter *binWriter, bool bStoreEdges, size_t nThreads);
+    std::vector<size_t> compVertDegs() const;
+    void extractLineEdges(EdgeBatch &batch, bool bBin, bool bStoreEdges) const;
+    void extractEdges(EdgeBatch &batch, const MovIsectPtr &isect,
+            bool bBin, bool bStoreEdges) const;
+    std::vector<std::pair<Circular_arc_point_2, Circular_arc_point_2>>
+    clipArc(const Circle_2 &circ, const Circular_arc_point_2 &source,
+            const Circular_arc_point_2 &target, const CGAL::Bbox_2 &box,
+            const std::vector<Line_2> &sides, bool bInside = true) const;
+    std::vector<std::pair<Circular_arc_point_2, Circular_arc_point_2>>
+    clipSeg(const Line_2 &line, const Circular_arc_point_2 &start,
+            const Circular_arc_point_2 &end, const CGAL::Bbox_2 &box,
+            const std::vector<Line_2> &sides, bool bInside = true) const;
+    void compVorDcel();
+    void writeSnapshotsToIpe(const std::string &filePath,
+            const std::vector<double> &times) const;
     void writeToCsv(const std::string &filePath, long long runtime,
             long long overlayDuration, long long eventDuration,
             size_t maxCandSetSize, size_t nCandSets, size_t avgSize) const;
     
+    void pushEv(const EvPtr &ev);
+    bool isBeyondMaxTime(const SitePtr &site1, const SitePtr &site2) const;
     void storeEv(const EvPtr &ev);
 
-    std::priority_queue<EvPtr, std::vector<EvPtr>, EvPtrComp> m_queue;
+    VorDiagOpts m_opts;
+    EvQueue m_queue;
     std::map<std::pair<int, int>, BisecPtr> m_bisecs;
     std::map<int, OffCircPtr> m_offCircs;
     std::vector<SitePtr> m_sites;
     std::map<MovIsectId, MovIsectPtr> m_isects;
     std::vector<Circular_arc_2> m_vorEdges;
     std::vector<Line_arc_2> m_vorSegs;
+    mutable std::vector<EdgeInfo> m_vorEdgeInfos;
+    mutable std::vector<EdgeInfo> m_vorSegInfos;
+    mutable std::vector<VorVert> m_vorVerts;
+    // The edges of the diagram if it has been computed by compLinear().
+    bool m_bIsLinear{false};
+    std::vector<LineEdge> m_lineEdges;
+    mutable VorDcel m_dcel;
+    // Set by the updates if the vertices and the DCEL have to be rebuilt
+    // from the edges (see rebuildTopology()).
+    mutable bool m_bIsTopoStale{false};
+    // The indices of the updates, which are built by the first update (see
+    // prepareUpdates()): the positions of the sites in m_sites, the stored
+    // edges of every site, a uniform grid of the sites with cells of size
+    // m_gridSize, and the weights of the sites.
+    bool m_bIsPrepared{false};
+    // Set by a local repair, which drops the bisectors and the moving
+    // intersections. Hence, the edges cannot be extracted again, and neither
+    // the wavefronts nor a checkpoint can be written.
+    bool m_bIsRepaired{false};
+    std::unordered_map<int, size_t> m_sitePos;
+    std::unordered_map<int, std::vector<size_t>> m_siteArcs;
+    std::unordered_map<int, std::vector<size_t>> m_siteSegs;
+    double m_gridSize{1.};
+    std::unordered_map<long long, std::vector<int>> m_siteGrid;
+    std::multiset<int> m_weights;
+    // The sweep stops at the maximum time (if bounded), which is the given
+    // maximum time or the time at which the wavefront has swept over the
+    // clip box.
+    bool m_bIsBounded{false};
+    Root_of_2 m_maxSqrdTime{0};
+    std::vector<WfArc> m_wavefront;
+    // The clip box and the lines through its sides.
+    bool m_bClip{false};
+    CGAL::Bbox_2 m_clipBox;
+    std::vector<Line_2> m_clipLines;
     // Used for logging:
     int m_collEvCnt{0};
     int m_invalidCollEvCnt{0};
@@ -259,17 +726,42 @@ private:
     int m_invalidDomEvCnt{0};
     int m_edgeEvCnt{0};
     int m_invalidEdgeEvCnt{0};
-    int m_nVorVerts{0};
+    mutable int m_nVorVerts{0};
 #ifdef ENABLE_VIEW
     std::vector<EvPtr> m_evs;
 #endif
+    // The number of events and the time since the last checkpoint.
+    size_t m_nCkptEvs{0};
+    std::chrono::steady_clock::time_point m_ckptTime;
+    // The log of the group that the current thread handles speculatively
+    // (none in the serial sweep).
+    static thread_local EvLog *s_evLog;
 };
 
 #ifdef ENABLE_VIEW
 
+// Draws the diagram and the sites as a single item. The edges and the sites
+// are stored in a uniform grid, such that only those that intersect the
+// exposed rectangle are drawn. The arcs are approximated by polylines whose
+// resolution depends on the zoom level; the polylines are cached until the
+// zoom level changes. The diagram must outlive the item.
 class VorDiagGraphicsItem : public CGAL::Qt::GraphicsItem {
     Q_OBJECT
 
+    // An edge in double precision, i.e., a segment from p1 to p2 (if r is
+    // zero) or an arc around (cx, cy) that starts at angle a1 and spans the
+    // (counterclockwise) angle span.
+    struct ViewEdge {
+        QPointF p1;
+        QPointF p2;
+        double cx;
+        double cy;
+        double r;
+        double a1;
+        double span;
+        QRectF rect;
+    };
+
 public:
     VorDiagGraphicsItem(const VorDiag &vorDiag);
 
@@ -285,6 +777,7 @@ public:
 public slots:
     void modelChanged() override;
     void onToggle(bool bIsVisible);
+    void onToggleSites(bool bIsVisible);
     void onPrevEv(double t);
     void onNextEv(double t);
     void onHideEvPnt();
@@ -292,11 +785,40 @@ public slots:
 signals:
     void timeChanged(double t);
 
+protected:
+    void hoverMoveEvent(QGraphicsSceneHoverEvent *event) override;
+
 private:
-    VorDiag m_vorDiag;
+    void showEv();
+    void buildGrid();
+    bool cellRange(const QRectF &rect, size_t &x1, size_t &y1, size_t &x2,
+            size_t &y2) const;
+    const std::vector<QPointF> & polyline(size_t edge, double scale);
+
+    const VorDiag &m_vorDiag;
     Root_of_2 m_sqrdTime{0};
     QRectF m_boundingRect;
     bool m_bShow{true};
+    bool m_bShowSites{true};
+    std::vector<ViewEdge> m_edges;
+    std::vector<QPointF> m_sitePnts;
+    // The grid and the edges/sites of its cells in compressed form.
+    QRectF m_gridRect;
+    size_t m_nx{1};
+    size_t m_ny{1};
+    std::vector<size_t> m_edgeOffsets;
+    std::vector<size_t> m_cellEdges;
+    std::vector<size_t> m_siteOffsets;
+    std::vector<size_t> m_cellSites;
+    // Marks the edges that have been drawn in the current paint() call.
+    std::vector<size_t> m_stamps;
+    size_t m_paintCnt{0};
+    // The cached polylines of the arcs at the current zoom level.
+    int m_lodLevel{0};
+    std::vector<std::vector<QPointF>> m_polylines;
+    double m_pickRadius{0.};
+    // The (squared) times of the events for binary searches.
+    std::vector<double> m_evSqrdTimes;
     size_t m_evIndex{0};
     Circular_arc_point_2 m_evPnt;
     double m_time{0.};
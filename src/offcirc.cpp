@@ -2,12 +2,17 @@
 #include <iomanip>
 #include <cmath>
 #include <algorithm>
+#include <iterator>
 #include "log.h"
 #include "offcirc.h"
 #include "util.h"
 
-OffCirc::OffCirc(const SitePtr &site)
+// The number of recorded actions between two keyframes.
+const size_t KEYFRAME_STEP = 64;
+
+OffCirc::OffCirc(const SitePtr &site, bool bRecord)
 : m_site{site}
+, m_bRecord{bRecord}
 {
 }
 
@@ -99,10 +104,7 @@ void OffCirc::writeArcsToIpe(IpeWriter &iw, const Root_of_2 &maxTime,
                         const auto pntSite
                                 = std::static_pointer_cast<PntSite>(m_site);
                         const auto circ = pntSite->growOffAt(time);
-                        iw.addIpeObj(IpeObj{circ,
-                                     fLayer(bIsEv ? 2 : 0),
-                                     scale,
-                                     "blue"});
+                        iw.add(circ, fLayer(bIsEv ? 2 : 0), scale, "blue");
                     }
                 }
 
@@ -137,20 +139,14 @@ void OffCirc::writeArcsToIpe(IpeWriter &iw, const Root_of_2 &maxTime,
                                 = std::static_pointer_cast<PntSite>(m_site);
                         const auto circ = pntSite->growOffAt(time);
                         const auto arc = Circular_arc_2{circ, pnt1, pnt2};
-                        iw.addIpeObj(IpeObj{arc,
-                                            fLayer(bIsEv ? 2 : (bIsOnWf ? 0 : 1)),
-                                            scale,
-                                            bIsOnWf ? "blue" : "orange"});
+                        iw.add(arc, fLayer(bIsEv ? 2 : (bIsOnWf ? 0 : 1)),
+                               scale, bIsOnWf ? "blue" : "orange");
                     }
 
-                    iw.addIpeObj(IpeObj{pnt1,
-                                        fLayer(bIsEv ? 2 : (bIsWfVert1 ? 0 : 1)),
-                                        scale,
-                                        bIsWfVert1 ? "blue" : "orange"});
-                    iw.addIpeObj(IpeObj{pnt2,
-                                        fLayer(bIsEv ? 2 : (bIsWfVert2 ? 0 : 1)),
-                                        scale,
-                                        bIsWfVert2 ? "blue" : "orange"});
+                    iw.add(pnt1, fLayer(bIsEv ? 2 : (bIsWfVert1 ? 0 : 1)),
+                           scale, bIsWfVert1 ? "blue" : "orange");
+                    iw.add(pnt2, fLayer(bIsEv ? 2 : (bIsWfVert2 ? 0 : 1)),
+                           scale, bIsWfVert2 ? "blue" : "orange");
                 }
                 
                 bIsEv ? i2++ : i1++;
@@ -202,6 +198,60 @@ bool OffCirc::neighbor(MovIsectPtr &neighbor, const MovIsectPtr &isect,
     return false;
 }
 
+void OffCirc::restore(bool bIsActive, const Root_of_2 &domSqrdTime, ArcStates arcs,
+                      std::map<MovIsectId, MovIsectPtr> isects,
+                      std::map<MovIsectId, MovIsectId> lefts,
+                      std::map<MovIsectId, MovIsectId> rights) {
+    CGAL_assertion(!m_bRecord);
+    m_bIsActive = bIsActive;
+    m_domSqrdTime = domSqrdTime;
+    m_arcs = std::move(arcs);
+    m_isects = std::move(isects);
+    m_lefts = std::move(lefts);
+    m_rights = std::move(rights);
+}
+
+// Saves the entry of the key (or that it does not exist), unless it has been
+// saved before.
+template <class Map, class Saved>
+static void saveEntry(const Map &map, const typename Map::key_type &key,
+                      Saved &saved) {
+    if (saved.find(key) == saved.end()) {
+        const auto it = map.find(key);
+        saved.emplace(key, it != map.end()
+                           ? std::make_pair(true, it->second)
+                           : std::make_pair(false, typename Map::mapped_type{}));
+    }
+}
+
+template <class Map, class Saved>
+static void restoreEntries(Map &map, const Saved &saved) {
+    for (const auto &val : saved) {
+        if (val.second.first) {
+            map[val.first] = val.second.second;
+        } else {
+            map.erase(val.first);
+        }
+    }
+}
+
+void OffCirc::attachUndo(OffCircUndo &undo) {
+    CGAL_assertion(!m_bRecord);
+    undo.bIsActive = m_bIsActive;
+    undo.domSqrdTime = m_domSqrdTime;
+    m_undo = &undo;
+}
+
+void OffCirc::restore(const OffCircUndo &undo) {
+    CGAL_assertion(!m_undo);
+    m_bIsActive = undo.bIsActive;
+    m_domSqrdTime = undo.domSqrdTime;
+    restoreEntries(m_arcs, undo.arcs);
+    restoreEntries(m_isects, undo.isects);
+    restoreEntries(m_lefts, undo.lefts);
+    restoreEntries(m_rights, undo.rights);
+}
+
 void OffCirc::spawnArc(const Root_of_2 &sqrdTime, const MovIsectPtr &isect1,
                        const MovIsectPtr &isect2, bool bIsActive, bool bPierces) {
 #ifdef ENABLE_LOGGING
@@ -324,12 +374,14 @@ bool OffCirc::deleteArc(std::pair<MovIsectPtr, MovIsectPtr> &newArc,
             newArc = {left, right};
             bYieldsNewArc = true;
         } else if (inclsArc({from->id(), to->id()}, false)) {
-#ifdef ENABLE_VIEW
-            bool bIsOnWf = m_arcs.at({from->id(), to->id()});
-            m_arcActions.push_back(std::make_tuple(sqrdTime, false,
-                                                   std::make_pair(from->id(), to->id()),
-                                                   bIsOnWf));
-#endif
+            if (m_bRecord) {
+                bool bIsOnWf = m_arcs.at({from->id(), to->id()});
+                m_arcActions.push_back(std::make_tuple(sqrdTime, false,
+                                                       std::make_pair(from->id(), to->id()),
+                                                       bIsOnWf));
+            }
+
+            saveArc({from->id(), to->id()});
             m_arcs.erase(m_arcs.find({from->id(), to->id()}));
         }
     } else {
@@ -338,21 +390,19 @@ bool OffCirc::deleteArc(std::pair<MovIsectPtr, MovIsectPtr> &newArc,
 
         if (m_arcs.empty()) {
             m_bIsActive = bIsActive;
-#ifdef ENABLE_VIEW
             if (!m_bIsActive) {
                 m_domSqrdTime = sqrdTime;
             }
-#endif
         }
     }
 
     if (m_isects.find(from->id()) != m_isects.end()
         && m_isects.find(to->id()) != m_isects.end()) {
         from->setIsWfVert(sqrdTime, false);
-        m_isects.erase(m_isects.find(from->id()));
+        eraseIsect(from->id());
 
         to->setIsWfVert(sqrdTime, false);
-        m_isects.erase(m_isects.find(to->id()));
+        eraseIsect(to->id());
     }
 
 #ifdef ENABLE_LOGGING
@@ -428,17 +478,17 @@ bool OffCirc::collapseArc(const Root_of_2 &sqrdTime,
 
             CGAL_assertion(m_isects.find(from->id()) != m_isects.end());
             if (m_isects.find(from->id()) != m_isects.end()) {
-                m_isects.erase(m_isects.find(from->id()));
+                eraseIsect(from->id());
             }
             
             insertArc(sqrdTime, newArcId, bIsOnWf);
         } else {
             if (m_isects.find(from->id()) != m_isects.end()) {
-                m_isects.erase(m_isects.find(from->id()));
+                eraseIsect(from->id());
             }
             
             if (m_isects.find(to->id()) != m_isects.end()) {
-                m_isects.erase(m_isects.find(to->id()));
+                eraseIsect(to->id());
             }
         }
     }
@@ -567,7 +617,7 @@ bool OffCirc::replaceIsect(const Root_of_2 &sqrdTime,
         if (m_isects.find(oldIsect->id()) != m_isects.end()) {
             bool bIsOnWf = oldIsect->isWfVert();
             
-            m_isects.erase(oldIsect->id());
+            eraseIsect(oldIsect->id());
             insertIsect(newIsect);
 
             if (inclsArc(arcId, true)) {
@@ -642,6 +692,123 @@ bool OffCirc::searchNeighbor(MovIsectPtr &neighbor, const Root_of_2 &sqrdTime,
     return bFound;
 }
 
+std::vector<WfArc> OffCirc::wfArcsAt(const Root_of_2 &sqrdTime) const {
+    std::vector<WfArc> res;
+    if (!m_bIsActive || typeid(*m_site) != typeid(PntSite)) {
+        return res;
+    }
+
+    const auto circ = std::static_pointer_cast<PntSite>(m_site)->growOffAt(sqrdTime);
+    if (m_isects.empty()) {
+        res.push_back(WfArc{m_site, Circular_arc_2{circ}, true});
+        return res;
+    }
+
+    for (const auto &arc : m_arcs) {
+        if (arc.second) {
+            const auto pnt1 = m_isects.at(arc.first.first)->pntAt(sqrdTime),
+                    pnt2 = m_isects.at(arc.first.second)->pntAt(sqrdTime);
+            res.push_back(WfArc{m_site, Circular_arc_2{circ, pnt1, pnt2}, true});
+        }
+    }
+
+    return res;
+}
+
+// The actions are recorded in the order of the events, hence a single pass
+// over the actions restores the arcs at all times. The state at a time
+// includes all actions up to (and including) this time.
+std::vector<std::vector<WfArc>> OffCirc::arcsAt(const std::vector<Root_of_2> &sqrdTimes) const {
+    std::vector<std::vector<WfArc>> res(sqrdTimes.size());
+    if (!m_bRecord || typeid(*m_site) != typeid(PntSite)) {
+        return res;
+    }
+
+    const auto pntSite = std::static_pointer_cast<PntSite>(m_site);
+    ArcStates arcs;
+    size_t step = 0;
+
+    for (size_t i = 0; i < sqrdTimes.size(); i++) {
+        const auto &sqrdTime = sqrdTimes.at(i);
+        CGAL_assertion(i == 0 || sqrdTimes.at(i - 1) <= sqrdTime);
+
+        for (; step < m_arcActions.size()
+               && std::get<0>(m_arcActions.at(step)) <= sqrdTime; step++) {
+            const auto &action = m_arcActions.at(step);
+            if (std::get<1>(action)) {
+                arcs[std::get<2>(action)] = std::get<3>(action);
+            } else {
+                arcs.erase(std::get<2>(action));
+            }
+        }
+
+        const auto circ = pntSite->growOffAt(sqrdTime);
+        if (arcs.empty()) {
+            if (sqrdTime < m_domSqrdTime || m_domSqrdTime < 0) {
+                res.at(i).push_back(WfArc{m_site, Circular_arc_2{circ}, true});
+            }
+
+            continue;
+        }
+
+        for (const auto &arc : arcs) {
+            const auto pnt1 = m_isectHistory.at(arc.first.first)->pntAt(sqrdTime),
+                    pnt2 = m_isectHistory.at(arc.first.second)->pntAt(sqrdTime);
+            res.at(i).push_back(WfArc{m_site, Circular_arc_2{circ, pnt1, pnt2}, arc.second});
+        }
+    }
+
+    return res;
+}
+
+void OffCirc::buildKeyframes() {
+    m_keyframes.clear();
+    ArcStates arcs;
+    m_keyframes.push_back(arcs);
+
+    for (size_t step = 0; step < m_arcActions.size(); step++) {
+        const auto &action = m_arcActions.at(step);
+        if (std::get<1>(action)) {
+            arcs[std::get<2>(action)] = std::get<3>(action);
+        } else {
+            arcs.erase(std::get<2>(action));
+        }
+
+        if ((step + 1) % KEYFRAME_STEP == 0) {
+            m_keyframes.push_back(arcs);
+        }
+    }
+}
+
+// The actions are sorted by time, hence the number of actions up to (and
+// including) the given time is found by a binary search. The replay starts
+// at the last keyframe before.
+ArcStates OffCirc::arcStatesAt(const Root_of_2 &sqrdTime) const {
+    const auto it = std::upper_bound(m_arcActions.begin(), m_arcActions.end(), sqrdTime,
+            [](const Root_of_2 &t, const ArcAction &action) {
+                return t < std::get<0>(action);
+            });
+    size_t nSteps = it - m_arcActions.begin(), step = 0;
+
+    ArcStates arcs;
+    if (!m_keyframes.empty()) {
+        size_t keyframe = std::min(nSteps / KEYFRAME_STEP, m_keyframes.size() - 1);
+        arcs = m_keyframes.at(keyframe);
+        step = keyframe * KEYFRAME_STEP;
+    }
+
+    for (; step < nSteps; step++) {
+        const auto &action = m_arcActions.at(step);
+        if (std::get<1>(action)) {
+            arcs[std::get<2>(action)] = std::get<3>(action);
+        } else {
+            arcs.erase(std::get<2>(action));
+        }
+    }
+
+    return arcs;
+}
+
 bool OffCirc::inclsIsect(const MovIsectPtr &isect) const {
     return m_isects.find(isect->id()) != m_isects.end();
 }
@@ -733,20 +900,18 @@ void OffCirc::insertArc(const Root_of_2 &sqrdTime,
     insertArc(sqrdTime, arcId.first, arcId.second, bIsOnWf);
 }
 
-void OffCirc::insertArc(const Root_of_2 &
-#ifdef ENABLE_VIEW
-                        sqrdTime
-#endif
-                        , const MovIsectId &fromId,
+void OffCirc::insertArc(const Root_of_2 &sqrdTime, const MovIsectId &fromId,
                         const MovIsectId &toId, bool bIsOnWf) {
+    saveArc({fromId, toId});
+    saveNeighbors(fromId, toId);
     m_arcs[{fromId, toId}] = bIsOnWf;
     m_rights[fromId] = toId;
     m_lefts[toId] = fromId;
-#ifdef ENABLE_VIEW
-    m_arcActions.push_back(std::make_tuple(sqrdTime, true, 
-                                           std::make_pair(fromId, toId),
-                                           bIsOnWf));
-#endif
+    if (m_bRecord) {
+        m_arcActions.push_back(std::make_tuple(sqrdTime, true, 
+                                               std::make_pair(fromId, toId),
+                                               bIsOnWf));
+    }
 }
 
 void OffCirc::eraseArc(const Root_of_2 &sqrdTime, 
@@ -755,21 +920,20 @@ void OffCirc::eraseArc(const Root_of_2 &sqrdTime,
     eraseArc(sqrdTime, arcId.first, arcId.second, bAssert);
 }
 
-void OffCirc::eraseArc(const Root_of_2 &
-#ifdef ENABLE_VIEW
-                       sqrdTime
-#endif
-                       , const MovIsectId &fromId, const MovIsectId &toId,
-                       bool bAssert) {
+void OffCirc::eraseArc(const Root_of_2 &sqrdTime, const MovIsectId &fromId,
+                       const MovIsectId &toId, bool bAssert) {
     const auto &arcId = std::make_pair(fromId, toId);
+    saveArc(arcId);
+    saveNeighbors(fromId, toId);
 
     if (inclsArc(arcId, bAssert)) {
-#ifdef ENABLE_VIEW
-        bool bIsOnWf = m_arcs.at(arcId);
-        m_arcActions.push_back(std::make_tuple(sqrdTime, false,
-                                               std::make_pair(fromId, toId),
-                                               bIsOnWf));
-#endif
+        if (m_bRecord) {
+            bool bIsOnWf = m_arcs.at(arcId);
+            m_arcActions.push_back(std::make_tuple(sqrdTime, false,
+                                                   std::make_pair(fromId, toId),
+                                                   bIsOnWf));
+        }
+
         m_arcs.erase(arcId);
     }
     
@@ -791,10 +955,35 @@ void OffCirc::eraseArc(const Root_of_2 &
 }
 
 void OffCirc::insertIsect(const MovIsectPtr &isect) {
+    saveIsect(isect->id());
     m_isects[isect->id()] = isect;
-#ifdef ENABLE_VIEW
-    m_isectHistory[isect->id()] = isect;
-#endif
+    if (m_bRecord) {
+        m_isectHistory[isect->id()] = isect;
+    }
+}
+
+void OffCirc::eraseIsect(const MovIsectId &id) {
+    saveIsect(id);
+    m_isects.erase(id);
+}
+
+void OffCirc::saveArc(const std::pair<MovIsectId, MovIsectId> &arcId) {
+    if (m_undo) {
+        saveEntry(m_arcs, arcId, m_undo->arcs);
+    }
+}
+
+void OffCirc::saveIsect(const MovIsectId &id) {
+    if (m_undo) {
+        saveEntry(m_isects, id, m_undo->isects);
+    }
+}
+
+void OffCirc::saveNeighbors(const MovIsectId &fromId, const MovIsectId &toId) {
+    if (m_undo) {
+        saveEntry(m_rights, fromId, m_undo->rights);
+        saveEntry(m_lefts, toId, m_undo->lefts);
+    }
 }
 
 bool OffCirc::inclsArc(const std::pair<MovIsectId, MovIsectId> &arcId,
@@ -831,20 +1020,28 @@ OffCircGraphicsItem::OffCircGraphicsItem(const OffCircPtr &offCirc)
 , m_center{CGAL::to_double(offCirc->site()->center().x()),
         CGAL::to_double(offCirc->site()->center().y())}
 {
-    for (const auto &isect : m_offCirc->isectHistory()) {
-        m_switches[isect.first] = 0;
-    }
 }
 
 QRectF OffCircGraphicsItem::boundingRect() const {
     return m_boundingRect;
 }
 
+// Returns whether the moving intersection is a vertex of the wavefront after
+// its last switch up to the given time.
+static bool isWfVertAt(const MovIsectPtr &isect, const Root_of_2 &sqrdTime) {
+    const auto &switches = isect->switches();
+    const auto it = std::upper_bound(switches.begin(), switches.end(), sqrdTime,
+            [](const Root_of_2 &t, const std::pair<Root_of_2, bool> &sw) {
+                return t < sw.first;
+            });
+    return it != switches.begin() && std::prev(it)->second;
+}
+
 void OffCircGraphicsItem::paint(QPainter *painter,
                                 const QStyleOptionGraphicsItem *, QWidget *) {
     const auto scale = std::max(painter->worldTransform().m11(), 
                                 painter->worldTransform().m22());
-    const auto ih = m_offCirc->isectHistory();
+    const auto &ih = m_offCirc->isectHistory();
 
     if (m_arcs.empty()
         && (m_sqrdTime < m_offCirc->domSqrdTime()
@@ -863,24 +1060,11 @@ void OffCircGraphicsItem::paint(QPainter *painter,
         bool bIsOnWf = arc.second;
         CGAL_assertion(ih.find(arcId.first) != ih.end()
                        && ih.find(arcId.second) != ih.end());
-        const auto isect1 = ih.at(arcId.first), isect2 = ih.at(arcId.second);
+        const auto &isect1 = ih.at(arcId.first), &isect2 = ih.at(arcId.second);
         const auto &pnt1 = isect1->pntAt(m_sqrdTime),
                 &pnt2 = isect2->pntAt(m_sqrdTime);
-        bool bIsWfVert1 = false, bIsWfVert2 = false;
-
-        if (!m_switches.empty()) {
-            size_t si1 = m_switches.at(isect1->id()),
-                    si2 = m_switches.at(isect2->id());
-            const auto sw1 = isect1->switches(), sw2 = isect2->switches();
-
-            if (si1 > 0) {
-                bIsWfVert1 = sw1.at(si1 - 1).second;
-            }
-
-            if (si2 > 0) {
-                bIsWfVert2 = sw2.at(si2 - 1).second;
-            }
-        }
+        bool bIsWfVert1 = isWfVertAt(isect1, m_sqrdTime),
+                bIsWfVert2 = isWfVertAt(isect2, m_sqrdTime);
 
         if (typeid(*m_offCirc->site()) == typeid(PntSite)) {
             const auto pntSite
@@ -912,10 +1096,10 @@ void OffCircGraphicsItem::onToggle(bool bIsVisible) {
     update();
 }
 
+// The arcs are restored from the keyframes of the offset circle, hence a
+// jump to any time costs the same as a small step.
 void OffCircGraphicsItem::onTimeChanged(double t) {
     const auto sqrdTime = Root_of_2{std::pow(t, 2.)};
-    const auto actions = m_offCirc->arcActions();
-    const auto ih = m_offCirc->isectHistory();
     
     if (sqrdTime <= 0.) {
         m_boundingRect = QRect{};
@@ -923,88 +1107,7 @@ void OffCircGraphicsItem::onTimeChanged(double t) {
         return;
     }
     
-    if (m_sqrdTime < sqrdTime && m_step < actions.size()) {
-        auto nextAction = actions.at(m_step);
-        auto nextSqrdTime = std::get<0>(nextAction);
-        bool bFinished = false;
-            
-        while (nextSqrdTime < sqrdTime && !bFinished) {
-            bool bInsert = std::get<1>(nextAction);
-            const auto arcId = std::get<2>(nextAction);
-            const auto isect1 = ih.at(arcId.first), isect2 = ih.at(arcId.second);
-            size_t si1 = m_switches.at(isect1->id()),
-                    si2 = m_switches.at(isect2->id());
-            
-            if (si1 < isect1->switches().size() - 1) {
-                const auto nsw = isect1->switches().at(si1);
-                if (nsw.first < sqrdTime) {
-                    m_switches[isect1->id()] = si1 + 1;
-                }
-            }
-            
-            if (si2 < isect2->switches().size() - 1) {
-                const auto nsw = isect2->switches().at(si2);
-                if (nsw.first < sqrdTime) {
-                    m_switches[isect2->id()] = si2 + 1;
-                }
-            }
-            
-            if (bInsert) {
-                m_arcs[arcId] = std::get<3>(nextAction);
-            } else if (m_arcs.find(arcId) != m_arcs.end()) {
-                m_arcs.erase(m_arcs.find(arcId));
-            }
-
-            if (m_step + 1 < actions.size()) {
-                nextAction = actions.at(++m_step);
-                nextSqrdTime = std::get<0>(nextAction);
-            } else {
-                ++m_step;
-                bFinished = true;
-            }
-        }
-    } else if (m_sqrdTime > sqrdTime && 0 < m_step) {
-        auto prevAction = actions.at(m_step - 1);
-        auto prevSqrdTime = std::get<0>(prevAction);
-        bool bFinished = false;
-
-        while (prevSqrdTime > sqrdTime && !bFinished) {
-            bool bInsert = std::get<1>(prevAction);
-            const auto arcId = std::get<2>(prevAction);
-            const auto isect1 = ih.at(arcId.first), isect2 = ih.at(arcId.second);
-            int si1 = m_switches.at(isect1->id()),
-                    si2 = m_switches.at(isect2->id());
-            
-            if (si1 > 0) {
-                const auto psw = isect1->switches().at(si1 - 1);
-                if (psw.first > sqrdTime) {
-                    m_switches[isect1->id()] = si1 - 1;
-                }
-            }
-            
-            if (si2 > 0) {
-                const auto psw = isect2->switches().at(si2 - 1);
-                if (psw.first > sqrdTime) {
-                    m_switches[isect2->id()] = si2 - 1;
-                }
-            }
-
-            if (!bInsert) {
-                m_arcs[arcId] = std::get<3>(prevAction);
-            } else if (m_arcs.find(arcId) != m_arcs.end()) {
-                m_arcs.erase(m_arcs.find(arcId));
-            }
-            
-            if (m_step - 1 > 0) {
-                prevAction = actions.at((--m_step) - 1);
-                prevSqrdTime = std::get<0>(prevAction);
-            } else {
-                --m_step;
-                bFinished = true;
-            }
-        }
-    }
-
+    m_arcs = m_offCirc->arcStatesAt(sqrdTime);
     m_bIncreased = m_sqrdTime > sqrdTime;
     m_sqrdTime = sqrdTime;
     prepareGeometryChange();
@@ -11,10 +11,37 @@ class OffCirc;
 using OffCircPtr = std::shared_ptr<OffCirc>;
 using ArcAction 
         = std::tuple<Root_of_2, bool, std::pair<MovIsectId, MovIsectId>, bool>;
+// The arcs of an offset circle (by their moving intersections) and whether
+// they belong to the wavefront.
+using ArcStates = std::map<std::pair<MovIsectId, MovIsectId>, bool>;
+
+// The previous entries of an offset circle that a group of events has
+// changed, such that they can be restored (see VorDiag::runSpeculative()).
+// Every entry is saved before its first change, together with whether it
+// existed.
+struct OffCircUndo {
+    bool bIsActive;
+    Root_of_2 domSqrdTime;
+    std::map<std::pair<MovIsectId, MovIsectId>, std::pair<bool, bool>> arcs;
+    std::map<MovIsectId, std::pair<bool, MovIsectPtr>> isects;
+    std::map<MovIsectId, std::pair<bool, MovIsectId>> lefts;
+    std::map<MovIsectId, std::pair<bool, MovIsectId>> rights;
+};
+
+// An active arc of the offset circle of site. It belongs to the wavefront if
+// bIsOnWf is set, i.e., if it is not overtaken by any other offset circle.
+// Full circles are represented by full arcs.
+struct WfArc {
+    SitePtr site;
+    Circular_arc_2 arc;
+    bool bIsOnWf;
+};
 
 class OffCirc {
 public:
-    OffCirc(const SitePtr &site);
+    // If bRecord is set, then all changes of the arcs are recorded, such
+    // that the arcs can be restored at any time after the sweep.
+    OffCirc(const SitePtr &site, bool bRecord = false);
 
     bool isActive() const {
         return m_bIsActive;
@@ -32,7 +59,18 @@ public:
         return m_isects;
     }
 
-#ifdef ENABLE_VIEW
+    const std::map<MovIsectId, MovIsectId> & lefts() const {
+        return m_lefts;
+    }
+
+    const std::map<MovIsectId, MovIsectId> & rights() const {
+        return m_rights;
+    }
+
+    bool isRecording() const {
+        return m_bRecord;
+    }
+
     const std::vector<ArcAction> & arcActions() const {
         return m_arcActions;
     }
@@ -45,6 +83,7 @@ public:
         return m_domSqrdTime;
     }
 
+#ifdef ENABLE_VIEW
     void writeArcsToIpe(IpeWriter &iw, const Root_of_2 &maxTime,
             const Root_of_2 &timeStep, double scale,
             const std::vector<Root_of_2> &evSqrdTimes) const;
@@ -52,6 +91,22 @@ public:
     
     bool neighbor(MovIsectPtr &neighbor, const MovIsectPtr &isect, bool bLeft) const;
 
+    // Restores the state from a checkpoint of the sweep (without recording).
+    void restore(bool bIsActive, const Root_of_2 &domSqrdTime, ArcStates arcs,
+            std::map<MovIsectId, MovIsectPtr> isects,
+            std::map<MovIsectId, MovIsectId> lefts,
+            std::map<MovIsectId, MovIsectId> rights);
+
+    // Saves the entries into undo before they are changed, until
+    // detachUndo() is called. Only the thread that changes the offset circle
+    // may access undo.
+    void attachUndo(OffCircUndo &undo);
+    void detachUndo() {
+        m_undo = nullptr;
+    }
+    // Restores the entries saved by the undo (which must be detached).
+    void restore(const OffCircUndo &undo);
+
     void spawnArc(const Root_of_2 &sqrdTime, const MovIsectPtr &isect1, const MovIsectPtr &isect2,
             bool bIsActive, bool bPierces = false);
     bool deleteArc(std::pair<MovIsectPtr, MovIsectPtr> &newArc, const Root_of_2 &sqrdTime,
@@ -73,6 +128,18 @@ public:
     bool searchNeighbor(MovIsectPtr &neighbor, const Root_of_2 &sqrdTime,
             const Circular_arc_point_2 &pnt, bool bLeft) const;
 
+    // Returns the arcs of the offset circle that belong to the wavefront at
+    // the given time, which must not precede the last processed event.
+    std::vector<WfArc> wfArcsAt(const Root_of_2 &sqrdTime) const;
+    // Restores the active arcs at each of the given (ascending) times from
+    // the recorded history in a single pass.
+    std::vector<std::vector<WfArc>> arcsAt(const std::vector<Root_of_2> &sqrdTimes) const;
+    // Stores the arcs after every KEYFRAME_STEP recorded actions, such that
+    // arcStatesAt() replays only the actions since the last keyframe.
+    void buildKeyframes();
+    // Returns the arcs at the given time from the recorded history.
+    ArcStates arcStatesAt(const Root_of_2 &sqrdTime) const;
+
     bool inclsIsect(const MovIsectPtr &isect) const;
     bool isInActiveArc(const Root_of_2 &sqrdTime,
             const Circular_arc_point_2 &pnt) const;
@@ -96,6 +163,11 @@ private:
             const MovIsectId &toId, bool bAssert = true);
 
     void insertIsect(const MovIsectPtr &isect);
+    void eraseIsect(const MovIsectId &id);
+
+    void saveArc(const std::pair<MovIsectId, MovIsectId> &arcId);
+    void saveIsect(const MovIsectId &id);
+    void saveNeighbors(const MovIsectId &fromId, const MovIsectId &toId);
     
     bool inclsArc(const std::pair<MovIsectId, MovIsectId> &arcId,
             bool bAssert) const;
@@ -107,11 +179,12 @@ private:
     // Stores the left and right neighbor of a moving intersection.
     std::map<MovIsectId, MovIsectId> m_lefts;
     std::map<MovIsectId, MovIsectId> m_rights;
-#ifdef ENABLE_VIEW
+    bool m_bRecord{false};
     std::vector<ArcAction> m_arcActions;
     std::map<MovIsectId, MovIsectPtr> m_isectHistory;
     Root_of_2 m_domSqrdTime{-1};
-#endif
+    std::vector<ArcStates> m_keyframes;
+    OffCircUndo *m_undo{nullptr};
 };
 
 #ifdef ENABLE_VIEW
@@ -139,9 +212,7 @@ private:
     QPointF m_center;
     Root_of_2 m_sqrdTime{0};
     QRectF m_boundingRect;
-    size_t m_step{0};
-    std::map<std::pair<MovIsectId, MovIsectId>, bool> m_arcs;
-    std::map<MovIsectId, size_t> m_switches;
+    ArcStates m_arcs;
     bool m_bIncreased{false};
     bool m_bIsVisible{true};
 };
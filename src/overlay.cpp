@@ -1,8 +1,15 @@
 #include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <deque>
 #include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
 #include <regex>
+#include <sstream>
 #include <math.h>
 #ifdef ENABLE_VIEW
 #include <QString>
@@ -18,69 +25,240 @@ std::set<int> Overlay::OverlayLabel::operator()(const std::set<int> &lhs,
     return res;
 }
 
-Overlay::Overlay(const std::string &filePath) {
-    std::cout << "Computing overlay arrangement ...\n";
-    readInput(filePath);
+// The number of overlays that are kept in memory.
+const size_t OVERLAY_CACHE_SIZE = 4;
+
+// An overlay in the cache, where the coordinates rule out hash collisions.
+struct CachedOverlay {
+    uint64_t key;
+    std::vector<std::pair<int, int>> pnts;
+    std::vector<uint64_t> classSizes;
+    std::shared_ptr<const std::vector<std::set<int>>> candSets;
+};
+
+// The header of a cache file, which is incremented whenever the format
+// changes.
+const char OVL_MAGIC[4] = {'W', 'O', 'V', 'L'};
+const uint32_t OVL_VERSION = 2;
+
+// The most recently used overlays come first.
+static std::deque<CachedOverlay> overlayCache;
+static std::mutex overlayCacheMutex;
+
+Overlay::Overlay(const std::string &filePath, const std::string &cacheDir, bool bByClass)
+: Overlay{FileReader{filePath}.sites(), cacheDir, bByClass}
+{
+}
+
+Overlay::Overlay(const std::vector<SiteData> &sites, const std::string &cacheDir,
+                 bool bByClass) {
+    setSites(sites, bByClass);
     
     std::chrono::high_resolution_clock::time_point t0 =
             std::chrono::high_resolution_clock::now();
-    compOverlay();
+    if (loadCandSets(cacheDir)) {
+        std::cout << "Using cached overlay arrangement ...\n";
+        m_bIsCached = true;
+        compStats();
+    } else {
+        std::cout << (bByClass ? "Computing the neighbors within the classes ...\n"
+                      : "Computing overlay arrangement ...\n");
+        compOverlay();
+        storeCandSets(cacheDir);
+    }
+
     std::chrono::high_resolution_clock::time_point t1 =
             std::chrono::high_resolution_clock::now();
     m_duration = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
 }
 
-void Overlay::readInput(const std::string &filePath) {
-    /*std::ifstream file;
-    file.open(filePath, std::ifstream::in);
-
-    const auto fSplit
-            = [](const std::string &str, const std::regex &re) {
-                return std::vector<std::string>{std::sregex_token_iterator(str.begin(), str.end(), re, -1),
-                                                std::sregex_token_iterator()};
-            };*/
-
-    const auto fComp
-            = [](const std::tuple<int, int, int> &lhs,
-                 const std::tuple<int, int, int> &rhs) {
-                if (std::get<2>(lhs) != std::get<2>(rhs)) {
-                    return std::get<2>(lhs) > std::get<2>(rhs);
-                }
-                
-                return std::pow(std::get<0>(lhs), 2.) + std::pow(std::get<1>(lhs), 2.)
-                        > std::pow(std::get<0>(rhs), 2.) + std::pow(std::get<1>(rhs), 2.);
-            };
-    std::multiset<std::tuple<int, int, int>, decltype(fComp)> temps(fComp);
+// The sites are sorted in the same way as in VorDiag, such that the indices
+// of the candidate sets refer to the same sites. The key is the FNV-1a hash
+// of the sorted coordinates, followed by the sizes of the classes.
+void Overlay::setSites(std::vector<SiteData> sites, bool bByClass) {
+    sortSites(sites);
 
-    /*if (file.is_open()) {
-        std::string line;
-        while (std::getline(file, line)) {
-            const auto strs = fSplit(line, std::regex("\\s+"));
-            CGAL_assertion(strs.size() == 3);
-#ifdef ENABLE_VIEW
-            int x = QString::fromStdString(strs.at(0)).toInt(),
-                    y = QString::fromStdString(strs.at(1)).toInt(),
-                    w = QString::fromStdString(strs.at(2)).toInt();
-#else
-            int x = std::stoi(strs.at(0)),
-                    y = std::stoi(strs.at(1)),
-                    w = std::stoi(strs.at(2));
-#endif
-            temps.insert(std::make_tuple(x, y, w));
+    m_key = 14695981039346656037ull;
+    const auto fHash = [this](int val) {
+        auto uval = static_cast<uint32_t>(val);
+        for (int i = 0; i < 4; i++) {
+            m_key ^= (uval >> (8 * i)) & 0xff;
+            m_key *= 1099511628211ull;
         }
-    }*/
-    
-    const auto fr = FileReader{filePath};
+    };
+
+    for (size_t i = 0; i < sites.size(); i++) {
+        int x = std::get<0>(sites[i]), y = std::get<1>(sites[i]);
+        m_sites.push_back(Point_2{x, y});
+        m_pnts.emplace_back(x, y);
+        fHash(x);
+        fHash(y);
+
+        if (bByClass) {
+            if (i == 0 || std::get<2>(sites[i]) != std::get<2>(sites[i - 1])) {
+                m_classSizes.push_back(0);
+            }
 
-    for (const auto &s : fr.sites()) {
-        int x = std::get<0>(s), y = std::get<1>(s), w = std::get<2>(s);
-        temps.insert(std::make_tuple(x, y, w));
+            m_classSizes.back()++;
+        }
     }
 
-    for (const auto temp : temps) {
-        int x = std::get<0>(temp), y = std::get<1>(temp);
-        m_sites.push_back(Point_2{x, y});
+    for (auto size : m_classSizes) {
+        fHash(static_cast<int>(size));
+    }
+}
+
+bool Overlay::loadCandSets(const std::string &cacheDir) {
+    {
+        std::lock_guard<std::mutex> lock{overlayCacheMutex};
+        for (auto it = overlayCache.begin(); it != overlayCache.end(); ++it) {
+            if (it->key == m_key && it->pnts == m_pnts && it->classSizes == m_classSizes) {
+                const auto cached = *it;
+                m_candSets = *cached.candSets;
+                overlayCache.erase(it);
+                overlayCache.push_front(cached);
+                return true;
+            }
+        }
+    }
+
+    if (cacheDir.empty()) {
+        return false;
+    }
+
+    std::ifstream file{cacheFilePath(cacheDir), std::ifstream::binary};
+    if (!file.is_open()) {
+        return false;
+    }
+
+    const auto fRead = [&file](auto &val) {
+        file.read(reinterpret_cast<char *>(&val), sizeof(val));
+        return file.good();
+    };
+
+    char magic[4];
+    uint32_t version = 0;
+    if (!file.read(magic, sizeof(magic))
+            || !std::equal(magic, magic + sizeof(magic), OVL_MAGIC)
+            || !fRead(version) || version != OVL_VERSION) {
+        return false;
+    }
+
+    uint64_t nPnts = 0, nCandSets = 0;
+    if (!fRead(nPnts) || nPnts != m_pnts.size()) {
+        return false;
+    }
+
+    for (const auto &pnt : m_pnts) {
+        int32_t x, y;
+        if (!fRead(x) || !fRead(y) || x != pnt.first || y != pnt.second) {
+            return false;
+        }
+    }
+
+    for (auto size : m_classSizes) {
+        uint64_t classSize;
+        if (!fRead(classSize) || classSize != size) {
+            return false;
+        }
+    }
+
+    if (!fRead(nCandSets)) {
+        return false;
+    }
+
+    std::vector<std::set<int>> candSets(nCandSets);
+    for (auto &candSet : candSets) {
+        uint64_t size = 0;
+        if (!fRead(size)) {
+            return false;
+        }
+
+        for (uint64_t i = 0; i < size; i++) {
+            int32_t index;
+            if (!fRead(index)) {
+                return false;
+            }
+
+            candSet.insert(candSet.end(), index);
+        }
+    }
+
+    m_candSets = std::move(candSets);
+    std::lock_guard<std::mutex> lock{overlayCacheMutex};
+    overlayCache.push_front(CachedOverlay{m_key, m_pnts, m_classSizes,
+            std::make_shared<const std::vector<std::set<int>>>(m_candSets)});
+    if (overlayCache.size() > OVERLAY_CACHE_SIZE) {
+        overlayCache.pop_back();
     }
+
+    return true;
+}
+
+// A cache file consists of a header (see OVL_MAGIC), the number of sites,
+// their coordinates, the sizes of the classes (if any) and the candidate
+// sets, each of which is given by its size and its indices. Like a
+// checkpoint, the file is written to a temporary file first and renamed
+// afterwards, such that an interrupted write never leaves a truncated file.
+void Overlay::storeCandSets(const std::string &cacheDir) const {
+    {
+        std::lock_guard<std::mutex> lock{overlayCacheMutex};
+        overlayCache.push_front(CachedOverlay{m_key, m_pnts, m_classSizes,
+                std::make_shared<const std::vector<std::set<int>>>(m_candSets)});
+        if (overlayCache.size() > OVERLAY_CACHE_SIZE) {
+            overlayCache.pop_back();
+        }
+    }
+
+    if (cacheDir.empty()) {
+        return;
+    }
+
+    const auto filePath = cacheFilePath(cacheDir), tmpFilePath = filePath + ".tmp";
+    std::ofstream file{tmpFilePath,
+            std::ofstream::out | std::ofstream::trunc | std::ofstream::binary};
+    if (!file.is_open()) {
+        std::cout << "Cannot write to the overlay cache " << cacheDir << ".\n";
+        return;
+    }
+
+    file.write(OVL_MAGIC, sizeof(OVL_MAGIC));
+
+    const auto fWrite = [&file](auto val) {
+        file.write(reinterpret_cast<const char *>(&val), sizeof(val));
+    };
+
+    fWrite(OVL_VERSION);
+    fWrite(static_cast<uint64_t>(m_pnts.size()));
+    for (const auto &pnt : m_pnts) {
+        fWrite(static_cast<int32_t>(pnt.first));
+        fWrite(static_cast<int32_t>(pnt.second));
+    }
+
+    for (auto size : m_classSizes) {
+        fWrite(size);
+    }
+
+    fWrite(static_cast<uint64_t>(m_candSets.size()));
+    for (const auto &candSet : m_candSets) {
+        fWrite(static_cast<uint64_t>(candSet.size()));
+        for (int index : candSet) {
+            fWrite(static_cast<int32_t>(index));
+        }
+    }
+
+    file.close();
+    if (file.fail() || std::rename(tmpFilePath.c_str(), filePath.c_str()) != 0) {
+        std::cout << "Cannot write to the overlay cache " << cacheDir << ".\n";
+        std::remove(tmpFilePath.c_str());
+    }
+}
+
+std::string Overlay::cacheFilePath(const std::string &cacheDir) const {
+    std::ostringstream strs;
+    strs << cacheDir << "/" << std::hex << std::setw(16) << std::setfill('0')
+            << m_key << ".ovl";
+    return strs.str();
 }
 
 void Overlay::compOverlay() {
@@ -136,45 +314,84 @@ void Overlay::compOverlay() {
     vd.insert(Point_2{std::numeric_limits<int>::min(),
               std::numeric_limits<int>::min()});
               
-    for (const auto &site : m_sites) {
-        const auto face = vd.insert(site);
-        Arrangement_2 arr;
-        const auto hcStart = face->ccb();
-        auto hc = hcStart;
-        
-        do {
-            CGAL_assertion(hc->has_source() && hc->has_target());
-            const auto pnt1 = hc->source()->point(),
-                    pnt2 = hc->target()->point();
-            insert_non_intersecting_curve(arr, Segment_2{pnt1, pnt2});
-        } while (++hc != hcStart);
+    // The sites of a class are inserted first, then their cells are taken
+    // (without classes, every site is a class of its own). With classes, only
+    // the neighbors within a class are taken, and no arrangement is built.
+    std::map<VD::Delaunay_vertex_handle, int> indices;
+    std::vector<std::set<int>> classPairs;
+    size_t nClasses = m_classSizes.empty() ? m_sites.size() : m_classSizes.size();
+    for (size_t c = 0; c < nClasses; c++) {
+        int end = i + (m_classSizes.empty() ? 1 : static_cast<int>(m_classSizes[c]));
+        std::vector<VD::Delaunay_vertex_handle> verts;
+        for (int j = i; j < end; j++) {
+            verts.push_back(vd.insert(m_sites[j])->dual());
+            indices[verts.back()] = j;
+        }
 
-        Arrangement_2::Face_iterator fit;
-        for (fit = arr.faces_begin(); fit != arr.faces_end(); ++fit) {
-            bool bIsUnbounded = fit == arr.unbounded_face();
-            fit->set_data(std::set<int>{bIsUnbounded ? -1 : i});
+        for (const auto &vert : verts) {
+            const auto face = vd.dual(vert);
+            Arrangement_2 arr;
+            const auto hcStart = face->ccb();
+            auto hc = hcStart;
+
+            do {
+                CGAL_assertion(hc->has_source() && hc->has_target());
+                if (m_classSizes.empty()) {
+                    const auto pnt1 = hc->source()->point(),
+                            pnt2 = hc->target()->point();
+                    insert_non_intersecting_curve(arr, Segment_2{pnt1, pnt2});
+                } else {
+                    // The cells of a class do not overlap, hence the
+                    // neighbors within the class form candidate sets of
+                    // their own.
+                    const auto it = indices.find(hc->opposite()->face()->dual());
+                    if (it != indices.end() && it->second > i && it->second < end) {
+                        classPairs.push_back(std::set<int>{i, it->second});
+                    }
+                }
+            } while (++hc != hcStart);
+
+            if (!m_classSizes.empty()) {
+                i++;
+                continue;
+            }
+
+            Arrangement_2::Face_iterator fit;
+            for (fit = arr.faces_begin(); fit != arr.faces_end(); ++fit) {
+                bool bIsUnbounded = fit == arr.unbounded_face();
+                fit->set_data(std::set<int>{bIsUnbounded ? -1 : i});
+            }
+
+            arrs.push_back(arr);
+            i++;
         }
+    }
+
+    if (m_classSizes.empty()) {
+        fCompOverlay(arrs);
 
-        arrs.push_back(arr);
-        i++;
+        Arrangement_2::Face_iterator fit;
+        for (fit = overlayArr.faces_begin();
+             fit != overlayArr.faces_end(); ++fit) {
+            m_candSets.push_back(fit->data());
+        }
     }
 
-    fCompOverlay(arrs);
+    m_candSets.insert(m_candSets.end(), classPairs.begin(), classPairs.end());
 
-    Arrangement_2::Face_iterator fit;
-    double cumulatedSize = 0.;
-    for (fit = overlayArr.faces_begin();
-         fit != overlayArr.faces_end(); ++fit) {
-        const auto candSet = fit->data();
-        m_candSets.push_back(candSet);
+    compStats();
+}
 
+void Overlay::compStats() {
+    double cumulatedSize = 0.;
+    for (const auto &candSet : m_candSets) {
         cumulatedSize += candSet.size();
         if (candSet.size() > m_maxSize) {
             m_maxSize = candSet.size();
         }
     }
 
-    m_avgSize = std::round(cumulatedSize / m_candSets.size());
+    m_avgSize = m_candSets.empty() ? 0 : std::round(cumulatedSize / m_candSets.size());
     std::cout << "The largest candidate size has size " << m_maxSize << ".\n"
             << "The average candidate size has size " << m_avgSize << ".\n"
             << "There are " << m_candSets.size() << " candidate sets.\n";
@@ -12,6 +12,7 @@
 #include <CGAL/Voronoi_diagram_2.h>
 #include <CGAL/Delaunay_triangulation_adaptation_traits_2.h>
 #include <CGAL/Delaunay_triangulation_adaptation_policies_2.h>
+#include "file_io.h"
 
 class Overlay {
     struct OverlayLabel {
@@ -35,7 +36,24 @@ class Overlay {
     using Site_2 = AT::Site_2;
     
 public:
-    Overlay(const std::string &filePath);
+    // The sites are inserted into the Voronoi diagram in the order of
+    // decreasing weight. A site cannot reach beyond its cell among the sites
+    // of at least its weight, hence the sites whose cells overlap form the
+    // candidate sets. If bByClass is set, the cells are taken after all
+    // sites of the same weight have been inserted, which makes them disjoint
+    // within a class, and only the neighbors within a class are returned as
+    // candidate sets of two sites, without an overlay. The pairs of sites of
+    // different classes are left to the caller (see VorDiag).
+    //
+    // The candidate sets depend only on the coordinates of the sites in the
+    // order of insertion, i.e., sorted by weight, (and on the sizes of the
+    // classes if bByClass is set) but not on the weights themselves. Hence,
+    // they are cached (in memory and, if cacheDir is given, on disk) by a
+    // hash of the sorted coordinates.
+    Overlay(const std::string &filePath, const std::string &cacheDir = "",
+            bool bByClass = false);
+    Overlay(const std::vector<SiteData> &sites, const std::string &cacheDir = "",
+            bool bByClass = false);
 
     const std::vector<std::set<int>> & candSets() const {
         return m_candSets;
@@ -53,12 +71,27 @@ public:
     size_t avgSize() const {
         return m_avgSize;
     }
+
+    bool isCached() const {
+        return m_bIsCached;
+    }
     
 private:
-    void readInput(const std::string &filePath);
+    void setSites(std::vector<SiteData> sites, bool bByClass);
     void compOverlay();
+    void compStats();
+    bool loadCandSets(const std::string &cacheDir);
+    void storeCandSets(const std::string &cacheDir) const;
+    std::string cacheFilePath(const std::string &cacheDir) const;
 
     std::vector<Site_2> m_sites;
+    // The coordinates of the sites in the order of insertion and their hash.
+    std::vector<std::pair<int, int>> m_pnts;
+    // The numbers of sites of equal weight in the order of insertion (empty
+    // if the cells are taken site by site).
+    std::vector<uint64_t> m_classSizes;
+    uint64_t m_key{0};
+    bool m_bIsCached{false};
     std::vector<std::set<int>> m_candSets;
     long long m_duration;
     size_t m_maxSize{0};
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <boost/thread.hpp>
+#include "raster.h"
+#ifdef ENABLE_AVX2
+#include "raster_avx2.h"
+#endif
+
+// The number of sites per block (three arrays of 8 KiB each) and the number
+// of query points per tile.
+const size_t SITE_BLOCK = 1024;
+const size_t PNT_TILE = 256;
+
+NearestSiteKernel::NearestSiteKernel(const std::vector<SitePtr> &sites) {
+    for (const auto &site : sites) {
+        const auto pnt = site->center();
+        addSite(CGAL::to_double(pnt.x()), CGAL::to_double(pnt.y()),
+                CGAL::to_double(site->weight()), site->id());
+    }
+}
+
+NearestSiteKernel::NearestSiteKernel(const std::vector<SiteData> &sites) {
+    for (const auto &s : sites) {
+        addSite(std::get<0>(s), std::get<1>(s), std::get<2>(s), std::get<3>(s));
+    }
+}
+
+double NearestSiteKernel::sqrdDist(double x, double y, size_t index) const {
+    double dx = x - m_xs[index], dy = y - m_ys[index];
+    return (dx * dx + dy * dy) * m_invSqrdWgts[index];
+}
+
+void NearestSiteKernel::nearest(const double *xs, const double *ys, size_t nPnts,
+                                int *indices) const {
+    double minDists[PNT_TILE];
+    for (size_t tile = 0; tile < nPnts; tile += PNT_TILE) {
+        size_t nTilePnts = std::min(PNT_TILE, nPnts - tile);
+        std::fill(minDists, minDists + nTilePnts,
+                  std::numeric_limits<double>::infinity());
+        std::fill(indices + tile, indices + tile + nTilePnts, -1);
+
+        for (size_t begin = 0; begin < m_ids.size(); begin += SITE_BLOCK) {
+            nearestBlock(xs + tile, ys + tile, nTilePnts, begin,
+                         std::min(begin + SITE_BLOCK, m_ids.size()),
+                         minDists, indices + tile);
+        }
+    }
+}
+
+std::vector<int> NearestSiteKernel::nearest(const std::vector<double> &xs,
+                                            const std::vector<double> &ys) const {
+    CGAL_assertion(xs.size() == ys.size());
+    std::vector<int> res(xs.size());
+    nearest(xs.data(), ys.data(), xs.size(), res.data());
+    return res;
+}
+
+RasterBox NearestSiteKernel::bbox() const {
+    if (m_ids.empty()) {
+        return RasterBox{-1., -1., 1., 1.};
+    }
+
+    const auto xs = std::minmax_element(m_xs.begin(), m_xs.end());
+    const auto ys = std::minmax_element(m_ys.begin(), m_ys.end());
+    double dx = std::max(*xs.second - *xs.first, 1.) / 20.,
+            dy = std::max(*ys.second - *ys.first, 1.) / 20.;
+    return RasterBox{*xs.first - dx, *ys.first - dy, *xs.second + dx, *ys.second + dy};
+}
+
+void NearestSiteKernel::addSite(double x, double y, double w, int id) {
+    m_ids.push_back(id);
+    m_xs.push_back(x);
+    m_ys.push_back(y);
+    m_invSqrdWgts.push_back(1. / (w * w));
+}
+
+// Compares the sites [begin, end) with the query points. Since the sites are
+// processed in increasing order and only strictly nearer sites replace the
+// current one, ties are broken towards the lower index.
+void NearestSiteKernel::nearestBlock(const double *xs, const double *ys, size_t nPnts,
+                                     size_t begin, size_t end, double *minDists,
+                                     int *indices) const {
+    size_t q = 0;
+#ifdef ENABLE_AVX2
+    q = nearestBlockAvx2(xs, ys, nPnts, m_xs.data(), m_ys.data(), m_invSqrdWgts.data(),
+                         begin, end, minDists, indices);
+#endif
+
+    for (; q < nPnts; q++) {
+        double best = minDists[q];
+        int bestIndex = indices[q];
+        for (size_t s = begin; s < end; s++) {
+            double dx = xs[q] - m_xs[s], dy = ys[q] - m_ys[s],
+                    dist = (dx * dx + dy * dy) * m_invSqrdWgts[s];
+            if (dist < best) {
+                best = dist;
+                bestIndex = static_cast<int>(s);
+            }
+        }
+
+        minDists[q] = best;
+        indices[q] = bestIndex;
+    }
+}
+
+QueryPnt pixelCenter(const RasterBox &box, size_t width, size_t height,
+                     size_t row, size_t col) {
+    return QueryPnt{box.xMin + (col + .5) * (box.xMax - box.xMin) / width,
+                    box.yMax - (row + .5) * (box.yMax - box.yMin) / height};
+}
+
+std::vector<int> rasterize(const NearestSiteKernel &kernel, const RasterBox &box,
+                           size_t width, size_t height, size_t nThreads) {
+    std::vector<int> labels(width * height, -1);
+    nThreads = std::max<size_t>(1, std::min(nThreads, height));
+
+    const auto fRasterize = [&](size_t i) {
+        std::vector<double> xs(width), ys(width);
+        for (size_t col = 0; col < width; col++) {
+            xs[col] = pixelCenter(box, width, height, 0, col).first;
+        }
+
+        for (size_t row = height * i / nThreads; row < height * (i + 1) / nThreads; row++) {
+            std::fill(ys.begin(), ys.end(), pixelCenter(box, width, height, row, 0).second);
+            kernel.nearest(xs.data(), ys.data(), width, labels.data() + row * width);
+        }
+    };
+
+    if (nThreads == 1) {
+        fRasterize(0);
+    } else {
+        boost::thread_group threads;
+        for (size_t i = 0; i < nThreads; i++) {
+            threads.create_thread([&fRasterize, i]() {
+                fRasterize(i);
+            });
+        }
+
+        threads.join_all();
+    }
+
+    return labels;
+}
+
+bool writeRaster(const std::string &filePath, const NearestSiteKernel &kernel,
+                 const std::vector<int> &labels, size_t width, size_t height) {
+    bool bIsColor = filePath.substr(filePath.find_last_of(".") + 1) == "ppm";
+    std::vector<unsigned char> pixels;
+    pixels.reserve(labels.size() * (bIsColor ? 3 : 2));
+
+    for (int label : labels) {
+        unsigned int val = label < 0 ? 0u : static_cast<unsigned int>(kernel.id(label)) + 1;
+        if (bIsColor) {
+            // Scrambles the id, such that neighboring cells differ in color.
+            val *= 2654435761u;
+            pixels.push_back(static_cast<unsigned char>(val >> 24));
+            pixels.push_back(static_cast<unsigned char>(val >> 16));
+            pixels.push_back(static_cast<unsigned char>(val >> 8));
+        } else {
+            if (val > 65535) {
+                std::cout << "Too many sites for a 16-bit label image.\n";
+                return false;
+            }
+
+            pixels.push_back(static_cast<unsigned char>(val >> 8));
+            pixels.push_back(static_cast<unsigned char>(val));
+        }
+    }
+
+    std::ofstream file;
+    file.open(filePath, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file << (bIsColor ? "P6\n" : "P5\n") << width << " " << height << "\n"
+            << (bIsColor ? 255 : 65535) << "\n";
+    file.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+
+    return file.good();
+}
+
+size_t crossCheck(const NearestSiteKernel &kernel, const SiteLocator &locator,
+                  const std::vector<int> &labels, const RasterBox &box, size_t width,
+                  size_t height, size_t nThreads) {
+    std::vector<QueryPnt> pnts;
+    pnts.reserve(width * height);
+    for (size_t row = 0; row < height; row++) {
+        for (size_t col = 0; col < width; col++) {
+            pnts.push_back(pixelCenter(box, width, height, row, col));
+        }
+    }
+
+    std::unordered_map<int, int> indices;
+    for (size_t i = 0; i < kernel.size(); i++) {
+        indices[kernel.id(i)] = static_cast<int>(i);
+    }
+
+    const auto siteIds = locator.locate(pnts, nThreads);
+    size_t nMismatches = 0;
+    for (size_t i = 0; i < pnts.size(); i++) {
+        const auto it = indices.find(siteIds.at(i));
+        if (it == indices.end()) {
+            nMismatches++;
+            continue;
+        }
+
+        if (it->second == labels.at(i)) {
+            continue;
+        }
+
+        double dist = kernel.sqrdDist(pnts[i].first, pnts[i].second, it->second),
+                minDist = kernel.sqrdDist(pnts[i].first, pnts[i].second, labels.at(i));
+        if (dist - minDist > 1e-9 * minDist) {
+            nMismatches++;
+        }
+    }
+
+    return nMismatches;
+}
+
+bool parseRasterBox(const std::string &str, RasterBox &box) {
+    return std::sscanf(str.c_str(), "%lf,%lf,%lf,%lf", &box.xMin, &box.yMin,
+                       &box.xMax, &box.yMax) == 4
+            && box.xMin < box.xMax && box.yMin < box.yMax;
+}
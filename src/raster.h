@@ -0,0 +1,91 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <string>
+#include <vector>
+#include "sites.h"
+#include "file_io.h"
+#include "locate.h"
+
+// An axis-parallel box given by its lower left and upper right corner.
+struct RasterBox {
+    double xMin;
+    double yMin;
+    double xMax;
+    double yMax;
+};
+
+// Determines the nearest sites of query points by brute force, i.e., it
+// evaluates argmin |p - s| / w(s) over all sites s. The sites are stored as
+// arrays of coordinates and inverse squared weights, such that a distance
+// takes two subtractions and three multiplications. If built with AVX2,
+// four query points are processed at once; otherwise, a scalar loop is used.
+// The query points are processed in tiles of PNT_TILE points, and every tile
+// is compared with all sites block by block, i.e., every point of the tile
+// is compared with a block of SITE_BLOCK sites (which fits into the cache)
+// before the next block is loaded.
+class NearestSiteKernel {
+public:
+    NearestSiteKernel(const std::vector<SitePtr> &sites);
+    NearestSiteKernel(const std::vector<SiteData> &sites);
+
+    size_t size() const {
+        return m_ids.size();
+    }
+
+    // Returns the weighted distance of (x, y) to the site with the given
+    // index (not id), squared.
+    double sqrdDist(double x, double y, size_t index) const;
+
+    // Writes the index (not id) of the nearest site of every query point to
+    // indices.
+    void nearest(const double *xs, const double *ys, size_t nPnts,
+            int *indices) const;
+    std::vector<int> nearest(const std::vector<double> &xs,
+            const std::vector<double> &ys) const;
+
+    int id(int index) const {
+        return m_ids.at(index);
+    }
+
+    // Returns the bounding box of the sites, enlarged by 5% on every side.
+    RasterBox bbox() const;
+
+private:
+    void addSite(double x, double y, double w, int id);
+    void nearestBlock(const double *xs, const double *ys, size_t nPnts,
+            size_t begin, size_t end, double *minDists, int *indices) const;
+
+    std::vector<int> m_ids;
+    std::vector<double> m_xs;
+    std::vector<double> m_ys;
+    std::vector<double> m_invSqrdWgts;
+};
+
+// Returns the center of the pixel in the given row and column of a
+// width x height raster over box; row 0 is the upper one.
+QueryPnt pixelCenter(const RasterBox &box, size_t width, size_t height,
+        size_t row, size_t col);
+
+// Labels every pixel of a width x height raster over box with the index of
+// the site that contains its center. Rows are distributed among nThreads
+// threads.
+std::vector<int> rasterize(const NearestSiteKernel &kernel, const RasterBox &box,
+        size_t width, size_t height, size_t nThreads);
+
+// Writes a label image to a 16-bit PGM file (site ids + 1, zero for pixels
+// without a site) or, if the file has the suffix ppm, a color image with
+// one pseudo-random color per site.
+bool writeRaster(const std::string &filePath, const NearestSiteKernel &kernel,
+        const std::vector<int> &labels, size_t width, size_t height);
+
+// Locates the pixel centers with the index built from the output of the
+// sweep and returns the number of pixels where it disagrees with the labels.
+// Pixels that are (numerically) equidistant to both sites do not count.
+size_t crossCheck(const NearestSiteKernel &kernel, const SiteLocator &locator,
+        const std::vector<int> &labels, const RasterBox &box, size_t width,
+        size_t height, size_t nThreads);
+
+bool parseRasterBox(const std::string &str, RasterBox &box);
+
+#endif /* RASTER_H */
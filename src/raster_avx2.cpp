@@ -0,0 +1,35 @@
+#ifdef ENABLE_AVX2
+#include <immintrin.h>
+#include "raster_avx2.h"
+
+size_t nearestBlockAvx2(const double *xs, const double *ys, size_t nPnts,
+                        const double *siteXs, const double *siteYs,
+                        const double *invSqrdWgts, size_t begin, size_t end,
+                        double *minDists, int *indices) {
+    size_t q = 0;
+    for (; q + 4 <= nPnts; q += 4) {
+        const __m256d qx = _mm256_loadu_pd(xs + q), qy = _mm256_loadu_pd(ys + q);
+        __m256d best = _mm256_loadu_pd(minDists + q),
+                bestIndex = _mm256_cvtepi32_pd(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(indices + q)));
+
+        for (size_t s = begin; s < end; s++) {
+            const __m256d dx = _mm256_sub_pd(qx, _mm256_broadcast_sd(siteXs + s)),
+                    dy = _mm256_sub_pd(qy, _mm256_broadcast_sd(siteYs + s));
+            const __m256d dist = _mm256_mul_pd(
+                    _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+                    _mm256_broadcast_sd(invSqrdWgts + s));
+            const __m256d mask = _mm256_cmp_pd(dist, best, _CMP_LT_OQ);
+            best = _mm256_blendv_pd(best, dist, mask);
+            bestIndex = _mm256_blendv_pd(bestIndex,
+                    _mm256_set1_pd(static_cast<double>(s)), mask);
+        }
+
+        _mm256_storeu_pd(minDists + q, best);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(indices + q),
+                         _mm256_cvtpd_epi32(bestIndex));
+    }
+
+    return q;
+}
+#endif
@@ -0,0 +1,17 @@
+#ifndef RASTER_AVX2_H
+#define RASTER_AVX2_H
+
+#include <cstddef>
+
+// The AVX2 part of NearestSiteKernel::nearestBlock(), which is the only code
+// compiled with -mavx2 (see BUILD_AVX2). It must not include any other
+// header of wevo or of CGAL, such that no inline function compiled for AVX2
+// can be picked by the linker for the other objects.
+//
+// Compares the sites [begin, end) with the query points in groups of four
+// and returns the number of processed query points (a multiple of four).
+size_t nearestBlockAvx2(const double *xs, const double *ys, size_t nPnts,
+        const double *siteXs, const double *siteYs, const double *invSqrdWgts,
+        size_t begin, size_t end, double *minDists, int *indices);
+
+#endif /* RASTER_AVX2_H */
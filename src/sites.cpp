@@ -1,5 +1,4 @@
 #include "sites.h"
-#include "util.h"
 #include "log.h"
 
 Site::Site(int weight, int id)
@@ -42,48 +41,3 @@ Root_of_2 PntSite::sqrdDist(const Circular_arc_point_2 &arcPnt) const {
             + CGAL::square(arcPnt.y() - m_pnt.y())) / CGAL::square(weight());
     return res;
 }
-
-#ifdef ENABLE_VIEW
-
-SiteGraphicsItem::SiteGraphicsItem(const SitePtr &site)
-: m_site{site}
-{
-    setAcceptHoverEvents(true);
-    setToolTip("id " + QString::number(m_site->id()) + "\nweight " 
-            + QString::number(CGAL::to_double(m_site->weight())));
-}
-
-QRectF SiteGraphicsItem::boundingRect() const {
-    return m_boundingRect;
-}
-
-void SiteGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsItem*,
-                             QWidget*) {
-    if (typeid(*m_site) == typeid(PntSite)) {
-        const auto pntSite = std::static_pointer_cast<PntSite>(m_site);
-        painter->setPen(Qt::darkGreen);
-        painter->setBrush(Qt::darkGreen);
-        Util::draw(painter, pntSite->pnt());
-    }
-    
-    const auto scale = std::max(painter->worldTransform().m11(), 
-                                painter->worldTransform().m22());
-    double x = CGAL::to_double(m_site->center().x()),
-            y = CGAL::to_double(m_site->center().y()),
-            offset = 10. / scale;
-    prepareGeometryChange();
-    m_boundingRect = QRectF{x - offset, y - offset, 2. * offset, 2. * offset};
-}
-
-void SiteGraphicsItem::modelChanged() {
-    update();
-}
-
-void SiteGraphicsItem::onToggle(bool bIsVisible) {
-    setVisible(bIsVisible);
-    update();
-}
-
-#include "moc_sites.cpp"
-
-#endif
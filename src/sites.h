@@ -65,29 +65,4 @@ private:
     Point_2 m_pnt;
 };
 
-#ifdef ENABLE_VIEW
-
-class SiteGraphicsItem : public CGAL::Qt::GraphicsItem {
-    Q_OBJECT
-
-public:
-    SiteGraphicsItem(const SitePtr &site);
-
-    QRectF boundingRect() const override;
-
-    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
-            QWidget *widget = nullptr) override;
-
-public slots:
-    void modelChanged() override;
-    void onToggle(bool bIsVisible);
-    
-private:
-    SitePtr m_site;
-    QRectF m_boundingRect;
-    double m_time{0.};
-};
-
-#endif
-
 #endif /* SITES_H */
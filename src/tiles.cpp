@@ -0,0 +1,793 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <boost/thread.hpp>
+#include "tiles.h"
+
+extern char **environ;
+
+// The halo of a tile is enlarged by this relative margin, such that it
+// contains the exact halo despite rounding errors.
+const double HALO_MARGIN = 1e-9;
+// Endpoints of pieces within this distance (relative to the size of the
+// box) are identified.
+const double STITCH_EPS = 1e-9;
+const size_t NO_LINK = std::numeric_limits<size_t>::max();
+// The number of sites that are buffered per tile before they are appended
+// to its file.
+const size_t SPILL_SITES = 1024;
+
+// A piece of an edge within a tile. The ends (0 = source, 1 = target) are
+// linked to the ends of the pieces that continue the edge in the
+// neighboring tiles.
+struct Piece {
+    WvdEdge edge;
+    size_t tile;
+    double xs[2];
+    double ys[2];
+    bool bIsOnSide[2];
+    size_t links[2];
+};
+
+// The tiles of an area and the bounds of their halos. A site s may own a
+// point of tile i only if minDist(i, s) / w(s) <= U_i (see
+// VorDiag::clipSites()), where U_i is bounded by the sites that reach the
+// whole tile that contains them first (see bound()). Hence, a site is
+// assigned only to the tiles within its reach.
+class TileGrid {
+public:
+    TileGrid(const RasterBox &box, size_t nTiles);
+
+    size_t nTiles() const {
+        return m_nTiles;
+    }
+
+    const std::vector<RasterBox> & boxes() const {
+        return m_boxes;
+    }
+
+    // Keeps the site if it reaches the whole tile that contains it first.
+    void bound(const SiteData &s);
+    // Bounds the halos by the kept sites, where only the sites that may
+    // reach a tile before the kept sites found so far are compared.
+    void finishBounds();
+    // Calls f with the index of every tile that the site may reach.
+    template<class F>
+    void forTilesOf(const SiteData &s, F f) const;
+
+private:
+    size_t col(double x) const;
+    size_t row(double y) const;
+
+    RasterBox m_box;
+    size_t m_nTiles;
+    double m_tileWidth;
+    double m_tileHeight;
+    std::vector<RasterBox> m_boxes;
+    std::vector<double> m_bestSqrdTimes;
+    std::vector<SiteData> m_bestSites;
+    std::vector<double> m_sqrdTimes;
+    double m_maxSqrdTime{0.};
+};
+
+static double minSqrdDist(const RasterBox &box, double x, double y) {
+    return boxMinSqrdDist(box.xMin, box.yMin, box.xMax, box.yMax, x, y);
+}
+
+static double maxSqrdDist(const RasterBox &box, double x, double y) {
+    return boxMaxSqrdDist(box.xMin, box.yMin, box.xMax, box.yMax, x, y);
+}
+
+TileGrid::TileGrid(const RasterBox &box, size_t nTiles)
+    : m_box(box), m_nTiles(std::max<size_t>(1, nTiles)),
+      m_tileWidth((box.xMax - box.xMin) / m_nTiles),
+      m_tileHeight((box.yMax - box.yMin) / m_nTiles) {
+    const auto fX = [&](size_t i) {
+        return i == m_nTiles ? box.xMax : box.xMin + i * m_tileWidth;
+    };
+
+    const auto fY = [&](size_t i) {
+        return i == m_nTiles ? box.yMax : box.yMin + i * m_tileHeight;
+    };
+
+    for (size_t row = 0; row < m_nTiles; row++) {
+        for (size_t col = 0; col < m_nTiles; col++) {
+            m_boxes.push_back(RasterBox{fX(col), fY(row), fX(col + 1), fY(row + 1)});
+        }
+    }
+
+    m_bestSqrdTimes.assign(m_boxes.size(), std::numeric_limits<double>::infinity());
+    m_bestSites.resize(m_boxes.size());
+}
+
+// Sites outside of the area belong to the tiles at its boundary.
+size_t TileGrid::col(double x) const {
+    double col = std::floor((x - m_box.xMin) / m_tileWidth);
+    return static_cast<size_t>(std::min(std::max(col, 0.), m_nTiles - 1.));
+}
+
+size_t TileGrid::row(double y) const {
+    double row = std::floor((y - m_box.yMin) / m_tileHeight);
+    return static_cast<size_t>(std::min(std::max(row, 0.), m_nTiles - 1.));
+}
+
+void TileGrid::bound(const SiteData &s) {
+    double x = std::get<0>(s), y = std::get<1>(s), w = std::get<2>(s);
+    size_t i = row(y) * m_nTiles + col(x);
+    double sqrdTime = maxSqrdDist(m_boxes[i], x, y) / (w * w);
+    if (sqrdTime < m_bestSqrdTimes[i]) {
+        m_bestSqrdTimes[i] = sqrdTime;
+        m_bestSites[i] = s;
+    }
+}
+
+// A site in a tile at (Chebyshev) distance r from tile i is at least
+// r * min(width, height) away from the farther side of tile i, hence the
+// rings of tiles around tile i are searched only until they cannot improve
+// its bound.
+void TileGrid::finishBounds() {
+    double maxWeight = 0.;
+    for (size_t j = 0; j < m_boxes.size(); j++) {
+        if (m_bestSqrdTimes[j] < std::numeric_limits<double>::infinity()) {
+            maxWeight = std::max(maxWeight, static_cast<double>(std::get<2>(m_bestSites[j])));
+        }
+    }
+
+    double side = std::min(m_tileWidth, m_tileHeight);
+    long long n = static_cast<long long>(m_nTiles);
+    m_sqrdTimes.assign(m_boxes.size(), std::numeric_limits<double>::infinity());
+    m_maxSqrdTime = 0.;
+    for (long long row = 0; row < n; row++) {
+        for (long long col = 0; col < n; col++) {
+            size_t i = static_cast<size_t>(row * n + col);
+            const auto fVisit = [&](long long r, long long c) {
+                size_t j = static_cast<size_t>(r * n + c);
+                if (r >= 0 && r < n && c >= 0 && c < n
+                    && m_bestSqrdTimes[j] < std::numeric_limits<double>::infinity()) {
+                    double x = std::get<0>(m_bestSites[j]), y = std::get<1>(m_bestSites[j]),
+                            w = std::get<2>(m_bestSites[j]);
+                    m_sqrdTimes[i] = std::min(m_sqrdTimes[i],
+                                              maxSqrdDist(m_boxes[i], x, y) / (w * w));
+                }
+            };
+
+            for (long long ring = 0; ring < n; ring++) {
+                double dist = ring * side / maxWeight;
+                if (ring > 0 && dist * dist > m_sqrdTimes[i]) {
+                    break;
+                }
+
+                for (long long k = -ring; k <= ring; k++) {
+                    fVisit(row - ring, col + k);
+                    if (ring > 0) {
+                        fVisit(row + ring, col + k);
+                    }
+                }
+
+                for (long long k = -ring + 1; k < ring; k++) {
+                    fVisit(row + k, col - ring);
+                    fVisit(row + k, col + ring);
+                }
+            }
+
+            m_maxSqrdTime = std::max(m_maxSqrdTime, m_sqrdTimes[i]);
+        }
+    }
+}
+
+template<class F>
+void TileGrid::forTilesOf(const SiteData &s, F f) const {
+    double x = std::get<0>(s), y = std::get<1>(s), w = std::get<2>(s),
+            reach = std::sqrt(m_maxSqrdTime * (1. + HALO_MARGIN)) * w;
+    for (size_t r = row(y - reach); r <= row(y + reach); r++) {
+        for (size_t c = col(x - reach); c <= col(x + reach); c++) {
+            size_t i = r * m_nTiles + c;
+            if (minSqrdDist(m_boxes[i], x, y) <= m_sqrdTimes[i] * w * w * (1. + HALO_MARGIN)) {
+                f(i);
+            }
+        }
+    }
+}
+
+static std::string tilePath(const TileOpts &opts, size_t i, const std::string &suffix) {
+    return opts.workDir + "/tile" + std::to_string(i) + suffix;
+}
+
+// Appends the sites that fNext yields to the files of the tiles they may
+// reach (buffered per tile), and returns the largest number of sites of a
+// tile in maxSites.
+template<class F>
+static bool writeTileSites(const TileGrid &grid, const TileOpts &opts, F fNext,
+                           size_t &maxSites) {
+    const auto &boxes = grid.boxes();
+    std::vector<std::vector<SiteData>> buffers(boxes.size());
+    std::vector<size_t> nTileSites(boxes.size(), 0);
+    for (size_t i = 0; i < boxes.size(); i++) {
+        if (!writeSites(tilePath(opts, i, ".sites"), buffers[i])) {
+            std::cout << "Could not write the sites of tile " << i << ".\n";
+            return false;
+        }
+    }
+
+    const auto fSpill = [&](size_t i) {
+        bool bOk = writeSites(tilePath(opts, i, ".sites"), buffers[i], true);
+        buffers[i].clear();
+        return bOk;
+    };
+
+    bool bOk = true;
+    SiteData s;
+    while (bOk && fNext(s)) {
+        grid.forTilesOf(s, [&](size_t i) {
+            buffers[i].push_back(s);
+            nTileSites[i]++;
+            if (buffers[i].size() >= SPILL_SITES) {
+                bOk = fSpill(i) && bOk;
+            }
+        });
+    }
+
+    for (size_t i = 0; i < boxes.size(); i++) {
+        bOk = fSpill(i) && bOk;
+    }
+
+    maxSites = *std::max_element(nTileSites.begin(), nTileSites.end());
+    return bOk;
+}
+
+// Quotes the argument for the shell.
+static std::string quoted(const std::string &arg) {
+    std::string res = "'";
+    for (char c : arg) {
+        res += c == '\'' ? std::string{"'\\''"} : std::string(1, c);
+    }
+
+    return res + "'";
+}
+
+// Returns the options of the diagrams of the tiles as arguments of a worker.
+static std::string workerArgs(const VorDiagOpts &vorDiagOpts) {
+    std::ostringstream args;
+    args << std::setprecision(17) << " --cand-mode ";
+    switch (vorDiagOpts.candMode) {
+        case CandMode::All:
+            args << "all";
+            break;
+        case CandMode::Overlay:
+            args << "overlay";
+            break;
+        case CandMode::Classes:
+            args << "classes";
+            break;
+        case CandMode::Grid:
+            args << "grid";
+            break;
+        case CandMode::Auto:
+        default:
+            args << "auto";
+            break;
+    }
+
+    args << " --queue " << (vorDiagOpts.queueType == QueueType::Buckets ? "buckets" : "heap");
+    if (!vorDiagOpts.bUseDelaunay) {
+        args << " --no-delaunay";
+    }
+
+    if (vorDiagOpts.bParallelSweep) {
+        args << " --parallel-sweep";
+    }
+
+    if (!vorDiagOpts.overlayCacheDir.empty()) {
+        args << " --overlay-cache " << quoted(vorDiagOpts.overlayCacheDir);
+    }
+
+    if (vorDiagOpts.maxTime >= 0.) {
+        args << " --max-time " << vorDiagOpts.maxTime;
+    }
+
+    return args.str();
+}
+
+// Runs the command by the shell and returns its exit status (or -1).
+// Unlike std::system(), which changes the handling of signals for the whole
+// process, posix_spawn() and waitpid() may be called by several threads at
+// the same time.
+static int runCmd(const std::string &cmd) {
+    const char *args[] = {"sh", "-c", cmd.c_str(), nullptr};
+    pid_t pid;
+    if (posix_spawn(&pid, "/bin/sh", nullptr, nullptr, const_cast<char **>(args),
+                    environ) != 0) {
+        return -1;
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Runs a worker per tile, at most opts.nWorkers at the same time. The output
+// of worker i is written to tile<i>.log.
+static bool runWorkers(const std::vector<RasterBox> &boxes, const TileOpts &opts) {
+    std::vector<int> statuses(boxes.size(), 0);
+    std::atomic<size_t> next{0};
+    const auto args = workerArgs(opts.vorDiagOpts);
+
+    const auto fRun = [&]() {
+        for (size_t i = next++; i < boxes.size(); i = next++) {
+            const auto &box = boxes[i];
+            std::ostringstream cmd;
+            if (!opts.launcher.empty()) {
+                cmd << opts.launcher << " ";
+            }
+
+            cmd << std::setprecision(17) << quoted(opts.workerPath)
+                    << " " << quoted(tilePath(opts, i, ".sites"))
+                    << " --clip-box " << box.xMin << "," << box.yMin << ","
+                    << box.xMax << "," << box.yMax
+                    << " --bin-file " << quoted(tilePath(opts, i, ".wvd"))
+                    << " --threads " << opts.nThreads << args
+                    << " > " << quoted(tilePath(opts, i, ".log")) << " 2>&1";
+            statuses[i] = runCmd(cmd.str());
+        }
+    };
+
+    size_t nWorkers = std::max<size_t>(1, std::min(opts.nWorkers, boxes.size()));
+    boost::thread_group threads;
+    for (size_t i = 0; i < nWorkers; i++) {
+        threads.create_thread(fRun);
+    }
+
+    threads.join_all();
+
+    bool bOk = true;
+    for (size_t i = 0; i < boxes.size(); i++) {
+        if (statuses[i] != 0) {
+            std::cout << "The worker of tile " << i << " failed (see "
+                    << tilePath(opts, i, ".log") << ").\n";
+            bOk = false;
+        }
+    }
+
+    return bOk;
+}
+
+// Computes the tiles one after another in clip box mode, such that only a
+// single tile is kept in memory.
+static bool computeInProcess(const std::vector<RasterBox> &boxes, const TileOpts &opts) {
+    for (size_t i = 0; i < boxes.size(); i++) {
+        const auto sites = FileReader{tilePath(opts, i, ".sites")}.sites();
+        if (sites.empty()) {
+            BinWriter bw{tilePath(opts, i, ".wvd")};
+            if (!bw.isOpen()) {
+                return false;
+            }
+
+            continue;
+        }
+
+        std::cout << "Computing tile " << i << " of " << boxes.size() << " ("
+                << sites.size() << " sites) ...\n";
+        auto vorDiagOpts = opts.vorDiagOpts;
+        vorDiagOpts.bClip = true;
+        vorDiagOpts.clipBox = CGAL::Bbox_2{boxes[i].xMin, boxes[i].yMin,
+                                           boxes[i].xMax, boxes[i].yMax};
+        vorDiagOpts.binFilePath = tilePath(opts, i, ".wvd");
+        vorDiagOpts.nThreads = opts.nThreads;
+        VorDiag{sites, vorDiagOpts};
+    }
+
+    return true;
+}
+
+static bool computeTiles(const std::vector<RasterBox> &boxes, const TileOpts &opts) {
+    if (opts.workerPath.empty()) {
+        return computeInProcess(boxes, opts);
+    }
+
+    std::cout << "Computing the tiles with " << opts.nWorkers << " workers ...\n";
+    return runWorkers(boxes, opts);
+}
+
+// Returns true if (x, y) lies on a side of the box that is shared with
+// another tile, i.e., not on the boundary of the whole area.
+static bool isOnInnerSide(const RasterBox &box, const RasterBox &area,
+                          double x, double y, double eps) {
+    return (std::abs(x - box.xMin) <= eps && box.xMin > area.xMin)
+            || (std::abs(x - box.xMax) <= eps && box.xMax < area.xMax)
+            || (std::abs(y - box.yMin) <= eps && box.yMin > area.yMin)
+            || (std::abs(y - box.yMax) <= eps && box.yMax < area.yMax);
+}
+
+// Returns true if the segment from (x1, y1) to (x2, y2) runs along the left
+// or the lower side of the box. Such segments are reported by both tiles
+// that share the side, and only the other one is kept.
+static bool isAlongLowerSide(const RasterBox &box, const RasterBox &area,
+                             double x1, double y1, double x2, double y2, double eps) {
+    return (box.xMin > area.xMin && std::abs(x1 - box.xMin) <= eps
+            && std::abs(x2 - box.xMin) <= eps)
+            || (box.yMin > area.yMin && std::abs(y1 - box.yMin) <= eps
+                && std::abs(y2 - box.yMin) <= eps);
+}
+
+// Reads the pieces of the tiles one after another. The ends of a piece that
+// lie on an inner side of its tile and that no other piece of the tile
+// shares are clip points, which have to be stitched; the other ends on inner
+// sides are vertices of the diagram. The pieces without clip points are
+// written to bw right away (counted in nEdges), and only the others are
+// kept. The vertices of the kept pieces and the vertices on inner sides keep
+// their ids in bw.
+static bool readPieces(const std::vector<RasterBox> &boxes, const TileOpts &opts,
+                       double eps, BinWriter &bw, size_t &nEdges,
+                       std::vector<Piece> &pieces,
+                       std::vector<std::pair<double, double>> &sideVerts) {
+    std::vector<std::pair<double, double>> keptVerts;
+    for (size_t i = 0; i < boxes.size(); i++) {
+        const auto &box = boxes[i];
+        BinReader reader{tilePath(opts, i, ".wvd")};
+        if (!reader.isValid()) {
+            std::cout << "Could not read the edges of tile " << i << ".\n";
+            return false;
+        }
+
+        const auto &verts = reader.verts();
+        std::vector<size_t> degrees(verts.size(), 0);
+        for (const auto &edge : reader.edges()) {
+            degrees.at(edge.src)++;
+            degrees.at(edge.tgt)++;
+        }
+
+        // The vertices on inner sides are shared with the neighboring tiles,
+        // hence they keep their ids, too.
+        for (size_t v = 0; v < verts.size(); v++) {
+            if (degrees[v] > 1 && isOnInnerSide(box, opts.box, verts[v].x, verts[v].y, eps)) {
+                sideVerts.emplace_back(verts[v].x, verts[v].y);
+                keptVerts.emplace_back(verts[v].x, verts[v].y);
+            }
+        }
+
+        for (const auto &edge : reader.edges()) {
+            const auto &src = verts.at(edge.src), &tgt = verts.at(edge.tgt);
+            if (!edge.bIsArc
+                && isAlongLowerSide(box, opts.box, src.x, src.y, tgt.x, tgt.y, eps)) {
+                continue;
+            }
+
+            Piece piece{edge, i, {src.x, tgt.x}, {src.y, tgt.y},
+                        {degrees[edge.src] == 1, degrees[edge.tgt] == 1},
+                        {NO_LINK, NO_LINK}};
+            for (size_t k = 0; k < 2; k++) {
+                piece.bIsOnSide[k] = piece.bIsOnSide[k]
+                        && isOnInnerSide(box, opts.box, piece.xs[k], piece.ys[k], eps);
+            }
+
+            if (piece.bIsOnSide[0] || piece.bIsOnSide[1]) {
+                for (size_t k = 0; k < 2; k++) {
+                    if (!piece.bIsOnSide[k]) {
+                        keptVerts.emplace_back(piece.xs[k], piece.ys[k]);
+                    }
+                }
+
+                pieces.push_back(piece);
+            } else if (edge.bIsArc) {
+                bw.addArc(src.x, src.y, tgt.x, tgt.y, edge.site1, edge.site2,
+                          edge.cx, edge.cy, edge.r);
+                nEdges++;
+            } else {
+                bw.addSeg(src.x, src.y, tgt.x, tgt.y, edge.site1, edge.site2);
+                nEdges++;
+            }
+        }
+
+        bw.clearVerts(keptVerts);
+    }
+
+    std::sort(sideVerts.begin(), sideVerts.end());
+
+    return true;
+}
+
+// Two ends of pieces of different tiles continue each other if the pieces
+// separate the same sites and lie on the same line or circle. Arcs run
+// counterclockwise, hence the target of one meets the source of the other.
+static bool continues(const std::vector<Piece> &pieces, size_t end1, size_t end2,
+                      double eps) {
+    const auto &piece1 = pieces[end1 / 2], &piece2 = pieces[end2 / 2];
+    if (piece1.tile == piece2.tile || piece1.edge.bIsArc != piece2.edge.bIsArc) {
+        return false;
+    }
+
+    if (!piece1.edge.bIsArc) {
+        return true;
+    }
+
+    return end1 % 2 != end2 % 2
+            && std::abs(piece1.edge.cx - piece2.edge.cx) <= eps
+            && std::abs(piece1.edge.cy - piece2.edge.cy) <= eps
+            && std::abs(piece1.edge.r - piece2.edge.r) <= eps;
+}
+
+// Links the clip points of the pieces, i.e., every end on an inner side is
+// matched with an end of a piece of another tile that separates the same
+// sites at the same point. Returns the number of clip points without a
+// counterpart, except for those at vertices of other tiles.
+static size_t linkPieces(std::vector<Piece> &pieces,
+                         const std::vector<std::pair<double, double>> &sideVerts,
+                         double eps) {
+    std::map<std::pair<int, int>, std::vector<size_t>> buckets;
+    for (size_t i = 0; i < pieces.size(); i++) {
+        const auto &edge = pieces[i].edge;
+        for (size_t k = 0; k < 2; k++) {
+            if (pieces[i].bIsOnSide[k]) {
+                buckets[std::minmax(edge.site1, edge.site2)].push_back(2 * i + k);
+            }
+        }
+    }
+
+    const auto fX = [&pieces](size_t end) {
+        return pieces[end / 2].xs[end % 2];
+    };
+
+    const auto fY = [&pieces](size_t end) {
+        return pieces[end / 2].ys[end % 2];
+    };
+
+    size_t nMismatches = 0;
+    for (auto &val : buckets) {
+        auto &ends = val.second;
+        std::sort(ends.begin(), ends.end(), [&fX](size_t lhs, size_t rhs) {
+            return fX(lhs) < fX(rhs);
+        });
+
+        for (size_t i = 0; i < ends.size(); i++) {
+            size_t end1 = ends[i];
+            if (pieces[end1 / 2].links[end1 % 2] != NO_LINK) {
+                continue;
+            }
+
+            for (size_t j = i + 1; j < ends.size() && fX(ends[j]) - fX(end1) <= eps; j++) {
+                size_t end2 = ends[j];
+                if (pieces[end2 / 2].links[end2 % 2] == NO_LINK
+                    && std::abs(fY(end2) - fY(end1)) <= eps
+                    && continues(pieces, end1, end2, eps)) {
+                    pieces[end1 / 2].links[end1 % 2] = end2;
+                    pieces[end2 / 2].links[end2 % 2] = end1;
+                    break;
+                }
+            }
+
+            if (pieces[end1 / 2].links[end1 % 2] == NO_LINK) {
+                const auto it = std::lower_bound(sideVerts.begin(), sideVerts.end(),
+                                                 std::make_pair(fX(end1) - eps, fY(end1) - eps));
+                bool bIsVert = false;
+                for (auto jt = it; jt != sideVerts.end() && jt->first - fX(end1) <= eps; ++jt) {
+                    bIsVert = bIsVert || std::abs(jt->second - fY(end1)) <= eps;
+                }
+
+                if (!bIsVert) {
+                    nMismatches++;
+                }
+            }
+        }
+    }
+
+    return nMismatches;
+}
+
+// Writes the chains of linked pieces as single edges and returns their
+// number. Arcs are followed from source to target; segments are followed in
+// either direction. Pieces that form a cycle are written as they are.
+static size_t writeEdges(const std::vector<Piece> &pieces, BinWriter &bw) {
+    std::vector<bool> bIsDone(pieces.size(), false);
+    size_t nEdges = 0;
+
+    const auto fWrite = [&](size_t first, size_t firstEnd, size_t last, size_t lastEnd) {
+        const auto &edge = pieces[first].edge;
+        double x1 = pieces[first].xs[firstEnd], y1 = pieces[first].ys[firstEnd],
+                x2 = pieces[last].xs[lastEnd], y2 = pieces[last].ys[lastEnd];
+        if (edge.bIsArc) {
+            bw.addArc(x1, y1, x2, y2, edge.site1, edge.site2, edge.cx, edge.cy, edge.r);
+        } else {
+            bw.addSeg(x1, y1, x2, y2, edge.site1, edge.site2);
+        }
+
+        nEdges++;
+    };
+
+    for (size_t i = 0; i < pieces.size(); i++) {
+        for (size_t k = 0; k < 2 && !bIsDone[i]; k++) {
+            // Arcs start at their source.
+            if (pieces[i].links[k] != NO_LINK || (pieces[i].edge.bIsArc && k == 1)) {
+                continue;
+            }
+
+            size_t cur = i, end = 1 - k;
+            bIsDone[cur] = true;
+            while (pieces[cur].links[end] != NO_LINK && !bIsDone[pieces[cur].links[end] / 2]) {
+                size_t link = pieces[cur].links[end];
+                cur = link / 2;
+                end = 1 - link % 2;
+                bIsDone[cur] = true;
+            }
+
+            fWrite(i, k, cur, end);
+        }
+    }
+
+    for (size_t i = 0; i < pieces.size(); i++) {
+        if (!bIsDone[i]) {
+            fWrite(i, 0, i, 1);
+        }
+    }
+
+    return nEdges;
+}
+
+// Stitches the edges of the tiles, where fAddSites adds the sites to the
+// output.
+static bool stitchTiles(const std::vector<RasterBox> &boxes, const TileOpts &opts,
+                        const std::function<bool(BinWriter &)> &fAddSites) {
+    const auto binFilePath = opts.binFilePath.empty()
+            ? opts.workDir + "/tiles.wvd" : opts.binFilePath;
+    std::cout << "Stitching the tiles into " << binFilePath << " ...\n";
+    BinWriter bw{binFilePath};
+    if (!bw.isOpen() || !fAddSites(bw)) {
+        return false;
+    }
+
+    double eps = STITCH_EPS * std::max(opts.box.xMax - opts.box.xMin,
+                                       opts.box.yMax - opts.box.yMin);
+    size_t nEdges = 0;
+    std::vector<Piece> pieces;
+    std::vector<std::pair<double, double>> sideVerts;
+    if (!readPieces(boxes, opts, eps, bw, nEdges, pieces, sideVerts)) {
+        return false;
+    }
+
+    size_t nMismatches = linkPieces(pieces, sideVerts, eps);
+    nEdges += writeEdges(pieces, bw);
+    bw.close();
+
+    std::cout << "Stitched " << pieces.size() << " pieces at the sides of the tiles, "
+            << nEdges << " edges in total.\n";
+
+    if (!opts.ipeFilePath.empty()) {
+        std::cout << "Writing output to " << opts.ipeFilePath << " ...\n";
+        if (!convertBinToIpe(binFilePath, opts.ipeFilePath)) {
+            return false;
+        }
+    }
+
+    if (nMismatches > 0) {
+        std::cout << nMismatches << " edges end at a side of a tile without a "
+                << "counterpart in the neighboring tile.\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool computeTiled(const std::vector<SiteData> &sites, const TileOpts &opts) {
+    TileGrid grid{opts.box, opts.nTiles};
+    std::cout << "Assigning " << sites.size() << " sites to " << grid.nTiles() << "x"
+            << grid.nTiles() << " tiles ...\n";
+    for (const auto &s : sites) {
+        grid.bound(s);
+    }
+
+    grid.finishBounds();
+
+    size_t next = 0, maxSites = 0;
+    const auto fNext = [&sites, &next](SiteData &s) {
+        if (next == sites.size()) {
+            return false;
+        }
+
+        s = sites[next++];
+        return true;
+    };
+
+    if (!writeTileSites(grid, opts, fNext, maxSites)) {
+        return false;
+    }
+
+    std::cout << "At most " << maxSites << " sites per tile.\n";
+    if (!computeTiles(grid.boxes(), opts)) {
+        return false;
+    }
+
+    return stitchTiles(grid.boxes(), opts, [&sites](BinWriter &bw) {
+        for (const auto &s : sites) {
+            bw.addSite(std::get<3>(s), std::get<0>(s), std::get<1>(s), std::get<2>(s));
+        }
+
+        return true;
+    });
+}
+
+bool computeOutOfCore(const std::string &inFilePath, const TileOpts &opts,
+                      size_t maxTileSites) {
+    std::cout << "Scanning " << inFilePath << " ...\n";
+    SiteStream stream{inFilePath};
+    if (!stream.isOpen()) {
+        return false;
+    }
+
+    size_t nSites = 0;
+    auto bbox = RasterBox{std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+                          std::numeric_limits<double>::lowest(),
+                          std::numeric_limits<double>::lowest()};
+    SiteData s;
+    while (stream.next(s)) {
+        double x = std::get<0>(s), y = std::get<1>(s);
+        bbox = RasterBox{std::min(bbox.xMin, x), std::min(bbox.yMin, y),
+                         std::max(bbox.xMax, x), std::max(bbox.yMax, y)};
+        nSites++;
+    }
+
+    if (nSites == 0) {
+        std::cout << "No sites found.\n";
+        return false;
+    }
+
+    auto tileOpts = opts;
+    if (!(opts.box.xMin < opts.box.xMax && opts.box.yMin < opts.box.yMax)) {
+        double dx = std::max(bbox.xMax - bbox.xMin, 1.) / 20.,
+                dy = std::max(bbox.yMax - bbox.yMin, 1.) / 20.;
+        tileOpts.box = RasterBox{bbox.xMin - dx, bbox.yMin - dy, bbox.xMax + dx, bbox.yMax + dy};
+    }
+
+    if (tileOpts.nTiles == 0) {
+        tileOpts.nTiles = static_cast<size_t>(std::ceil(std::sqrt(
+                static_cast<double>(nSites) / std::max<size_t>(1, maxTileSites))));
+    }
+
+    // The halo of a tile is bounded by the sites within (or next to) the
+    // tiles that reach their whole tiles first.
+    TileGrid grid{tileOpts.box, tileOpts.nTiles};
+    std::cout << "Bounding the halos of " << grid.nTiles() << "x" << grid.nTiles()
+            << " tiles ...\n";
+    stream = SiteStream{inFilePath};
+    while (stream.next(s)) {
+        grid.bound(s);
+    }
+
+    grid.finishBounds();
+
+    std::cout << "Distributing " << nSites << " sites to the tiles ...\n";
+    stream = SiteStream{inFilePath};
+    size_t maxSites = 0;
+    if (!writeTileSites(grid, tileOpts, [&stream](SiteData &site) { return stream.next(site); },
+                        maxSites)) {
+        return false;
+    }
+
+    std::cout << "At most " << maxSites << " sites per tile.\n";
+    if (!computeTiles(grid.boxes(), tileOpts)) {
+        return false;
+    }
+
+    return stitchTiles(grid.boxes(), tileOpts, [&inFilePath](BinWriter &bw) {
+        SiteStream siteStream{inFilePath};
+        SiteData site;
+        while (siteStream.next(site)) {
+            bw.addSite(std::get<3>(site), std::get<0>(site), std::get<1>(site),
+                       std::get<2>(site));
+        }
+
+        return siteStream.isOpen();
+    });
+}
@@ -0,0 +1,64 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <string>
+#include <vector>
+#include "file_io.h"
+#include "mwvd.h"
+#include "raster.h"
+
+// Options of a tiled computation (see computeTiled()).
+struct TileOpts {
+    // The area that is split into nTiles x nTiles tiles of equal size.
+    RasterBox box;
+    size_t nTiles{2};
+    // Number of worker processes that run at the same time and number of
+    // threads per worker.
+    size_t nWorkers{1};
+    size_t nThreads{1};
+    // Directory of the files through which the workers communicate.
+    std::string workDir{"."};
+    // The executable of a worker and a command that precedes it (e.g., a
+    // remote shell). If workerPath is empty, the tiles are computed one after
+    // another by this process.
+    std::string workerPath;
+    std::string launcher;
+    // The options of the diagrams of the tiles (the candidates, the event
+    // queue, the overlay cache, the maximum time and the sweep), which are
+    // passed on to the workers. The clip box, the files and the threads are
+    // set per tile.
+    VorDiagOpts vorDiagOpts;
+    std::string binFilePath;
+    std::string ipeFilePath;
+};
+
+// Computes the diagram within opts.box tile by tile. The box is split into
+// nTiles x nTiles tiles (row by row, starting at the lower left one), and
+// every tile gets the sites that may reach it. The halo of a tile is chosen
+// as in clip box mode (see VorDiag::clipSites()), but in double precision
+// and with a small margin, and it is bounded only by the sites that reach
+// their own tiles first, such that a site is assigned to the tiles within
+// its reach without comparing all pairs of sites and tiles. The sites of
+// tile i are written to tile<i>.sites in the working directory, and a worker
+// process (wevo in clip box mode) writes the edges within the tile to
+// tile<i>.wvd. Afterwards, the pieces of the edges that have been split at
+// the sides of the tiles are stitched, and the result is written to the
+// binary and the Ipe file (if given). Returns false if a worker failed or if
+// an edge ends at a side of a tile without a counterpart in the neighboring
+// tile, i.e., if the halos did not suffice or the workers disagree.
+bool computeTiled(const std::vector<SiteData> &sites, const TileOpts &opts);
+
+// Computes the diagram like computeTiled(), but streams the sites from the
+// input file (.pnts or .sites) instead of loading them. A first pass
+// determines the number of sites and, if opts.box is empty, the area (the
+// bounding box of the sites, enlarged by 5% on every side). If opts.nTiles is
+// zero, the number of tiles is chosen such that a tile contains about
+// maxTileSites sites on average. A second pass bounds the halos by the sites within
+// the tiles, and a third pass appends the sites to the files of the tiles
+// (buffered per tile). Only the tile that is being computed and the edges
+// at the sides of the tiles are kept in memory; all other edges are written
+// to the output as soon as their tile has been computed.
+bool computeOutOfCore(const std::string &inFilePath, const TileOpts &opts,
+        size_t maxTileSites);
+
+#endif /* TILES_H */
@@ -79,6 +79,8 @@ void MainWindow::addItem(QGraphicsItem *item) {
         const auto vdgi = static_cast<VorDiagGraphicsItem*> (item);
         QObject::connect(this, &MainWindow::toggleShowVorDiag,
                          vdgi, &VorDiagGraphicsItem::onToggle);
+        QObject::connect(this, &MainWindow::toggleShowSites,
+                         vdgi, &VorDiagGraphicsItem::onToggleSites);
         QObject::connect(vdgi, &VorDiagGraphicsItem::timeChanged,
                          this, &MainWindow::onTimeChanged);
         QObject::connect(this, &MainWindow::nextEv,
@@ -88,10 +90,6 @@ void MainWindow::addItem(QGraphicsItem *item) {
         QObject::connect(this, &MainWindow::hideEvPnt,
                          vdgi, &VorDiagGraphicsItem::onHideEvPnt);
         m_vdgi = vdgi;
-    } else if (typeid(*item) == typeid(SiteGraphicsItem)) {
-        const auto sgi = static_cast<SiteGraphicsItem*> (item);
-        QObject::connect(this, &MainWindow::toggleShowSites,
-                         sgi, &SiteGraphicsItem::onToggle);
     }
     
     m_scene->addItem(item);
@@ -112,7 +110,7 @@ void MainWindow::centerWidget() {
 void MainWindow::showEvent(QShowEvent *) {
     if (m_bFirstShowEvent) {
         QRectF br;
-        const auto sites = m_vdgi->vorDiag().sites();
+        const auto &sites = m_vdgi->vorDiag().sites();
         double maxWeight = 0.;
         for (const auto &site : sites) {
             double x = CGAL::to_double(site->center().x()),
@@ -136,8 +134,8 @@ void MainWindow::showEvent(QShowEvent *) {
         ui.graphicsView->fitInView(withMargins, Qt::KeepAspectRatio);
         m_bFirstShowEvent = false;
         
-        const auto evs = m_vdgi->vorDiag().events();
-        double midTime = CGAL::to_double(evs.at(evs.size() / 2)->sqrdTime());
+        const auto &evs = m_vdgi->vorDiag().events();
+        double midTime = evs.empty() ? 1. : CGAL::to_double(evs.at(evs.size() / 2)->sqrdTime());
         m_baseStepSize = midTime / 100.;
         m_stepSize = m_baseStepSize;
     }
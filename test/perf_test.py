@@ -0,0 +1,231 @@
+#!/usr/bin/python
+
+# Performance regression test for wevo.
+#
+# Runs wevo on a fixed corpus of inputs (the files in the inputs folder plus
+# a few generated inputs of fixed size) and compares the phase timings and
+# event counts that wevo appends to its CSV file against a stored baseline.
+# Event counts are deterministic and have to match exactly (unless a count
+# tolerance is given). Timings depend on the machine, hence they are compared
+# only with --times, where they may deviate by a relative tolerance.
+
+import csv
+import getopt
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+# Inputs of the inputs folder that are part of the corpus.
+CORPUS = ["ex1.pnts", "ex1.graphml", "ex2.pnts", "ex3.pnts", "ex5.pnts",
+          "collinear.pnts", "koch_snowflake.pnts"]
+# Sizes of the generated inputs that are part of the corpus.
+GEN_SIZES = [256, 1024]
+GEN_SEED = 4711
+
+# Columns of a row written by VorDiag::writeToCsv.
+CSV_COLS = ["size", "runtime", "oltime", "evtime", "coll-evs", "dom-evs",
+            "edge-evs", "inv-coll-evs", "inv-dom-evs", "inv-edge-evs",
+            "max-cand", "n-cand-sets", "avg-cand", "vor-verts"]
+TIME_COLS = ["oltime", "evtime", "runtime"]
+COUNT_COLS = ["coll-evs", "dom-evs", "edge-evs", "inv-coll-evs",
+              "inv-dom-evs", "inv-edge-evs", "vor-verts"]
+BASELINE_COLS = ["input", "size"] + TIME_COLS + COUNT_COLS
+
+
+class Lcg(object):
+    # A tiny linear congruential generator, such that the generated inputs
+    # do not depend on the random module of a particular Python version.
+    def __init__(self, seed):
+        self.state = seed
+
+    def next(self, lower, upper):
+        self.state = (self.state * 6364136223846793005 + 1442695040888963407) % (1 << 64)
+        return lower + (self.state >> 11) % (upper - lower)
+
+
+def gen_input(file_path, size, seed):
+    # Same distribution as randomize_pnts.py, i.e., coordinates within
+    # [-1e7, 1e7] and pairwise distinct weights within [1e3, 1e7).
+    lcg = Lcg(seed)
+    weights = set()
+    with open(file_path, "w") as f:
+        for i in range(size):
+            w = lcg.next(1000, 10000000)
+            while w in weights:
+                w = lcg.next(1000, 10000000)
+            weights.add(w)
+            x = lcg.next(-10000000, 10000001)
+            y = lcg.next(-10000000, 10000001)
+            f.write("{} {} {}\n".format(x, y, w))
+
+
+def run_wevo(wevo, input_path, repeat, tmp_dir):
+    csv_path = os.path.join(tmp_dir, "run.csv")
+    rows = []
+    for i in range(repeat):
+        if os.path.exists(csv_path):
+            os.remove(csv_path)
+        with open(os.devnull, "w") as devnull:
+            ret = subprocess.call([wevo, "--input-file", input_path,
+                                   "--csv-file", csv_path],
+                                  stdout=devnull, stderr=devnull)
+        if ret != 0 or not os.path.exists(csv_path):
+            return None, "wevo failed with exit code {}".format(ret)
+        with open(csv_path) as f:
+            vals = f.readline().strip().split(",")
+        rows.append(dict(zip(CSV_COLS, [int(v) for v in vals])))
+
+    # Timings are the minimum over all repetitions, event counts have to be
+    # equal for every repetition.
+    res = dict(rows[0])
+    for row in rows[1:]:
+        for col in COUNT_COLS:
+            if row[col] != res[col]:
+                return None, "non-deterministic event count {}".format(col)
+        for col in TIME_COLS:
+            res[col] = min(res[col], row[col])
+
+    return res, None
+
+
+def read_baseline(file_path):
+    baseline = {}
+    if os.path.exists(file_path):
+        with open(file_path) as f:
+            for row in csv.DictReader(f):
+                baseline[row["input"]] = dict((k, int(v)) for k, v in row.items()
+                                              if k != "input")
+    return baseline
+
+
+def write_baseline(file_path, results):
+    with open(file_path, "w") as f:
+        writer = csv.writer(f, lineterminator="\n")
+        writer.writerow(BASELINE_COLS)
+        for name in sorted(results):
+            res = results[name]
+            writer.writerow([name] + [res[col] for col in BASELINE_COLS[1:]])
+
+
+def compare(name, res, base, tolerance, min_time, count_tolerance, check_times):
+    failed = False
+    print("{} (n = {}):".format(name, res["size"]))
+    print("    {:<14}{:>14}{:>14}{:>10}".format("phase", "baseline", "current", "diff"))
+
+    for col in TIME_COLS + COUNT_COLS:
+        cur, old = res[col], base.get(col, 0)
+        diff = (cur - old) / float(old) if old > 0 else 0.
+        if col in TIME_COLS:
+            bad = check_times and cur - old > max(tolerance * old, min_time)
+        else:
+            bad = abs(cur - old) > count_tolerance * old
+        failed = failed or bad
+        print("    {:<14}{:>14}{:>14}{:>+9.1f}%{}".format(col, old, cur, 100. * diff,
+                                                       "  <-- FAILED" if bad else ""))
+
+    return failed
+
+
+def main(argv):
+    wevo = "./wevo"
+    baseline_path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                 "perf_baseline.csv")
+    inputs_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                              "..", "inputs")
+    tolerance = 0.25
+    count_tolerance = 0.
+    min_time = 2000
+    repeat = 3
+    update = False
+    check_times = False
+    help_msg = ("perf_test.py -w <wevo> -b <baseline_file> -i <inputs_folder> "
+                "-t <tolerance> -c <count_tolerance> -m <min_time_us> "
+                "-r <repeat> [-T] [-u]")
+
+    try:
+        opts, args = getopt.getopt(argv, "hw:b:i:t:c:m:r:Tu",
+                                   ["wevo=", "baseline=", "inputs=", "tolerance=",
+                                    "count-tolerance=", "min-time=", "repeat=",
+                                    "times", "update"])
+    except getopt.GetoptError:
+        print(help_msg)
+        sys.exit(2)
+
+    for opt, arg in opts:
+        if opt == "-h":
+            print(help_msg)
+            sys.exit()
+        elif opt in ("-w", "--wevo"):
+            wevo = arg
+        elif opt in ("-b", "--baseline"):
+            baseline_path = arg
+        elif opt in ("-i", "--inputs"):
+            inputs_dir = arg
+        elif opt in ("-t", "--tolerance"):
+            tolerance = float(arg)
+        elif opt in ("-c", "--count-tolerance"):
+            count_tolerance = float(arg)
+        elif opt in ("-m", "--min-time"):
+            min_time = int(arg)
+        elif opt in ("-r", "--repeat"):
+            repeat = max(1, int(arg))
+        elif opt in ("-T", "--times"):
+            check_times = True
+        elif opt in ("-u", "--update"):
+            update = True
+
+    tmp_dir = tempfile.mkdtemp(prefix="wevo-perf-")
+    inputs = [(name, os.path.join(inputs_dir, name)) for name in CORPUS]
+    for size in GEN_SIZES:
+        name = "gen-{}.pnts".format(size)
+        path = os.path.join(tmp_dir, name)
+        gen_input(path, size, GEN_SEED + size)
+        inputs.append((name, path))
+
+    baseline = read_baseline(baseline_path)
+    results = {}
+    failed = False
+
+    try:
+        for name, path in inputs:
+            res, err = run_wevo(wevo, path, repeat, tmp_dir)
+            if err is not None:
+                print("{}: {}".format(name, err))
+                failed = True
+                continue
+
+            results[name] = res
+            if update:
+                continue
+
+            # An input without a baseline fails, otherwise an empty or stale
+            # baseline would let every regression pass.
+            if name not in baseline:
+                print("{}: no baseline available (record it with --update).".format(name))
+                failed = True
+                continue
+
+            if compare(name, res, baseline[name], tolerance, min_time, count_tolerance,
+                       check_times):
+                failed = True
+    finally:
+        shutil.rmtree(tmp_dir)
+
+    if update:
+        write_baseline(baseline_path, results)
+        print("Wrote baseline of {} inputs to {}.".format(len(results), baseline_path))
+        sys.exit(1 if failed else 0)
+
+    checked = ("tolerance {:.0f}%".format(100. * tolerance) if check_times
+               else "event counts only")
+    if failed:
+        print("Performance regression test FAILED ({}).".format(checked))
+        sys.exit(1)
+
+    print("Performance regression test passed ({}).".format(checked))
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])